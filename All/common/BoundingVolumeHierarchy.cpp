@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "BoundingVolumeHierarchy.h"
+
+using namespace ci;
+
+namespace ph {
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+	mNodes.clear();
+	mIndices.clear();
+}
+
+void BoundingVolumeHierarchy::build( const BoundingBoxes &boxes )
+{
+	clear();
+
+	if( boxes.empty() )
+		return;
+
+	const uint32_t count = uint32_t( boxes.size() );
+
+	mIndices.resize( count );
+	for( uint32_t i = 0; i < count; ++i )
+		mIndices[i] = i;
+
+	// median splits leave at least two boxes in each leaf, so there are never more nodes than boxes
+	mNodes.reserve( count );
+
+	buildNode( boxes, 0, count );
+}
+
+uint32_t BoundingVolumeHierarchy::buildNode( const BoundingBoxes &boxes, uint32_t begin, uint32_t end )
+{
+	const uint32_t index = uint32_t( mNodes.size() );
+	mNodes.push_back( Node() );
+
+	// calculate the bounds of the node and of the centers of its boxes
+	vec3 min( std::numeric_limits<float>::max() ), max( -std::numeric_limits<float>::max() );
+	vec3 centerMin = min, centerMax = max;
+
+	for( uint32_t i = begin; i < end; ++i ) {
+		const vec3 center = boxes.getCenter( mIndices[i] );
+		const vec3 extents = boxes.getExtents( mIndices[i] );
+
+		min = glm::min( min, center - extents );
+		max = glm::max( max, center + extents );
+		centerMin = glm::min( centerMin, center );
+		centerMax = glm::max( centerMax, center );
+	}
+
+	mNodes[index].min = min;
+	mNodes[index].max = max;
+
+	if( end - begin <= kMaxLeafSize ) {
+		mNodes[index].first = begin;
+		mNodes[index].count = end - begin;
+		return index;
+	}
+
+	// split at the median of the axis along which the centers are spread out the most,
+	// which keeps the tree balanced so its depth never exceeds log2( n )
+	const vec3 size = centerMax - centerMin;
+	const int  axis = ( size.x > size.y && size.x > size.z ) ? 0 : ( size.y > size.z ? 1 : 2 );
+	const auto mid = begin + ( end - begin ) / 2;
+
+	std::nth_element( mIndices.begin() + begin, mIndices.begin() + mid, mIndices.begin() + end, [&]( uint32_t a, uint32_t b ) { return boxes.getCenter( a )[axis] < boxes.getCenter( b )[axis]; } );
+
+	buildNode( boxes, begin, mid );
+	const uint32_t right = buildNode( boxes, mid, end );
+
+	mNodes[index].first = right;
+	mNodes[index].count = 0;
+
+	return index;
+}
+
+void BoundingVolumeHierarchy::refit( const BoundingBoxes &boxes )
+{
+	// children are always stored after their parent, so walking backwards updates them first
+	for( size_t i = mNodes.size(); i-- > 0; ) {
+		Node &node = mNodes[i];
+
+		if( node.count > 0 ) {
+			vec3 min( std::numeric_limits<float>::max() ), max( -std::numeric_limits<float>::max() );
+			for( uint32_t j = node.first; j < node.first + node.count; ++j ) {
+				const vec3 center = boxes.getCenter( mIndices[j] );
+				const vec3 extents = boxes.getExtents( mIndices[j] );
+
+				min = glm::min( min, center - extents );
+				max = glm::max( max, center + extents );
+			}
+
+			node.min = min;
+			node.max = max;
+		}
+		else {
+			const Node &left = mNodes[i + 1];
+			const Node &right = mNodes[node.first];
+
+			node.min = glm::min( left.min, right.min );
+			node.max = glm::max( left.max, right.max );
+		}
+	}
+}
+
+int BoundingVolumeHierarchy::raycast( const ci::Ray &ray, const BoundingBoxes &boxes, float *distance ) const
+{
+	const vec3 origin = ray.getOrigin();
+	const vec3 invDirection = 1.0f / ray.getDirection();
+
+	return raycast( ray,
+	    [&]( uint32_t index, float &nearest ) {
+		    Node box;
+		    box.min = boxes.getCenter( index ) - boxes.getExtents( index );
+		    box.max = boxes.getCenter( index ) + boxes.getExtents( index );
+
+		    float t;
+		    if( !intersects( box, origin, invDirection, nearest, t ) || t >= nearest )
+			    return false;
+
+		    nearest = t;
+		    return true;
+	    },
+	    distance );
+}
+
+} // namespace ph
@@ -0,0 +1,154 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "FrustumCuller.h"
+
+#include "cinder/Ray.h"
+#include "cinder/Vector.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ph {
+
+//! A bounding volume hierarchy over a list of BoundingBoxes, used to quickly find the nearest object hit by a ray.
+//! Call build() once, then refit() whenever the boxes have moved or changed size. Refitting keeps the tree
+//! structure and is much faster than building, but the tree becomes less efficient if the boxes move far.
+class BoundingVolumeHierarchy {
+  public:
+	BoundingVolumeHierarchy();
+
+	void clear();
+
+	bool   empty() const { return mNodes.empty(); }
+	size_t getNumNodes() const { return mNodes.size(); }
+
+	//! builds the tree from scratch by recursively splitting the boxes at the median of their largest axis
+	void build( const BoundingBoxes &boxes );
+	//! updates the bounds of all nodes, \a boxes should contain the same number of boxes as when the tree was built
+	void refit( const BoundingBoxes &boxes );
+
+	//! Returns the index of the nearest box hit by the \a ray, or -1 if none was hit. If \a distance is not NULL,
+	//! it receives the distance along the ray to the entry point of the box.
+	int raycast( const ci::Ray &ray, const BoundingBoxes &boxes, float *distance = nullptr ) const;
+
+	//! Returns the index of the nearest object hit by the \a ray, or -1 if none was hit. For each box hit by the ray,
+	//! \a intersect( index, distance ) is called to test the object itself. It should return TRUE and update
+	//! \a distance if the object is hit closer than \a distance. Objects must lie inside their boxes.
+	template <typename Intersect>
+	int raycast( const ci::Ray &ray, Intersect intersect, float *distance = nullptr ) const;
+
+  private:
+	//! Leaves contain \a count boxes, starting at mIndices[ \a first ]. The left child of an interior node
+	//! (count == 0) immediately follows it, \a first is the index of its right child.
+	struct Node {
+		ci::vec3 min;
+		uint32_t first;
+		ci::vec3 max;
+		uint32_t count;
+	};
+
+	//! appends the node for indices [\a begin, \a end) and its children, returns its index
+	uint32_t buildNode( const BoundingBoxes &boxes, uint32_t begin, uint32_t end );
+
+	//! returns TRUE if the ray enters the node closer than \a tMax, \a tMin receives the entry distance
+	static bool intersects( const Node &node, const ci::vec3 &origin, const ci::vec3 &invDirection, float tMax, float &tMin );
+
+  private:
+	static const uint32_t kMaxLeafSize = 4;
+	static const size_t   kMaxDepth = 64;
+
+	std::vector<Node>     mNodes;
+	std::vector<uint32_t> mIndices;
+};
+
+template <typename Intersect>
+int BoundingVolumeHierarchy::raycast( const ci::Ray &ray, Intersect intersect, float *distance ) const
+{
+	if( mNodes.empty() )
+		return -1;
+
+	const ci::vec3 origin = ray.getOrigin();
+	const ci::vec3 invDirection = 1.0f / ray.getDirection();
+
+	int   nearest = -1;
+	float nearestDistance = std::numeric_limits<float>::max();
+
+	float tMin;
+	if( !intersects( mNodes[0], origin, invDirection, nearestDistance, tMin ) )
+		return -1;
+
+	uint32_t stack[kMaxDepth];
+	size_t   top = 0;
+	stack[top++] = 0;
+
+	while( top > 0 ) {
+		const Node &node = mNodes[stack[--top]];
+
+		if( node.count > 0 ) {
+			for( uint32_t i = node.first; i < node.first + node.count; ++i ) {
+				if( intersect( mIndices[i], nearestDistance ) )
+					nearest = int( mIndices[i] );
+			}
+			continue;
+		}
+
+		// visit the nearest child first, so that we can skip everything behind the nearest hit
+		const uint32_t left = uint32_t( &node - &mNodes[0] ) + 1;
+		const uint32_t right = node.first;
+
+		float      tLeft, tRight;
+		const bool hitLeft = intersects( mNodes[left], origin, invDirection, nearestDistance, tLeft );
+		const bool hitRight = intersects( mNodes[right], origin, invDirection, nearestDistance, tRight );
+
+		if( hitLeft && hitRight ) {
+			stack[top++] = tLeft < tRight ? right : left;
+			stack[top++] = tLeft < tRight ? left : right;
+		}
+		else if( hitLeft )
+			stack[top++] = left;
+		else if( hitRight )
+			stack[top++] = right;
+	}
+
+	if( distance && nearest >= 0 )
+		*distance = nearestDistance;
+
+	return nearest;
+}
+
+inline bool BoundingVolumeHierarchy::intersects( const Node &node, const ci::vec3 &origin, const ci::vec3 &invDirection, float tMax, float &tMin )
+{
+	const ci::vec3 t0 = ( node.min - origin ) * invDirection;
+	const ci::vec3 t1 = ( node.max - origin ) * invDirection;
+
+	tMin = std::max( std::max( std::min( t0.x, t1.x ), std::min( t0.y, t1.y ) ), std::max( std::min( t0.z, t1.z ), 0.0f ) );
+	tMax = std::min( std::min( std::max( t0.x, t1.x ), std::max( t0.y, t1.y ) ), std::min( std::max( t0.z, t1.z ), tMax ) );
+
+	return tMin <= tMax;
+}
+
+} // namespace ph
@@ -0,0 +1,196 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FrustumCuller.h"
+
+#include "cinder/AxisAlignedBox.h"
+#include "cinder/Camera.h"
+
+#include <cmath>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define PH_FRUSTUM_CULLER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+using namespace ci;
+
+namespace ph {
+
+void BoundingBoxes::clear()
+{
+	mCenterX.clear();
+	mCenterY.clear();
+	mCenterZ.clear();
+	mExtentX.clear();
+	mExtentY.clear();
+	mExtentZ.clear();
+}
+
+void BoundingBoxes::reserve( size_t count )
+{
+	mCenterX.reserve( count );
+	mCenterY.reserve( count );
+	mCenterZ.reserve( count );
+	mExtentX.reserve( count );
+	mExtentY.reserve( count );
+	mExtentZ.reserve( count );
+}
+
+void BoundingBoxes::push_back( const ci::vec3 &center, const ci::vec3 &extents )
+{
+	mCenterX.push_back( center.x );
+	mCenterY.push_back( center.y );
+	mCenterZ.push_back( center.z );
+	mExtentX.push_back( extents.x );
+	mExtentY.push_back( extents.y );
+	mExtentZ.push_back( extents.z );
+}
+
+void BoundingBoxes::push_back( const ci::mat4 &transform, const ci::AxisAlignedBox &bounds )
+{
+	const vec3 center = 0.5f * ( bounds.getMin() + bounds.getMax() );
+	const vec3 extents = 0.5f * ( bounds.getMax() - bounds.getMin() );
+
+	// The transformed extents along each axis are the extents projected onto that axis (Arvo's method)
+	vec3 c = vec3( transform[3] );
+	vec3 e( 0 );
+	for( int col = 0; col < 3; ++col ) {
+		for( int row = 0; row < 3; ++row ) {
+			c[row] += transform[col][row] * center[col];
+			e[row] += std::abs( transform[col][row] ) * extents[col];
+		}
+	}
+
+	push_back( c, e );
+}
+
+/////////////////////////////////////
+
+FrustumCuller::FrustumCuller()
+{
+	// Until set() is called, nothing is culled
+	for( auto &plane : mPlanes )
+		plane = vec4( 0, 0, 0, 1 );
+}
+
+FrustumCuller::FrustumCuller( const ci::Camera &camera )
+{
+	set( camera );
+}
+
+void FrustumCuller::set( const ci::Camera &camera )
+{
+	set( camera.getProjectionMatrix() * camera.getViewMatrix() );
+}
+
+void FrustumCuller::set( const ci::mat4 &viewProjection )
+{
+	// Gribb & Hartmann: each plane is the sum or difference of the last row and one of the other rows
+	const mat4 &m = viewProjection;
+	for( int i = 0; i < 3; ++i ) {
+		for( int k = 0; k < 4; ++k ) {
+			mPlanes[2 * i + 0][k] = m[k][3] + m[k][i];
+			mPlanes[2 * i + 1][k] = m[k][3] - m[k][i];
+		}
+	}
+
+	// Normalize, so that the distance of a point to a plane can be compared to the extents of a box
+	for( auto &plane : mPlanes ) {
+		const float length = std::sqrt( plane.x * plane.x + plane.y * plane.y + plane.z * plane.z );
+		if( length > 0.0f )
+			plane /= length;
+	}
+}
+
+bool FrustumCuller::intersects( const ci::vec3 &center, const ci::vec3 &extents ) const
+{
+	for( const auto &plane : mPlanes ) {
+		const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		const float radius = std::abs( plane.x ) * extents.x + std::abs( plane.y ) * extents.y + std::abs( plane.z ) * extents.z;
+		if( distance + radius < 0.0f )
+			return false;
+	}
+
+	return true;
+}
+
+size_t FrustumCuller::cull( const BoundingBoxes &boxes, std::vector<uint32_t> &visible ) const
+{
+	const size_t count = boxes.size();
+	visible.resize( count );
+
+	uint32_t *dst = visible.data();
+	size_t    i = 0;
+
+#ifdef PH_FRUSTUM_CULLER_SSE
+	__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for( int p = 0; p < 6; ++p ) {
+		nx[p] = _mm_set1_ps( mPlanes[p].x );
+		ny[p] = _mm_set1_ps( mPlanes[p].y );
+		nz[p] = _mm_set1_ps( mPlanes[p].z );
+		nw[p] = _mm_set1_ps( mPlanes[p].w );
+		ax[p] = _mm_set1_ps( std::abs( mPlanes[p].x ) );
+		ay[p] = _mm_set1_ps( std::abs( mPlanes[p].y ) );
+		az[p] = _mm_set1_ps( std::abs( mPlanes[p].z ) );
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+
+	// Test four boxes at a time
+	for( ; i + 4 <= count; i += 4 ) {
+		const __m128 cx = _mm_loadu_ps( &boxes.mCenterX[i] );
+		const __m128 cy = _mm_loadu_ps( &boxes.mCenterY[i] );
+		const __m128 cz = _mm_loadu_ps( &boxes.mCenterZ[i] );
+		const __m128 ex = _mm_loadu_ps( &boxes.mExtentX[i] );
+		const __m128 ey = _mm_loadu_ps( &boxes.mExtentY[i] );
+		const __m128 ez = _mm_loadu_ps( &boxes.mExtentZ[i] );
+
+		int mask = 0xF;
+		for( int p = 0; p < 6 && mask; ++p ) {
+			__m128 d = _mm_add_ps( _mm_mul_ps( nx[p], cx ), nw[p] );
+			d = _mm_add_ps( d, _mm_mul_ps( ny[p], cy ) );
+			d = _mm_add_ps( d, _mm_mul_ps( nz[p], cz ) );
+			d = _mm_add_ps( d, _mm_mul_ps( ax[p], ex ) );
+			d = _mm_add_ps( d, _mm_mul_ps( ay[p], ey ) );
+			d = _mm_add_ps( d, _mm_mul_ps( az[p], ez ) );
+			mask &= _mm_movemask_ps( _mm_cmpge_ps( d, zero ) );
+		}
+
+		for( int k = 0; k < 4; ++k )
+			if( mask & ( 1 << k ) )
+				*dst++ = uint32_t( i + k );
+	}
+#endif
+
+	for( ; i < count; ++i ) {
+		const vec3 center( boxes.mCenterX[i], boxes.mCenterY[i], boxes.mCenterZ[i] );
+		const vec3 extents( boxes.mExtentX[i], boxes.mExtentY[i], boxes.mExtentZ[i] );
+		if( intersects( center, extents ) )
+			*dst++ = uint32_t( i );
+	}
+
+	visible.resize( dst - visible.data() );
+	return visible.size();
+}
+
+} // namespace ph
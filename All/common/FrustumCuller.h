@@ -0,0 +1,86 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace cinder {
+class AxisAlignedBox;
+class Camera;
+}
+
+namespace ph {
+
+//! A list of axis-aligned bounding boxes. Centers and half sizes are stored in separate arrays per axis,
+//! so that the FrustumCuller can test four boxes at a time.
+class BoundingBoxes {
+  public:
+	void clear();
+	void reserve( size_t count );
+
+	size_t size() const { return mCenterX.size(); }
+	bool   empty() const { return mCenterX.empty(); }
+
+	//! adds a box with the given \a center and half size \a extents
+	void push_back( const ci::vec3 &center, const ci::vec3 &extents );
+	//! adds the smallest axis-aligned box that contains \a bounds after it has been transformed by \a transform
+	void push_back( const ci::mat4 &transform, const ci::AxisAlignedBox &bounds );
+
+	ci::vec3 getCenter( size_t index ) const { return ci::vec3( mCenterX[index], mCenterY[index], mCenterZ[index] ); }
+	ci::vec3 getExtents( size_t index ) const { return ci::vec3( mExtentX[index], mExtentY[index], mExtentZ[index] ); }
+
+  private:
+	friend class FrustumCuller;
+
+	std::vector<float> mCenterX, mCenterY, mCenterZ;
+	std::vector<float> mExtentX, mExtentY, mExtentZ;
+};
+
+//! Tests bounding boxes against the view frustum of a camera. The planes are extracted from the combined
+//! view and projection matrices, so lens shift and other off-center projections are handled correctly.
+//! Boxes near the corners of the frustum may be reported as visible, but visible boxes are never culled.
+class FrustumCuller {
+  public:
+	FrustumCuller();
+	explicit FrustumCuller( const ci::Camera &camera );
+
+	void set( const ci::Camera &camera );
+	void set( const ci::mat4 &viewProjection );
+
+	//! returns TRUE if the box with the given \a center and half size \a extents is (partially) inside the frustum
+	bool intersects( const ci::vec3 &center, const ci::vec3 &extents ) const;
+
+	//! Replaces the contents of \a visible by the indices of the \a boxes inside the frustum, in their original order.
+	//! Returns the number of visible boxes.
+	size_t cull( const BoundingBoxes &boxes, std::vector<uint32_t> &visible ) const;
+
+  private:
+	//! xyz = normal pointing inwards, w = distance
+	ci::vec4 mPlanes[6];
+};
+
+} // namespace ph
@@ -24,9 +24,13 @@
 
 #include "cinder/Camera.h"
 #include "cinder/Rand.h"
+#include "cinder/Timer.h"
 #include "cinder/app/App.h"
 #include "cinder/gl/gl.h"
 
+#include <algorithm>
+#include <cstring>
+
 using namespace ci;
 using namespace ci::app;
 
@@ -125,49 +129,66 @@ const char *Pistons::fs
       "	fragColor.a = dot( final, luminance );\n"
       "}";
 
-void Pistons::setup()
+Piston *PistonsRenderer::map( size_t count )
 {
-	mInstances.clear();
+	// Grow the instance buffer if needed. The Batch refers to it, so it has to be recreated as well.
+	if( !mBatch || count > mCapacity ) {
+		mCapacity = std::max<size_t>( count, 1 );
 
-	Rand::randSeed( 2015 );
-	for( int x = -50; x <= 50; x += 10 )
-		for( int z = -50; z <= 50; z += 10 )
-			mInstances.emplace_back( Piston( float( x ), float( z ) ) );
-
-	// Load and compile our shaders and textures
-	try {
-		geom::BufferLayout instanceDataLayout;
-		instanceDataLayout.append( geom::Attrib::CUSTOM_0, 4, sizeof( Piston ), offsetof( Piston, mPosition ), 1 /* per instance */ );
-		instanceDataLayout.append( geom::Attrib::CUSTOM_1, 4, sizeof( Piston ), offsetof( Piston, mColor ), 1 /* per instance */ );
-
-		mInstanceVbo = gl::Vbo::create( GL_ARRAY_BUFFER, mInstances.size() * sizeof( Piston ), mInstances.data(), GL_DYNAMIC_DRAW );
-		auto glsl = gl::GlslProg::create( vs, fs );
-		auto mesh = gl::VboMesh::create( geom::Cube() );
-		mesh->appendVbo( instanceDataLayout, mInstanceVbo );
-
-		mBatch = gl::Batch::create( mesh, glsl, { { geom::Attrib::CUSTOM_0, "iPosition" }, { geom::Attrib::CUSTOM_1, "iColor" } } );
-	}
-	catch( const std::exception &e ) {
-		console() << e.what() << std::endl;
+		try {
+			geom::BufferLayout instanceDataLayout;
+			instanceDataLayout.append( geom::Attrib::CUSTOM_0, 4, sizeof( Piston ), offsetof( Piston, mPosition ), 1 /* per instance */ );
+			instanceDataLayout.append( geom::Attrib::CUSTOM_1, 4, sizeof( Piston ), offsetof( Piston, mColor ), 1 /* per instance */ );
+
+			mInstanceVbo = gl::Vbo::create( GL_ARRAY_BUFFER, mCapacity * sizeof( Piston ), nullptr, GL_DYNAMIC_DRAW );
+			if( !mGlsl )
+				mGlsl = gl::GlslProg::create( Pistons::vs, Pistons::fs );
+			auto mesh = gl::VboMesh::create( geom::Cube() );
+			mesh->appendVbo( instanceDataLayout, mInstanceVbo );
+
+			mBatch = gl::Batch::create( mesh, mGlsl, { { geom::Attrib::CUSTOM_0, "iPosition" }, { geom::Attrib::CUSTOM_1, "iColor" } } );
+		}
+		catch( const std::exception &e ) {
+			console() << e.what() << std::endl;
+
+			mBatch.reset();
+			mCapacity = 0;
+			mCount = 0;
+			return nullptr;
+		}
 	}
+
+	mCount = count;
+	return static_cast<Piston *>( mInstanceVbo->mapReplace() );
 }
 
-void Pistons::update( const ci::Camera &camera, float time )
+void PistonsRenderer::unmap()
 {
-	for( auto &instance : mInstances )
-		instance.update( camera, time );
+	if( mInstanceVbo )
+		mInstanceVbo->unmap();
+}
+
+void PistonsRenderer::upload( const Pistons &pistons, const ci::Camera &camera, bool cull )
+{
+	const auto &sorted = pistons.getSorted();
 
-	std::qsort( &mInstances.front(), mInstances.size(), sizeof( Piston ), &Piston::CompareByDistanceToCamera );
+	Piston *ptr = map( sorted.size() );
+	if( !ptr )
+		return;
 
-	Piston *ptr = static_cast<Piston *>( mInstanceVbo->mapReplace() );
-	for( size_t i = 0; i < mInstances.size(); ++i ) {
-		*ptr++ = mInstances[i];
-	}
-	mInstanceVbo->unmap();
+	if( cull )
+		mCount = copyVisible( pistons, camera, ptr );
+	else
+		std::memcpy( ptr, sorted.data(), sorted.size() * sizeof( Piston ) );
+
+	unmap();
 }
 
-void Pistons::draw( const ci::Camera &camera )
+void PistonsRenderer::draw( const ci::Camera &camera )
 {
+	if( !mBatch || mCount == 0 )
+		return;
+
 	gl::ScopedDepth       scpDepth( true );
 	gl::ScopedFaceCulling scpCull( true, GL_BACK );
 	gl::ScopedColor       scpColor( Color::white() );
@@ -176,7 +197,224 @@ void Pistons::draw( const ci::Camera &camera )
 	gl::pushMatrices();
 	gl::setMatrices( camera );
 
-	mBatch->drawInstanced( mInstances.size() );
+	mBatch->drawInstanced( (GLsizei)mCount );
 
 	gl::popMatrices();
-}
\ No newline at end of file
+}
+
+size_t PistonsRenderer::copyVisible( const Pistons &pistons, const ci::Camera &camera, Piston *dst )
+{
+	const ph::FrustumCuller culler( camera );
+	culler.cull( pistons.getBounds(), mVisible );
+
+	const auto &sorted = pistons.getSorted();
+	for( uint32_t index : mVisible )
+		*dst++ = sorted[index];
+
+	return mVisible.size();
+}
+
+/////////////////////////////////////
+
+void Pistons::setup( int gridSize )
+{
+	mGridSize = math<int>::max( 1, gridSize );
+
+	mInstances.clear();
+	mInstances.reserve( mGridSize * mGridSize );
+
+	// Center the grid around the origin, the default size yields the original 11 x 11 layout
+	const float offset = 0.5f * float( mGridSize - 1 );
+
+	Rand::randSeed( 2015 );
+	for( int x = 0; x < mGridSize; ++x )
+		for( int z = 0; z < mGridSize; ++z )
+			mInstances.emplace_back( Piston( 10.0f * ( x - offset ), 10.0f * ( z - offset ) ) );
+
+	mOrder.resize( mInstances.size() );
+	for( size_t i = 0; i < mOrder.size(); ++i ) {
+		mOrder[i].key = 0;
+		mOrder[i].index = uint32_t( i );
+	}
+	mScratch.resize( mInstances.size() );
+	mSorted.clear();
+}
+
+void Pistons::update( const ci::Camera &camera, float time )
+{
+	Timer timer( true );
+	animate( camera, time );
+	mTimings.animate = timer.getSeconds() * 1000.0;
+
+	timer.start();
+	sort();
+	mTimings.sort = timer.getSeconds() * 1000.0;
+
+	// The renderer is created here rather than in setup(), so that simulate() works without an OpenGL context
+	timer.start();
+	if( !mRenderer )
+		mRenderer.reset( new PistonsRenderer() );
+
+	Piston *ptr = mRenderer->map( mInstances.size() );
+	if( ptr ) {
+		gather( ptr );
+		mRenderer->unmap();
+	}
+	mTimings.upload = timer.getSeconds() * 1000.0;
+}
+
+void Pistons::simulate( const ci::Camera &camera, float time )
+{
+	Timer timer( true );
+	animate( camera, time );
+	mTimings.animate = timer.getSeconds() * 1000.0;
+
+	timer.start();
+	sort();
+	mTimings.sort = timer.getSeconds() * 1000.0;
+
+	timer.start();
+	mSorted.resize( mInstances.size() );
+	gather( mSorted.data() );
+
+	// The vertex shader scales a unit cube to 10 x 2y x 10 units, so each piston spans from the floor to twice its height
+	mBounds.clear();
+	mBounds.reserve( mSorted.size() );
+	for( const auto &piston : mSorted )
+		mBounds.push_back( piston.mPosition, vec3( 5.0f, piston.mPosition.y, 5.0f ) );
+	mTimings.upload = timer.getSeconds() * 1000.0;
+}
+
+void Pistons::cycleGridSize()
+{
+	static const int kGridSizes[] = { 11, 32, 100, 317, 1000 };
+
+	for( int gridSize : kGridSizes ) {
+		if( gridSize > mGridSize ) {
+			setup( gridSize );
+			return;
+		}
+	}
+
+	setup( kGridSizes[0] );
+}
+
+void Pistons::printTimings() const
+{
+	console() << getCount() << " pistons, animate: " << mTimings.animate << " ms, sort: " << mTimings.sort << " ms";
+	console() << ( mTimings.coherent ? " (coherent)" : "" ) << ", upload: " << mTimings.upload << " ms" << std::endl;
+}
+
+void Pistons::draw( const ci::Camera &camera )
+{
+	if( mRenderer )
+		mRenderer->draw( camera );
+}
+
+void Pistons::animate( const ci::Camera &camera, float time )
+{
+	for( auto &instance : mInstances )
+		instance.update( camera, time );
+}
+
+void Pistons::sort()
+{
+	// In coherent mode, we start from last frame's order, which usually is nearly sorted because the camera
+	// moves only a little each frame. If it isn't, insertion sort bails out early and we fall back to radix sort.
+	mTimings.coherent = false;
+	if( mSortMode == SORT_COHERENT ) {
+		for( auto &item : mOrder )
+			item.key = toSortKey( mInstances[item.index].mDistance );
+
+		mTimings.coherent = sortInsertion( 2 * mOrder.size() );
+		if( !mTimings.coherent )
+			sortRadix();
+	}
+	else {
+		for( size_t i = 0; i < mOrder.size(); ++i ) {
+			mOrder[i].key = toSortKey( mInstances[i].mDistance );
+			mOrder[i].index = uint32_t( i );
+		}
+		sortRadix();
+	}
+}
+
+void Pistons::gather( Piston *dst ) const
+{
+	for( const auto &item : mOrder )
+		*dst++ = mInstances[item.index];
+}
+
+uint32_t Pistons::toSortKey( float value )
+{
+	uint32_t bits;
+	std::memcpy( &bits, &value, sizeof( bits ) );
+
+	// Flip all bits of negative numbers and only the sign bit of positive numbers
+	return bits ^ ( ( bits & 0x80000000u ) ? 0xFFFFFFFFu : 0x80000000u );
+}
+
+void Pistons::sortRadix()
+{
+	const size_t count = mOrder.size();
+	if( count < 2 )
+		return;
+
+	// Count all four digits in a single pass
+	uint32_t histogram[4][256] = {};
+	for( const auto &item : mOrder ) {
+		histogram[0][item.key & 0xFF]++;
+		histogram[1][( item.key >> 8 ) & 0xFF]++;
+		histogram[2][( item.key >> 16 ) & 0xFF]++;
+		histogram[3][item.key >> 24]++;
+	}
+
+	SortItem *src = mOrder.data();
+	SortItem *dst = mScratch.data();
+
+	for( int pass = 0; pass < 4; ++pass ) {
+		uint32_t *counts = histogram[pass];
+		const int shift = pass * 8;
+
+		// Skip the pass if all keys share the same digit
+		if( counts[( src[0].key >> shift ) & 0xFF] == count )
+			continue;
+
+		uint32_t sum = 0;
+		for( int i = 0; i < 256; ++i ) {
+			const uint32_t n = counts[i];
+			counts[i] = sum;
+			sum += n;
+		}
+
+		for( size_t i = 0; i < count; ++i )
+			dst[counts[( src[i].key >> shift ) & 0xFF]++] = src[i];
+
+		std::swap( src, dst );
+	}
+
+	if( src != mOrder.data() )
+		mOrder.swap( mScratch );
+}
+
+bool Pistons::sortInsertion( size_t maxMoves )
+{
+	size_t moves = 0;
+
+	for( size_t i = 1; i < mOrder.size(); ++i ) {
+		const SortItem item = mOrder[i];
+
+		size_t j = i;
+		while( j > 0 && mOrder[j - 1].key > item.key ) {
+			mOrder[j] = mOrder[j - 1];
+			--j;
+		}
+		mOrder[j] = item;
+
+		moves += i - j;
+		if( moves > maxMoves )
+			return false;
+	}
+
+	return true;
+}
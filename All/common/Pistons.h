@@ -22,11 +22,15 @@
 
 #pragma once
 
+#include "FrustumCuller.h"
+
 #include "cinder/Cinder.h"
 #include "cinder/Color.h"
 #include "cinder/Vector.h"
 #include "cinder/gl/Batch.h"
+#include "cinder/gl/GlslProg.h"
 #include "cinder/gl/Vbo.h"
+#include <memory>
 #include <vector>
 
 namespace cinder {
@@ -42,18 +46,6 @@ class Piston {
 
 	void update( const ci::Camera &camera, float time = 0 );
 
-	// Our custom sorting comparator
-	static int CompareByDistanceToCamera( const void *a, const void *b )
-	{
-		const Piston *pA = reinterpret_cast<const Piston *>( a );
-		const Piston *pB = reinterpret_cast<const Piston *>( b );
-		if( pA->mDistance < pB->mDistance )
-			return -1;
-		if( pA->mDistance > pB->mDistance )
-			return 1;
-		return 0;
-	}
-
   public:
 	ci::vec3 mPosition;
 	float    mDistance;
@@ -61,19 +53,126 @@ class Piston {
 	float    mOffset;
 };
 
+class Pistons;
+
+//! Draws pistons using instancing. Each OpenGL context needs its own renderer, because the Batch can not be shared.
+class PistonsRenderer {
+  public:
+	PistonsRenderer()
+	    : mCapacity( 0 )
+	    , mCount( 0 )
+	{
+	}
+
+	//! Returns memory for \a count instances, which will be drawn in that order. Call unmap() when done.
+	Piston *map( size_t count );
+	void    unmap();
+
+	//! Uploads the sorted \a pistons inside the \a camera's view in a single pass, or all of them if \a cull is FALSE.
+	void upload( const Pistons &pistons, const ci::Camera &camera, bool cull = true );
+	void draw( const ci::Camera &camera );
+
+	//! Returns the number of pistons that will be drawn.
+	size_t getCount() const { return mCount; }
+
+	//! Copies the sorted \a pistons that intersect the \a camera's view frustum to \a dst, preserving their order.
+	//! Returns the number of pistons copied. Does not require an OpenGL context.
+	size_t copyVisible( const Pistons &pistons, const ci::Camera &camera, Piston *dst );
+
+  private:
+	ci::gl::GlslProgRef mGlsl;
+	ci::gl::BatchRef    mBatch;
+	ci::gl::VboRef      mInstanceVbo;
+
+	std::vector<uint32_t> mVisible;
+
+	size_t mCapacity;
+	size_t mCount;
+};
+
 class Pistons {
   public:
-	Pistons() {}
+	//! Determines how the pistons are sorted by distance to the camera.
+	typedef enum { SORT_RADIX, SORT_COHERENT } SortMode;
+
+	//! Duration of each stage of the last update, in milliseconds.
+	struct Timings {
+		double animate;
+		double sort;
+		double upload;
+		//! TRUE if the last sort was done by insertion sort only.
+		bool   coherent;
+	};
+
+	Pistons()
+	    : mGridSize( 0 )
+	    , mSortMode( SORT_RADIX )
+	    , mTimings()
+	{
+	}
 
-	void setup();
+	//! Creates a grid of \a gridSize x \a gridSize pistons, 10 units apart. Sizes up to 1000 (1M pistons) are fine.
+	void setup( int gridSize = 11 );
+	//! Switches to the next larger grid, from 121 up to a million pistons, then starts over.
+	void cycleGridSize();
+	//! Animates and sorts the pistons, then uploads them to our own instance buffer.
 	void update( const ci::Camera &camera, float time );
+	//! Animates and sorts the pistons into getSorted() without touching OpenGL, so the result can be
+	//! shared by multiple renderers.
+	void simulate( const ci::Camera &camera, float time );
 	void draw( const ci::Camera &camera );
 
+	//! Returns the pistons sorted front to back by the last call to simulate().
+	const std::vector<Piston> &getSorted() const { return mSorted; }
+	//! Returns the bounding box of each piston returned by getSorted().
+	const ph::BoundingBoxes &getBounds() const { return mBounds; }
+
+	int    getGridSize() const { return mGridSize; }
+	size_t getCount() const { return mInstances.size(); }
+
+	//! SORT_RADIX sorts from scratch every frame. SORT_COHERENT insertion sorts last frame's order instead and only
+	//! falls back to radix sort if that order turns out not to be nearly sorted.
+	void     setSortMode( SortMode mode ) { mSortMode = mode; }
+	SortMode getSortMode() const { return mSortMode; }
+	void     toggleSortMode() { mSortMode = ( mSortMode == SORT_RADIX ) ? SORT_COHERENT : SORT_RADIX; }
+
+	const Timings &getTimings() const { return mTimings; }
+	//! Writes the number of pistons and the timings of the last update to the console.
+	void printTimings() const;
+
 	static const char *vs;
 	static const char *fs;
 
   private:
-	std::vector<Piston> mInstances;
-	ci::gl::BatchRef    mBatch;
-	ci::gl::VboRef      mInstanceVbo;
+	//! Sorting moves these around instead of the pistons themselves.
+	struct SortItem {
+		uint32_t key;
+		uint32_t index;
+	};
+
+	void animate( const ci::Camera &camera, float time );
+	void sort();
+	//! Copies the pistons to \a dst in sorted order.
+	void gather( Piston *dst ) const;
+
+	//! Converts a float to an unsigned integer with the same ordering.
+	static uint32_t toSortKey( float value );
+
+	//! Sorts mOrder with an LSD radix sort, 8 bits per pass.
+	void sortRadix();
+	//! Insertion sorts mOrder, but gives up and returns FALSE once more than \a maxMoves items had to be moved.
+	bool sortInsertion( size_t maxMoves );
+
+  private:
+	std::vector<Piston>   mInstances;
+	std::vector<Piston>   mSorted;
+	ph::BoundingBoxes     mBounds;
+	std::vector<SortItem> mOrder;
+	std::vector<SortItem> mScratch;
+
+	std::unique_ptr<PistonsRenderer> mRenderer;
+
+	int      mGridSize;
+	SortMode mSortMode;
+	Timings  mTimings;
 };
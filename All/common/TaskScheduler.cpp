@@ -0,0 +1,418 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TaskScheduler.h"
+
+#include "cinder/Log.h"
+#include "cinder/Timer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace ci;
+
+namespace ph {
+
+namespace {
+
+//! index of the worker owned by the current thread, or -1 for other threads
+thread_local int sWorkerIndex = -1;
+
+} // namespace
+
+Task::Task( std::function<void()> fn, Priority priority, bool mainThread )
+    : mFunction( fn )
+    , mPriority( priority )
+    , mMainThread( mainThread )
+    , mDone( false )
+    , mCancelled( false )
+{
+}
+
+bool Task::hasFailed() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mException != nullptr;
+}
+
+void Task::rethrow() const
+{
+	std::exception_ptr exception;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		exception = mException;
+	}
+
+	if( exception )
+		std::rethrow_exception( exception );
+}
+
+void Task::wait()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	while( !mDone )
+		mCondition.wait( lock );
+}
+
+TaskRef Task::then( std::function<void()> fn, Priority priority )
+{
+	return addContinuation( TaskRef( new Task( fn, priority, false ) ) );
+}
+
+TaskRef Task::thenOnMainThread( std::function<void()> fn )
+{
+	return addContinuation( TaskRef( new Task( fn, mPriority, true ) ) );
+}
+
+void Task::run()
+{
+	std::exception_ptr exception;
+	try {
+		mFunction();
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "Task failed: " << exc.what() );
+		exception = std::current_exception();
+	}
+	catch( ... ) {
+		CI_LOG_E( "Task failed." );
+		exception = std::current_exception();
+	}
+
+	// release whatever the function captured
+	mFunction = nullptr;
+
+	std::vector<TaskRef> continuations;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mException = exception;
+		mDone = true;
+		continuations.swap( mContinuations );
+	}
+	mCondition.notify_all();
+
+	// continuations only run if this task succeeded
+	for( auto &task : continuations ) {
+		if( exception )
+			task->cancel();
+		else
+			TaskScheduler::getInstance().schedule( task );
+	}
+}
+
+void Task::cancel()
+{
+	std::vector<TaskRef> continuations;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( mDone )
+			return;
+
+		mException = std::make_exception_ptr( std::runtime_error( "Task was cancelled." ) );
+		mCancelled = true;
+		mDone = true;
+		continuations.swap( mContinuations );
+	}
+	mCondition.notify_all();
+
+	mFunction = nullptr;
+
+	for( auto &task : continuations )
+		task->cancel();
+}
+
+TaskRef Task::addContinuation( const TaskRef &task )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( !mDone ) {
+			mContinuations.push_back( task );
+			return task;
+		}
+
+		if( mException ) {
+			task->cancel();
+			return task;
+		}
+	}
+
+	TaskScheduler::getInstance().schedule( task );
+	return task;
+}
+
+//
+
+TaskScheduler::TaskScheduler( void )
+    : mPending( 0 )
+    , mNext( 0 )
+    , mShouldQuit( false )
+{
+	// leave one core for the main thread
+	unsigned int numThreads = std::thread::hardware_concurrency();
+	if( numThreads > 1 )
+		numThreads--;
+	else
+		numThreads = 1;
+
+	for( unsigned int i = 0; i < numThreads; ++i )
+		mWorkers.emplace_back( new Worker() );
+
+	for( unsigned int i = 0; i < numThreads; ++i )
+		mThreads.emplace_back( new std::thread( &TaskScheduler::work, this, size_t( i ) ) );
+}
+
+TaskScheduler::~TaskScheduler( void )
+{
+}
+
+TaskRef TaskScheduler::submit( std::function<void()> fn, Task::Priority priority )
+{
+	TaskRef task( new Task( fn, priority, false ) );
+	schedule( task );
+
+	return task;
+}
+
+TaskRef TaskScheduler::submitToMainThread( std::function<void()> fn )
+{
+	TaskRef task( new Task( fn, Task::NORMAL, true ) );
+	schedule( task );
+
+	return task;
+}
+
+void TaskScheduler::parallelFor( size_t begin, size_t end, const std::function<void( size_t, size_t )> &fn, size_t granularity )
+{
+	if( begin >= end )
+		return;
+
+	// waiting for other tasks on a worker thread could deadlock
+	if( !isRunning() || isWorkerThread() ) {
+		fn( begin, end );
+		return;
+	}
+
+	const size_t count = end - begin;
+	const size_t numRanges = getNumWorkers() + 1;
+	const size_t step = std::max<size_t>( granularity, 1 );
+	const size_t rangeSize = ( ( count + numRanges - 1 ) / numRanges + step - 1 ) / step * step;
+
+	std::vector<TaskRef> tasks;
+	for( size_t first = begin + rangeSize; first < end; first += rangeSize ) {
+		const size_t last = std::min( first + rangeSize, end );
+		tasks.push_back( submit( [&fn, first, last]() { fn( first, last ); }, Task::HIGH ) );
+	}
+
+	// the tasks refer to fn, so wait for all of them before passing on an exception
+	std::exception_ptr exception;
+	try {
+		fn( begin, std::min( begin + rangeSize, end ) );
+	}
+	catch( ... ) {
+		exception = std::current_exception();
+	}
+
+	for( size_t i = 0; i < tasks.size(); ++i ) {
+		tasks[i]->wait();
+
+		// tasks are cancelled when the scheduler shuts down, in which case we process their range ourselves
+		if( tasks[i]->isCancelled() ) {
+			const size_t first = begin + ( i + 1 ) * rangeSize;
+			try {
+				fn( first, std::min( first + rangeSize, end ) );
+			}
+			catch( ... ) {
+				if( !exception )
+					exception = std::current_exception();
+			}
+		}
+		else if( !exception ) {
+			try {
+				tasks[i]->rethrow();
+			}
+			catch( ... ) {
+				exception = std::current_exception();
+			}
+		}
+	}
+
+	if( exception )
+		std::rethrow_exception( exception );
+}
+
+size_t TaskScheduler::processMainThread( double maxSeconds )
+{
+	Timer  timer( true );
+	size_t count = 0;
+
+	for( ;; ) {
+		TaskRef task;
+		{
+			std::lock_guard<std::mutex> lock( mMainThreadMutex );
+			if( mMainThreadTasks.empty() )
+				break;
+
+			task = mMainThreadTasks.front();
+			mMainThreadTasks.pop_front();
+		}
+
+		task->run();
+		count++;
+
+		if( maxSeconds > 0.0 && timer.getSeconds() > maxSeconds )
+			break;
+	}
+
+	return count;
+}
+
+bool TaskScheduler::isWorkerThread() const
+{
+	return sWorkerIndex >= 0;
+}
+
+void TaskScheduler::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock( mSleepMutex );
+		mShouldQuit = true;
+	}
+	mSleepCondition.notify_all();
+
+	for( auto &thread : mThreads ) {
+		if( thread->joinable() )
+			thread->join();
+	}
+
+	mThreads.clear();
+
+	// cancel the tasks that did not get to run, so nobody waits for them forever
+	std::vector<TaskRef> discarded;
+	{
+		std::lock_guard<std::mutex> lock( mSleepMutex );
+		for( auto &worker : mWorkers ) {
+			for( auto &tasks : worker->mTasks ) {
+				discarded.insert( discarded.end(), tasks.begin(), tasks.end() );
+				tasks.clear();
+			}
+		}
+
+		mPending = 0;
+	}
+	{
+		std::lock_guard<std::mutex> lock( mMainThreadMutex );
+		discarded.insert( discarded.end(), mMainThreadTasks.begin(), mMainThreadTasks.end() );
+		mMainThreadTasks.clear();
+	}
+
+	for( auto &task : discarded )
+		task->cancel();
+}
+
+void TaskScheduler::schedule( const TaskRef &task )
+{
+	if( task->mMainThread ) {
+		{
+			std::lock_guard<std::mutex> lock( mMainThreadMutex );
+			if( !mShouldQuit ) {
+				mMainThreadTasks.push_back( task );
+				return;
+			}
+		}
+
+		task->cancel();
+		return;
+	}
+
+	// tasks submitted by a worker go to its own deque, others are distributed round-robin
+	size_t index = sWorkerIndex >= 0 ? size_t( sWorkerIndex ) : mNext++ % mWorkers.size();
+
+	bool queued = false;
+	{
+		// take the lock, so a worker that is about to sleep can't miss the notification,
+		// and shutdown() can't miss the task
+		std::lock_guard<std::mutex> lock( mSleepMutex );
+		if( !mShouldQuit ) {
+			mPending++;
+
+			std::lock_guard<std::mutex> workerLock( mWorkers[index]->mMutex );
+			mWorkers[index]->mTasks[task->mPriority].push_back( task );
+			queued = true;
+		}
+	}
+
+	if( queued )
+		mSleepCondition.notify_one();
+	else
+		task->cancel();
+}
+
+void TaskScheduler::work( size_t index )
+{
+	sWorkerIndex = int( index );
+
+	while( !mShouldQuit ) {
+		TaskRef task;
+		if( fetch( index, task ) ) {
+			mPending--;
+			task->run();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( mSleepMutex );
+		while( mPending == 0 && !mShouldQuit )
+			mSleepCondition.wait( lock );
+	}
+}
+
+bool TaskScheduler::fetch( size_t index, TaskRef &task )
+{
+	const size_t count = mWorkers.size();
+
+	for( int priority = Task::NUM_PRIORITIES - 1; priority >= 0; --priority ) {
+		// take the newest task from our own deque, because its data is most likely still in the cache
+		{
+			Worker &                    worker = *mWorkers[index];
+			std::lock_guard<std::mutex> lock( worker.mMutex );
+			if( !worker.mTasks[priority].empty() ) {
+				task = worker.mTasks[priority].back();
+				worker.mTasks[priority].pop_back();
+				return true;
+			}
+		}
+
+		// steal the oldest task from another worker
+		for( size_t i = 1; i < count; ++i ) {
+			Worker &                    victim = *mWorkers[( index + i ) % count];
+			std::lock_guard<std::mutex> lock( victim.mMutex );
+			if( !victim.mTasks[priority].empty() ) {
+				task = victim.mTasks[priority].front();
+				victim.mTasks[priority].pop_front();
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+} // namespace ph
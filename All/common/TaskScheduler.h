@@ -0,0 +1,162 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ph {
+
+typedef std::shared_ptr<class Task> TaskRef;
+
+//! A unit of work submitted to the TaskScheduler. Keep the returned reference to wait for the task,
+//! or to attach continuations that run when it has completed. A task is cancelled if the scheduler shuts down
+//! before it could run, or if the task it continues has failed. Cancelled tasks are done and have failed.
+class Task {
+  public:
+	enum Priority { LOW, NORMAL, HIGH, NUM_PRIORITIES };
+
+	//! returns TRUE if the task has run, failed or was cancelled
+	bool isDone() const { return mDone; }
+	//! returns TRUE if the task threw an exception or was cancelled
+	bool hasFailed() const;
+	//! returns TRUE if the task was discarded without running
+	bool isCancelled() const { return mCancelled; }
+	//! rethrows the exception thrown by the task, if any
+	void rethrow() const;
+
+	//! blocks until the task has run or was cancelled. Do not call this from a task, because it would block a worker thread.
+	void wait();
+
+	//! runs \a fn on a worker thread after this task has completed successfully
+	TaskRef then( std::function<void()> fn, Priority priority = NORMAL );
+	//! runs \a fn on the main thread after this task has completed successfully. Use this for OpenGL work.
+	TaskRef thenOnMainThread( std::function<void()> fn );
+
+  private:
+	friend class TaskScheduler;
+
+	Task( std::function<void()> fn, Priority priority, bool mainThread );
+
+	//! runs the function and schedules the continuations
+	void run();
+	//! marks the task and its continuations as done without running them, and wakes up their waiters
+	void cancel();
+	//! adds a continuation, or schedules it right away if this task has already completed
+	TaskRef addContinuation( const TaskRef &task );
+
+  private:
+	std::function<void()> mFunction;
+	Priority              mPriority;
+	bool                  mMainThread;
+
+	std::atomic<bool>       mDone;
+	std::atomic<bool>       mCancelled;
+	std::exception_ptr      mException;
+	std::vector<TaskRef>    mContinuations;
+	mutable std::mutex      mMutex;
+	std::condition_variable mCondition;
+};
+
+//! Work-stealing thread pool shared by the whole application, so loaders don't each have to own threads.
+//! Each worker thread has a deque per priority: it takes the newest task from its own deque and steals the oldest
+//! task from the other workers if it runs out. Higher priorities are always taken first. Tasks that need the
+//! OpenGL context are queued for the main thread, which runs them when the application calls processMainThread().
+class TaskScheduler {
+  public:
+	// singleton implementation. The instance is never destroyed, because joining threads during static
+	// destruction may deadlock. Call shutdown() before terminating the application instead.
+	static TaskScheduler &getInstance()
+	{
+		static TaskScheduler *scheduler = new TaskScheduler();
+		return *scheduler;
+	};
+
+	//! runs \a fn on a worker thread
+	TaskRef submit( std::function<void()> fn, Task::Priority priority = Task::NORMAL );
+	//! runs \a fn on the main thread, the next time processMainThread() is called
+	TaskRef submitToMainThread( std::function<void()> fn );
+
+	//! splits [\a begin, \a end) into one range per thread and calls \a fn( rangeBegin, rangeEnd ) for each of them,
+	//! returning when all are done. The calling thread processes the first range itself. All ranges but the last are a
+	//! multiple of \a granularity in size, e.g. to keep them aligned for SIMD. If the scheduler is not running or if
+	//! called from a worker thread, simply calls \a fn( begin, end ). Exceptions thrown by \a fn are rethrown.
+	void parallelFor( size_t begin, size_t end, const std::function<void( size_t, size_t )> &fn, size_t granularity = 1 );
+
+	//! runs the tasks queued for the main thread, call this from your App::update(). If \a maxSeconds is larger
+	//! than zero, stops after that amount of time and leaves the remaining tasks for the next frame.
+	//! Returns the number of tasks that were run.
+	size_t processMainThread( double maxSeconds = 0.0 );
+
+	//! returns TRUE if called from one of the worker threads
+	bool isWorkerThread() const;
+	size_t getNumWorkers() const { return mWorkers.size(); }
+	//! returns FALSE after shutdown() has been called
+	bool isRunning() const { return !mShouldQuit; }
+
+	//! terminates all worker threads. Queued tasks are cancelled, as are tasks submitted afterwards.
+	//! Call before terminating the application.
+	void shutdown();
+
+  private:
+	TaskScheduler( void );
+	~TaskScheduler( void );
+
+	struct Worker {
+		std::mutex          mMutex;
+		std::deque<TaskRef> mTasks[Task::NUM_PRIORITIES];
+	};
+
+	friend class Task;
+
+	//! queues a task for a worker thread or the main thread
+	void schedule( const TaskRef &task );
+
+	//! the main loop of a worker thread
+	void work( size_t index );
+	//! pops a task from worker \a index, or steals one from another worker
+	bool fetch( size_t index, TaskRef &task );
+
+  private:
+	std::vector<std::unique_ptr<Worker>>      mWorkers;
+	std::vector<std::unique_ptr<std::thread>> mThreads;
+
+	//! number of tasks queued for the worker threads, used to put idle workers to sleep
+	std::atomic<size_t>     mPending;
+	std::atomic<size_t>     mNext;
+	std::atomic<bool>       mShouldQuit;
+	std::mutex              mSleepMutex;
+	std::condition_variable mSleepCondition;
+
+	std::deque<TaskRef> mMainThreadTasks;
+	std::mutex          mMainThreadMutex;
+};
+
+} // namespace ph
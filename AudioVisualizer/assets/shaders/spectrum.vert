@@ -19,7 +19,7 @@ void main(void)
 	vec2 coord = ciTexCoord0 + vec2(0.0, uTexOffset);
 
 	// retrieve the FFT from left and right texture and average it
-	float fft = max(0.0001, mix( texture( uLeftTex, coord ).r, texture( uRightTex, coord ).r, 0.0));
+	float fft = max(0.0001, mix( texture( uLeftTex, coord ).r, texture( uRightTex, coord ).r, 0.5));
 
 	// convert to decibels
 	const float kLogBase2 = 1.0 / log(2.0);
@@ -0,0 +1,102 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "SpectrumAnalyzer.h"
+
+#include <functional>
+
+//! Renders the spectrum of a complete audio stream, faster than real time. The audio is read sequentially and cut
+//! into chunks, which are analyzed in parallel by the TaskScheduler. Each chunk is preceded by enough of the previous
+//! audio to fill the transform window and let the smoothing settle, so the rows are the same as those of a single
+//! SpectrumAnalyzer running over the whole stream. Rows are passed on in order.
+class SpectrogramRenderer {
+  public:
+	//! which bands are written for each row
+	enum Layout {
+		//! the average of the left and right channel, like the AudioVisualizer shader
+		MIX,
+		LEFT,
+		RIGHT,
+		//! the left channel, followed by the right channel
+		STEREO
+	};
+
+	struct Options {
+		Options()
+		    : frameRate( 0.0 )
+		    , chunkFrames( 1 << 20 )
+		    , maxChunksInFlight( 0 )
+		    , layout( MIX )
+		{
+		}
+
+		//! format of the analysis, defaults to the one used by AudioVisualizerApp
+		SpectrumAnalyzer::Format analysis;
+		//! if larger than zero, writes one row per video frame instead of one row per hop, using the most recent
+		//! row at the time of each frame like AudioVisualizerApp::update() does
+		double frameRate;
+		//! number of samples per chunk, rounded up to a multiple of the hop size
+		size_t chunkFrames;
+		//! limits the memory used by chunks that are queued or waiting to be written. If zero, uses twice the
+		//! number of worker threads.
+		size_t maxChunksInFlight;
+		Layout layout;
+	};
+
+	//! reads up to \a maxFrames samples of both channels, returns the number of frames read or zero at the end
+	typedef std::function<size_t( float *left, float *right, size_t maxFrames )> ReadFn;
+	//! called for every row, in order
+	typedef std::function<void( const float *row )> RowFn;
+
+	SpectrogramRenderer( size_t sampleRate, const Options &options = Options() );
+
+	const Options &getOptions() const { return mOptions; }
+
+	//! returns the number of floats per row
+	size_t getRowWidth() const { return mOptions.layout == STEREO ? 2 * mNumBands : mNumBands; }
+	//! returns the number of rows per second of audio
+	double getRowRate() const;
+
+	//! reads all audio from \a readFn and calls \a rowFn for every row. Returns the number of rows.
+	size_t render( const ReadFn &readFn, const RowFn &rowFn );
+
+  private:
+	struct Chunk;
+
+	//! passes the rows of a finished chunk on to \a rowFn
+	void write( const Chunk &chunk, const RowFn &rowFn );
+	//! converts the bands of both channels to a row in the requested layout
+	void combine( const float *left, const float *right, float *row ) const;
+
+  private:
+	Options mOptions;
+	size_t  mSampleRate;
+	size_t  mNumBands;
+	size_t  mHopSize;
+
+	// state of the writer
+	std::vector<float> mRow;
+	size_t             mNumRowsAnalyzed;
+	size_t             mNumRowsWritten;
+};
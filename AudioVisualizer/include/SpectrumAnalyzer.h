@@ -0,0 +1,114 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/audio/Buffer.h"
+#include "cinder/audio/dsp/Dsp.h"
+#include "cinder/audio/dsp/Fft.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+//! Turns stereo audio into rows of logarithmically spaced frequency bands, one row for every hop. It has no
+//! dependency on the audio graph or any thread, so it can be fed from a live capture node as well as from a file.
+class SpectrumAnalyzer {
+  public:
+	struct Format {
+		Format()
+		    : fftSize( 4096 )
+		    , hopSize( 512 )
+		    , windowType( ci::audio::dsp::WindowType::BLACKMAN )
+		    , numBands( 1024 )
+		    , minFrequency( 20.0f )
+		    , maxFrequency( 16000.0f )
+		    , smoothing( 0.5f )
+		{
+		}
+
+		//! number of samples per transform, must be a power of two
+		size_t fftSize;
+		//! number of samples between two transforms, the overlap is ( fftSize - hopSize )
+		size_t hopSize;
+		//! window applied to the samples before the transform
+		ci::audio::dsp::WindowType windowType;
+		//! number of frequency bands per row
+		size_t numBands;
+		//! center of the lowest band in Hz
+		float minFrequency;
+		//! center of the highest band in Hz, limited to the Nyquist frequency
+		float maxFrequency;
+		//! factor in the range [0, 1) used to smooth each band over time, 0 means no smoothing
+		float smoothing;
+	};
+
+	//! called for every finished row with the bands of the left and right channel
+	typedef std::function<void( const float *left, const float *right )> RowFn;
+
+	SpectrumAnalyzer( size_t sampleRate, const Format &format = Format() );
+
+	const Format &getFormat() const { return mFormat; }
+	size_t        getSampleRate() const { return mSampleRate; }
+	size_t        getNumBands() const { return mFormat.numBands; }
+
+	//! returns the number of rows per second of audio
+	double getRowRate() const { return double( mSampleRate ) / mFormat.hopSize; }
+
+	//! analyzes \a numFrames samples of both channels and calls \a rowFn for every finished row. Samples are
+	//! buffered between calls, so the audio can be passed in blocks of any size. Returns the number of rows.
+	size_t process( const float *left, const float *right, size_t numFrames, const RowFn &rowFn );
+
+	//! clears all buffered samples and the smoothed bands
+	void reset();
+
+  private:
+	//! maps transform bins to a single band: the average of \a count bins starting at \a first, or if the band is
+	//! narrower than a bin, the value interpolated between bin \a first and the next one
+	struct Band {
+		size_t first;
+		size_t count;
+		float  fraction;
+	};
+
+	void createBands();
+	void analyze( size_t channel );
+
+  private:
+	Format mFormat;
+	size_t mSampleRate;
+
+	std::unique_ptr<ci::audio::dsp::Fft> mFft;
+	ci::audio::Buffer                    mFftBuffer;
+	ci::audio::BufferSpectral            mBufferSpectral;
+	std::vector<float>                   mWindow;
+	std::vector<float>                   mMagnitudes;
+	std::vector<Band>                    mBands;
+
+	//! the most recent fftSize samples of each channel, stored as a circular buffer
+	std::vector<float> mSamples[2];
+	//! the smoothed bands of each channel
+	std::vector<float> mRow[2];
+
+	size_t mWritePos;
+	size_t mSamplesUntilHop;
+};
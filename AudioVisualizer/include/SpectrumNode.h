@@ -0,0 +1,79 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "SpectrumAnalyzer.h"
+
+#include "cinder/audio/Node.h"
+#include "cinder/audio/dsp/RingBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::shared_ptr<class SpectrumNode> SpectrumNodeRef;
+
+//! Captures the left and right channel of the audio passing through it and analyzes them on a separate thread.
+//! The audio thread only copies samples into a lock-free single-producer/single-consumer ring buffer. The analysis
+//! thread turns them into rows of frequency bands and passes finished rows on through a second ring buffer, so the
+//! render thread only has to copy the most recent row.
+class SpectrumNode : public ci::audio::Node {
+  public:
+	SpectrumNode( const SpectrumAnalyzer::Format &analysis = SpectrumAnalyzer::Format(), const Format &format = Format() );
+	virtual ~SpectrumNode();
+
+	size_t getNumBands() const { return mAnalysisFormat.numBands; }
+
+	//! copies the most recent finished row into \a left and \a right, which should both hold getNumBands() floats.
+	//! Older rows that have not been read yet are skipped. Returns FALSE if no row has been finished since the last call.
+	bool readRow( float *left, float *right );
+
+	//! returns the number of blocks that were dropped because the analysis thread could not keep up
+	size_t getNumDroppedBlocks() const { return mNumDroppedBlocks; }
+
+  protected:
+	void initialize() override;
+	void uninitialize() override;
+	void process( ci::audio::Buffer *buffer ) override;
+
+  private:
+	void run( size_t sampleRate, size_t framesPerBlock );
+
+  private:
+	SpectrumAnalyzer::Format mAnalysisFormat;
+
+	std::unique_ptr<ci::audio::dsp::RingBufferT<float>> mSamples[2];
+	std::unique_ptr<ci::audio::dsp::RingBufferT<float>> mRows;
+
+	std::thread         mThread;
+	std::atomic<bool>   mIsRunning;
+	std::atomic<size_t> mNumDroppedBlocks;
+
+	//! wakes up the analysis thread when it should stop. New samples are polled, see run().
+	std::mutex              mMutex;
+	std::condition_variable mCondition;
+};
@@ -0,0 +1,79 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+//! A single vertex of the terrain, interleaved so the whole grid can be uploaded as one buffer.
+struct TerrainVertex {
+	ci::vec3   position;
+	ci::Colorf color;
+	ci::vec2   texCoord;
+};
+
+//! Generates the static grid that is deformed by the spectrum in the vertex shader. The vertices and indices are
+//! written in parallel into buffers that are kept between builds, so changing the resolution only allocates memory
+//! if the grid is larger than any grid built before.
+class TerrainGrid {
+  public:
+	TerrainGrid();
+
+	//! generates a grid of \a width by \a height vertices, spread out evenly over an area of \a size
+	void build( size_t width, size_t height, const ci::vec2 &size );
+
+	size_t getWidth() const { return mWidth; }
+	size_t getHeight() const { return mHeight; }
+
+	size_t getNumVertices() const { return mWidth * mHeight; }
+	size_t getNumIndices() const { return mWidth > 1 && mHeight > 1 ? 6 * ( mWidth - 1 ) * ( mHeight - 1 ) : 0; }
+
+	//! returns the vertices, the buffer may be larger than getNumVertices()
+	const TerrainVertex *getVertices() const { return mVertices.data(); }
+	//! returns the indices, the buffer may be larger than getNumIndices()
+	const uint32_t *getIndices() const { return mIndices.data(); }
+
+	//! if disabled, builds the grid on the calling thread only
+	void setMultithreaded( bool enabled = true ) { mMultithreaded = enabled; }
+	bool isMultithreaded() const { return mMultithreaded; }
+
+  private:
+	//! writes the vertices and indices of rows [\a begin, \a end)
+	void buildRows( size_t begin, size_t end );
+
+  private:
+	size_t   mWidth;
+	size_t   mHeight;
+	ci::vec2 mSize;
+	bool     mMultithreaded;
+
+	std::vector<TerrainVertex> mVertices;
+	std::vector<uint32_t>      mIndices;
+
+	//! the texture coordinate and color only depend on the column, so they are computed once per column
+	std::vector<float>      mColumnCoords;
+	std::vector<ci::Colorf> mColumnColors;
+};
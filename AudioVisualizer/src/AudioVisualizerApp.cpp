@@ -25,14 +25,20 @@
 #include "cinder/Channel.h"
 #include "cinder/ImageIo.h"
 #include "cinder/Rand.h"
+#include "cinder/Timer.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/audio/audio.h"
 #include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Pbo.h"
 #include "cinder/gl/Texture.h"
 #include "cinder/gl/Vbo.h"
 #include "cinder/gl/gl.h"
 
+#include "SpectrumNode.h"
+#include "TaskScheduler.h"
+#include "TerrainGrid.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -68,8 +74,22 @@ class AudioVisualizerApp : public App {
 	// stop playing the current audio file
 	void stopAudio();
 
+	// returns the number of bytes uploaded to the spectrum textures during the last frame
+	size_t getUploadedBytes() const { return mUploadedBytes; }
+
+  private:
+	// (re)creates the mesh with the given number of vertices in each direction
+	void createMesh( size_t width, size_t height );
+	// measures how long it takes to build the mesh at a few resolutions
+	void benchmarkMesh();
+
+	// uploads the rows of the spectrum history that have changed since the last frame
+	void uploadRows();
+	// uploads a single row of the channel to the texture, either directly or through a pixel buffer
+	void uploadRow( const gl::Texture2dRef &texture, const Channel32f &channel, uint32_t row );
+
   private:
-	// width and height of our mesh
+	// width and height of our mesh, also its default resolution
 	static const int kWidth = 512;
 	static const int kHeight = 512;
 
@@ -77,6 +97,9 @@ class AudioVisualizerApp : public App {
 	static const int kBands = 1024;
 	static const int kHistory = 128;
 
+	// number of pixel buffers to cycle through, enough for the rows of a few frames
+	static const int kPixelBuffers = 8;
+
 	Channel32f            mChannelLeft;
 	Channel32f            mChannelRight;
 	CameraPersp           mCamera;
@@ -86,10 +109,26 @@ class AudioVisualizerApp : public App {
 	gl::Texture2dRef      mTextureRight;
 	gl::Texture2d::Format mTextureFormat;
 	gl::VboMeshRef        mMesh;
+	gl::VboRef            mVertexVbo;
+	gl::VboRef            mIndexVbo;
+	TerrainGrid           mGrid;
 	uint32_t              mOffset;
 
-	audio::VoiceRef               mAudioFile;
-	audio::MonitorSpectralNodeRef mMonitorSpectralNode;
+	// rows of the channels that have changed, but have not been uploaded yet
+	vector<uint32_t> mDirtyRows;
+
+	vector<gl::PboRef> mPixelBuffers;
+	size_t             mPixelBufferIndex = 0;
+	bool               mUsePixelBuffers = true;
+	size_t             mUploadedBytes = 0;
+	bool               mShowInfo = false;
+
+	audio::VoiceRef mAudioFile;
+	SpectrumNodeRef mSpectrumNode;
+
+	// the most recent spectrum of the left and right channel
+	vector<float> mSpectrumLeft;
+	vector<float> mSpectrumRight;
 
 	bool   mIsMouseDown = false;
 	bool   mIsAudioPlaying = false;
@@ -132,6 +171,9 @@ void AudioVisualizerApp::setup()
 	memset( mChannelLeft.getData(), 0, mChannelLeft.getRowBytes() * kHistory );
 	memset( mChannelRight.getData(), 0, mChannelRight.getRowBytes() * kHistory );
 
+	mSpectrumLeft.assign( kBands, 0.0f );
+	mSpectrumRight.assign( kBands, 0.0f );
+
 	// create texture format (wrap the y-axis, clamp the x-axis)
 	mTextureFormat.setWrapS( GL_CLAMP_TO_BORDER );
 	mTextureFormat.setWrapT( GL_REPEAT );
@@ -139,6 +181,14 @@ void AudioVisualizerApp::setup()
 	mTextureFormat.setMagFilter( GL_LINEAR );
 	mTextureFormat.loadTopDown( true );
 
+	// create the textures once, they will be updated one row at a time
+	mTextureLeft = gl::Texture2d::create( mChannelLeft, mTextureFormat );
+	mTextureRight = gl::Texture2d::create( mChannelRight, mTextureFormat );
+
+	// create a ring of pixel buffers, each large enough to hold a single row
+	for( int i = 0; i < kPixelBuffers; ++i )
+		mPixelBuffers.push_back( gl::Pbo::create( GL_PIXEL_UNPACK_BUFFER, kBands * sizeof( float ), nullptr, GL_STREAM_DRAW ) );
+
 	// compile shader
 	try {
 		mShader = gl::GlslProg::create( loadAsset( "shaders/spectrum.vert" ), loadAsset( "shaders/spectrum.frag" ) );
@@ -150,52 +200,7 @@ void AudioVisualizerApp::setup()
 	}
 
 	// create static mesh (all animation is done in the vertex shader)
-	std::vector<vec3>     positions;
-	std::vector<Colorf>   colors;
-	std::vector<vec2>     coords;
-	std::vector<uint32_t> indices;
-
-	for( size_t h = 0; h < kHeight; ++h ) {
-		for( size_t w = 0; w < kWidth; ++w ) {
-			// add polygon indices
-			if( h < kHeight - 1 && w < kWidth - 1 ) {
-				size_t offset = positions.size();
-
-				indices.emplace_back( offset );
-				indices.emplace_back( offset + kWidth );
-				indices.emplace_back( offset + kWidth + 1 );
-				indices.emplace_back( offset );
-				indices.emplace_back( offset + kWidth + 1 );
-				indices.emplace_back( offset + 1 );
-			}
-
-			// add vertex
-			positions.emplace_back( vec3( float( w ), 0, float( h ) ) );
-
-			// add texture coordinates
-			// note: we only want to draw the lower part of the frequency bands,
-			//  so we scale the coordinates a bit
-			const float part = 0.5f;
-			const float s = w / float( kWidth - 1 );
-			const float t = h / float( kHeight - 1 );
-			coords.emplace_back( vec2( part - part * s, t ) );
-
-			// add vertex colors
-			colors.emplace_back( Color( CM_HSV, s, 0.5f, 0.75f ) );
-		}
-	}
-
-	gl::VboMesh::Layout layout;
-	layout.usage( GL_STATIC_DRAW );
-	layout.attrib( geom::Attrib::POSITION, 3 );
-	layout.attrib( geom::Attrib::COLOR, 3 );
-	layout.attrib( geom::Attrib::TEX_COORD_0, 2 );
-
-	mMesh = gl::VboMesh::create( positions.size(), GL_TRIANGLES, { layout }, indices.size(), GL_UNSIGNED_INT );
-	mMesh->bufferAttrib( geom::POSITION, positions.size() * sizeof( vec3 ), positions.data() );
-	mMesh->bufferAttrib( geom::COLOR, colors.size() * sizeof( vec3 ), colors.data() );
-	mMesh->bufferAttrib( geom::TEX_COORD_0, coords.size() * sizeof( vec2 ), coords.data() );
-	mMesh->bufferIndices( indices.size() * sizeof( uint32_t ), indices.data() );
+	createMesh( kWidth, kHeight );
 
 	// setup audio
 	// FMOD::System_Create( &mFMODSystem );
@@ -222,6 +227,9 @@ void AudioVisualizerApp::cleanup()
 
 	// if( mFMODSystem )
 	//	mFMODSystem->release();
+
+	// stop the worker threads that build the mesh
+	ph::TaskScheduler::getInstance().shutdown();
 }
 
 void AudioVisualizerApp::update()
@@ -243,12 +251,21 @@ void AudioVisualizerApp::update()
 	// mFMODSystem->getSpectrum( pDataLeft, kBands, 0, FMOD_DSP_FFT_WINDOW_HANNING );
 	// mFMODSystem->getSpectrum( pDataRight, kBands, 1, FMOD_DSP_FFT_WINDOW_HANNING );
 
-	if( mMonitorSpectralNode ) {
-		const auto spectrum = mMonitorSpectralNode->getMagSpectrum();
-		if( spectrum.size() >= kBands )
-			memcpy( pDataLeft, spectrum.data(), kBands * sizeof( float ) );
+	// the spectrum is analyzed on a separate thread, we only have to copy the most recent row (if any)
+	if( mSpectrumNode && mAudioFile && mAudioFile->isPlaying() ) {
+		mSpectrumNode->readRow( mSpectrumLeft.data(), mSpectrumRight.data() );
+	}
+	else {
+		std::fill( mSpectrumLeft.begin(), mSpectrumLeft.end(), 0.0f );
+		std::fill( mSpectrumRight.begin(), mSpectrumRight.end(), 0.0f );
 	}
 
+	memcpy( pDataLeft, mSpectrumLeft.data(), kBands * sizeof( float ) );
+	memcpy( pDataRight, mSpectrumRight.data(), kBands * sizeof( float ) );
+
+	// this row needs to be uploaded
+	mDirtyRows.push_back( mOffset );
+
 	// increment texture offset
 	mOffset = ( mOffset + 1 ) % kHistory;
 
@@ -258,6 +275,8 @@ void AudioVisualizerApp::update()
 	memset( pDataLeft, 0, kBands * sizeof( float ) );
 	memset( pDataRight, 0, kBands * sizeof( float ) );
 
+	mDirtyRows.push_back( mOffset );
+
 	// animate camera if mouse has not been down for more than 30 seconds
 	if( !mIsMouseDown && ( getElapsedSeconds() - mMouseUpTime ) > mMouseUpDelay ) {
 		const float t = float( getElapsedSeconds() );
@@ -280,6 +299,9 @@ void AudioVisualizerApp::draw()
 {
 	gl::clear();
 
+	// upload the new spectrum data
+	uploadRows();
+
 	// use camera
 	gl::pushMatrices();
 	gl::setMatrices( mCamera );
@@ -290,10 +312,7 @@ void AudioVisualizerApp::draw()
 		mShader->uniform( "uLeftTex", 0 );
 		mShader->uniform( "uRightTex", 1 );
 
-		// create textures from our channels and bind them
-		mTextureLeft = gl::Texture2d::create( mChannelLeft, mTextureFormat );
-		mTextureRight = gl::Texture2d::create( mChannelRight, mTextureFormat );
-
+		// bind textures
 		gl::ScopedTextureBind tex0( mTextureLeft, 0 );
 		gl::ScopedTextureBind tex1( mTextureRight, 1 );
 
@@ -303,6 +322,125 @@ void AudioVisualizerApp::draw()
 		gl::draw( mMesh );
 	}
 	gl::popMatrices();
+
+	// show upload statistics
+	if( mShowInfo ) {
+		std::stringstream str;
+		str << "Uploaded " << mUploadedBytes << " bytes ";
+		str << ( mUsePixelBuffers ? "using pixel buffers" : "directly" );
+		gl::drawString( str.str(), vec2( 10, 10 ) );
+
+		str.str( "" );
+		str << "Mesh: " << mGrid.getWidth() << " x " << mGrid.getHeight() << " vertices";
+		gl::drawString( str.str(), vec2( 10, 25 ) );
+	}
+}
+
+void AudioVisualizerApp::createMesh( size_t width, size_t height )
+{
+	// generate the grid in parallel, reusing the memory of the previous grid
+	mGrid.build( width, height, vec2( kWidth - 1, kHeight - 1 ) );
+
+	const size_t vertexBytes = mGrid.getNumVertices() * sizeof( TerrainVertex );
+	const size_t indexBytes = mGrid.getNumIndices() * sizeof( uint32_t );
+
+	// only create new buffers if the grid does not fit in the current ones
+	if( !mVertexVbo || mVertexVbo->getSize() < vertexBytes )
+		mVertexVbo = gl::Vbo::create( GL_ARRAY_BUFFER, vertexBytes, mGrid.getVertices(), GL_STATIC_DRAW );
+	else
+		mVertexVbo->bufferSubData( 0, vertexBytes, mGrid.getVertices() );
+
+	if( !mIndexVbo || mIndexVbo->getSize() < indexBytes )
+		mIndexVbo = gl::Vbo::create( GL_ELEMENT_ARRAY_BUFFER, indexBytes, mGrid.getIndices(), GL_STATIC_DRAW );
+	else
+		mIndexVbo->bufferSubData( 0, indexBytes, mGrid.getIndices() );
+
+	// the mesh itself is cheap to create, it only refers to the buffers
+	geom::BufferLayout layout;
+	layout.append( geom::Attrib::POSITION, 3, sizeof( TerrainVertex ), offsetof( TerrainVertex, position ) );
+	layout.append( geom::Attrib::COLOR, 3, sizeof( TerrainVertex ), offsetof( TerrainVertex, color ) );
+	layout.append( geom::Attrib::TEX_COORD_0, 2, sizeof( TerrainVertex ), offsetof( TerrainVertex, texCoord ) );
+
+	mMesh = gl::VboMesh::create( uint32_t( mGrid.getNumVertices() ), GL_TRIANGLES, { { layout, mVertexVbo } }, uint32_t( mGrid.getNumIndices() ), GL_UNSIGNED_INT, mIndexVbo );
+}
+
+void AudioVisualizerApp::benchmarkMesh()
+{
+	static const size_t kSizes[] = { 512, 2048 };
+
+	console() << "Benchmarking mesh generation:" << std::endl;
+	console() << "size	threads	first build (ms)	rebuild (ms)" << std::endl;
+
+	for( size_t size : kSizes ) {
+		for( bool multithreaded : { false, true } ) {
+			// use a separate grid, so the first build has to allocate its memory
+			TerrainGrid grid;
+			grid.setMultithreaded( multithreaded );
+
+			Timer timer( true );
+			grid.build( size, size, vec2( kWidth - 1, kHeight - 1 ) );
+			const double first = timer.getSeconds();
+
+			// rebuilding reuses the memory
+			const int kRuns = 5;
+			timer.start();
+			for( int i = 0; i < kRuns; ++i )
+				grid.build( size, size, vec2( kWidth - 1, kHeight - 1 ) );
+			const double rebuild = timer.getSeconds() / kRuns;
+
+			const size_t threads = multithreaded ? ph::TaskScheduler::getInstance().getNumWorkers() + 1 : 1;
+			console() << size << "\t" << threads << "\t" << 1000.0 * first << "\t" << 1000.0 * rebuild << std::endl;
+		}
+	}
+}
+
+void AudioVisualizerApp::uploadRows()
+{
+	mUploadedBytes = 0;
+
+	if( mDirtyRows.empty() )
+		return;
+
+	// remove duplicates, in case update() has been called more than once since the last frame
+	std::sort( mDirtyRows.begin(), mDirtyRows.end() );
+	mDirtyRows.erase( std::unique( mDirtyRows.begin(), mDirtyRows.end() ), mDirtyRows.end() );
+
+	for( uint32_t row : mDirtyRows ) {
+		uploadRow( mTextureLeft, mChannelLeft, row );
+		uploadRow( mTextureRight, mChannelRight, row );
+	}
+
+	mDirtyRows.clear();
+}
+
+void AudioVisualizerApp::uploadRow( const gl::Texture2dRef &texture, const Channel32f &channel, uint32_t row )
+{
+	const size_t rowBytes = kBands * sizeof( float );
+	const float *data = channel.getData() + kBands * row;
+
+	gl::ScopedTextureBind scpTexture( texture );
+
+	if( mUsePixelBuffers ) {
+		// use the next buffer in the ring, so we don't have to wait for the driver to finish with the previous one
+		const gl::PboRef &pbo = mPixelBuffers[mPixelBufferIndex];
+		mPixelBufferIndex = ( mPixelBufferIndex + 1 ) % mPixelBuffers.size();
+
+		gl::ScopedBuffer scpBuffer( pbo );
+
+		void *ptr = pbo->mapReplace();
+		if( ptr ) {
+			memcpy( ptr, data, rowBytes );
+			pbo->unmap();
+
+			// the data pointer is an offset into the bound pixel buffer
+			glTexSubImage2D( texture->getTarget(), 0, 0, GLint( row ), kBands, 1, GL_RED, GL_FLOAT, nullptr );
+			mUploadedBytes += rowBytes;
+			return;
+		}
+	}
+
+	glTexSubImage2D( texture->getTarget(), 0, 0, GLint( row ), kBands, 1, GL_RED, GL_FLOAT, data );
+	mUploadedBytes += rowBytes;
 }
 
 void AudioVisualizerApp::mouseDown( MouseEvent event )
@@ -346,6 +484,25 @@ void AudioVisualizerApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_f:
 		setFullScreen( !isFullScreen() );
 		break;
+	case KeyEvent::KEY_i:
+		mShowInfo = !mShowInfo;
+		break;
+	case KeyEvent::KEY_u:
+		mUsePixelBuffers = !mUsePixelBuffers;
+		break;
+	case KeyEvent::KEY_LEFTBRACKET:
+		// halve the resolution of the mesh
+		if( mGrid.getWidth() > 64 )
+			createMesh( mGrid.getWidth() / 2, mGrid.getHeight() / 2 );
+		break;
+	case KeyEvent::KEY_RIGHTBRACKET:
+		// double the resolution of the mesh
+		if( mGrid.getWidth() < 2048 )
+			createMesh( mGrid.getWidth() * 2, mGrid.getHeight() * 2 );
+		break;
+	case KeyEvent::KEY_b:
+		benchmarkMesh();
+		break;
 	case KeyEvent::KEY_o:
 		playAudio( openAudio( mAudioPath ) );
 		break;
@@ -501,10 +658,13 @@ void AudioVisualizerApp::playAudio( const fs::path &file )
 
 	auto ctx = audio::Context::master();
 
-	mMonitorSpectralNode = ctx->makeNode( new audio::MonitorSpectralNode( audio::MonitorSpectralNode::Format().channels( 1 ).windowSize( kBands * 8 ).fftSize( kBands * 8 ) ) );
+	SpectrumAnalyzer::Format analysis;
+	analysis.numBands = kBands;
+
+	mSpectrumNode = ctx->makeNode( new SpectrumNode( analysis ) );
 
 	mAudioFile = audio::Voice::create( audio::load( loadFile( file ) ), audio::Voice::Options().connectToMaster( false ) );
-	mAudioFile->getOutputNode() >> mMonitorSpectralNode >> ctx->getOutput();
+	mAudioFile->getOutputNode() >> mSpectrumNode >> ctx->getOutput();
 	mAudioFile->start();
 
 	// keep track of the audio file
@@ -521,14 +681,18 @@ void AudioVisualizerApp::stopAudio()
 
 	mIsAudioPlaying = false;
 
-	// if( !mFMODChannel || !mFMODSound )
-	if( !mAudioFile || !mAudioFile->isPlaying() )
-		return;
-
-	mAudioFile->stop();
+	// disconnect the voice and the analysis node even if the audio has already ended,
+	//  otherwise they would stay connected to the output and keep the analysis thread running
+	if( mAudioFile ) {
+		mAudioFile->stop();
+		mAudioFile->getOutputNode()->disconnectAll();
+		mAudioFile.reset();
+	}
 
-	mMonitorSpectralNode.reset();
-	mAudioFile.reset();
+	if( mSpectrumNode ) {
+		mSpectrumNode->disconnectAll();
+		mSpectrumNode.reset();
+	}
 
 	// we don't want to be notified of channel events any longer
 	// mFMODChannel->setCallback( 0 );
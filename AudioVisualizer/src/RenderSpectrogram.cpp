@@ -0,0 +1,215 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Renders the AudioVisualizer spectrogram of an audio file without a window or sound hardware, faster than
+// real time. The rows are written as raw 32-bit floats, either to a single file or to a sequence of files,
+// together with a small JSON file describing the layout. Usage:
+//
+//   RenderSpectrogram --in <audio file> --out <raw file> [--fps 60] [--layout mix|left|right|stereo]
+//                     [--rows-per-file 0] [--fft 4096] [--hop 512] [--smoothing 0.5]
+
+#include "SpectrogramRenderer.h"
+#include "TaskScheduler.h"
+
+#include "cinder/DataSource.h"
+#include "cinder/Filesystem.h"
+#include "cinder/audio/Source.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+//! returns the path of file \a index of a sequence, e.g. "spectrum_00012.raw"
+fs::path getSequencePath( const fs::path &path, size_t index )
+{
+	char suffix[16];
+	snprintf( suffix, sizeof( suffix ), "_%05u", unsigned( index ) );
+
+	return path.parent_path() / ( path.stem().string() + suffix + path.extension().string() );
+}
+
+int render( const map<string, string> &args )
+{
+	const fs::path input = args.at( "--in" );
+	const fs::path output = args.at( "--out" );
+
+	auto getArg = [&]( const string &name, const string &defaultValue ) {
+		auto itr = args.find( name );
+		return itr != args.end() ? itr->second : defaultValue;
+	};
+
+	SpectrogramRenderer::Options options;
+	options.frameRate = atof( getArg( "--fps", "0" ).c_str() );
+	options.analysis.fftSize = size_t( strtoul( getArg( "--fft", "4096" ).c_str(), nullptr, 10 ) );
+	options.analysis.hopSize = size_t( strtoul( getArg( "--hop", "512" ).c_str(), nullptr, 10 ) );
+	options.analysis.smoothing = float( atof( getArg( "--smoothing", "0.5" ).c_str() ) );
+
+	const string layout = getArg( "--layout", "mix" );
+	if( layout == "left" )
+		options.layout = SpectrogramRenderer::LEFT;
+	else if( layout == "right" )
+		options.layout = SpectrogramRenderer::RIGHT;
+	else if( layout == "stereo" )
+		options.layout = SpectrogramRenderer::STEREO;
+	else if( layout == "mix" )
+		options.layout = SpectrogramRenderer::MIX;
+	else
+		throw std::invalid_argument( "unknown layout: " + layout );
+
+	const size_t fftSize = options.analysis.fftSize;
+	if( fftSize < 2 || ( fftSize & ( fftSize - 1 ) ) != 0 )
+		throw std::invalid_argument( "the FFT size must be a power of two" );
+
+	const size_t rowsPerFile = size_t( strtoul( getArg( "--rows-per-file", "0" ).c_str(), nullptr, 10 ) );
+
+	// decode the file at its own sample rate. Note: passing a sample rate prevents the audio context,
+	// and with it the sound hardware, from being initialized.
+	audio::SourceFileRef source = audio::load( loadFile( input ), 44100 );
+	source->setOutputFormat( source->getSampleRateNative() );
+
+	const size_t sampleRate = source->getSampleRate();
+	const size_t numChannels = source->getNumChannels();
+
+	// decoded frames that have not been passed on yet
+	audio::Buffer buffer( source->getMaxFramesPerRead(), numChannels );
+	size_t        bufferPos = 0;
+	size_t        bufferFrames = 0;
+
+	auto readFn = [&]( float *left, float *right, size_t maxFrames ) -> size_t {
+		if( bufferPos == bufferFrames ) {
+			if( source->getReadPosition() >= source->getNumFrames() )
+				return 0;
+
+			bufferFrames = source->read( &buffer );
+			bufferPos = 0;
+		}
+
+		const size_t numFrames = std::min( maxFrames, bufferFrames - bufferPos );
+
+		// mono files are used for both channels, only the first two channels of other files are used
+		const float *l = buffer.getChannel( 0 ) + bufferPos;
+		const float *r = buffer.getChannel( numChannels > 1 ? 1 : 0 ) + bufferPos;
+		std::copy( l, l + numFrames, left );
+		std::copy( r, r + numFrames, right );
+
+		bufferPos += numFrames;
+		return numFrames;
+	};
+
+	// write the rows
+	SpectrogramRenderer renderer( sampleRate, options );
+
+	const size_t rowBytes = renderer.getRowWidth() * sizeof( float );
+	size_t       numRows = 0;
+	size_t       numFiles = 0;
+	ofstream     file;
+
+	auto rowFn = [&]( const float *row ) {
+		if( !file.is_open() || ( rowsPerFile > 0 && numRows % rowsPerFile == 0 ) ) {
+			const fs::path path = rowsPerFile > 0 ? getSequencePath( output, numFiles ) : output;
+
+			file.close();
+			file.open( path.string().c_str(), ios::binary | ios::trunc );
+			if( !file )
+				throw std::runtime_error( "could not write to " + path.string() );
+
+			numFiles++;
+		}
+
+		file.write( reinterpret_cast<const char *>( row ), rowBytes );
+		numRows++;
+	};
+
+	const auto start = chrono::steady_clock::now();
+	renderer.render( readFn, rowFn );
+	const double seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+
+	file.close();
+
+	// describe the layout of the rows, so other tools can read them
+	const SpectrumAnalyzer::Format &format = renderer.getOptions().analysis;
+	const double                    duration = double( source->getNumFrames() ) / sampleRate;
+
+	ofstream json( ( output.string() + ".json" ).c_str() );
+	json << "{" << endl;
+	json << "  \"source\": \"" << input.filename().string() << "\"," << endl;
+	json << "  \"sampleRate\": " << sampleRate << "," << endl;
+	json << "  \"duration\": " << duration << "," << endl;
+	json << "  \"width\": " << renderer.getRowWidth() << "," << endl;
+	json << "  \"height\": " << numRows << "," << endl;
+	json << "  \"rowsPerSecond\": " << renderer.getRowRate() << "," << endl;
+	json << "  \"rowsPerFile\": " << ( rowsPerFile > 0 ? rowsPerFile : numRows ) << "," << endl;
+	json << "  \"files\": " << numFiles << "," << endl;
+	json << "  \"layout\": \"" << layout << "\"," << endl;
+	json << "  \"format\": \"float32\"," << endl;
+	json << "  \"fftSize\": " << format.fftSize << "," << endl;
+	json << "  \"hopSize\": " << format.hopSize << "," << endl;
+	json << "  \"bands\": " << format.numBands << "," << endl;
+	json << "  \"minFrequency\": " << format.minFrequency << "," << endl;
+	json << "  \"maxFrequency\": " << format.maxFrequency << "," << endl;
+	json << "  \"smoothing\": " << format.smoothing << endl;
+	json << "}" << endl;
+
+	cerr << "Rendered " << numRows << " rows from " << duration << " seconds of audio in " << seconds << " seconds ";
+	cerr << "(" << duration / seconds << "x real time)." << endl;
+
+	return 0;
+}
+
+} // namespace
+
+int main( int argc, char *argv[] )
+{
+	map<string, string> args;
+	for( int i = 1; i + 1 < argc; i += 2 )
+		args[argv[i]] = argv[i + 1];
+
+	if( args.count( "--in" ) == 0 || args.count( "--out" ) == 0 ) {
+		cerr << "Usage: " << argv[0] << " --in <audio file> --out <raw file> [--fps 60] [--layout mix|left|right|stereo]" << endl;
+		cerr << "       [--rows-per-file 0] [--fft 4096] [--hop 512] [--smoothing 0.5]" << endl;
+		return 1;
+	}
+
+	int result = 1;
+	try {
+		result = render( args );
+	}
+	catch( const std::exception &e ) {
+		cerr << "Failed to render spectrogram: " << e.what() << endl;
+	}
+
+	// stop the worker threads
+	ph::TaskScheduler::getInstance().shutdown();
+
+	return result;
+}
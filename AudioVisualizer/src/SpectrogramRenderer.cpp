@@ -0,0 +1,233 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SpectrogramRenderer.h"
+#include "TaskScheduler.h"
+
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <memory>
+
+using namespace ci;
+
+struct SpectrogramRenderer::Chunk {
+	//! the samples of this chunk, preceded by the end of the previous chunk
+	std::vector<float> left;
+	std::vector<float> right;
+	//! number of rows that are analyzed only to fill the window and let the smoothing settle
+	size_t numSkippedRows;
+	//! the bands of the left channel, followed by those of the right channel, for each row
+	std::vector<float> rows;
+
+	ph::TaskRef task;
+};
+
+SpectrogramRenderer::SpectrogramRenderer( size_t sampleRate, const Options &options )
+    : mOptions( options )
+    , mSampleRate( sampleRate )
+    , mNumRowsAnalyzed( 0 )
+    , mNumRowsWritten( 0 )
+{
+	// use the format as sanitized by the analyzer, so we agree on the hop size and number of bands
+	SpectrumAnalyzer analyzer( sampleRate, options.analysis );
+	mOptions.analysis = analyzer.getFormat();
+
+	mNumBands = mOptions.analysis.numBands;
+	mHopSize = mOptions.analysis.hopSize;
+}
+
+double SpectrogramRenderer::getRowRate() const
+{
+	if( mOptions.frameRate > 0.0 )
+		return mOptions.frameRate;
+
+	return double( mSampleRate ) / mHopSize;
+}
+
+size_t SpectrogramRenderer::render( const ReadFn &readFn, const RowFn &rowFn )
+{
+	const SpectrumAnalyzer::Format &format = mOptions.analysis;
+	const size_t                    sampleRate = mSampleRate;
+
+	// number of rows it takes the smoothing to forget its initial state, to about one part in a million
+	size_t settleRows = 0;
+	if( format.smoothing > 0.0f )
+		settleRows = size_t( math<double>::ceil( std::log( 1.0e-6 ) / std::log( double( format.smoothing ) ) ) );
+
+	// keep the prefix and chunks a multiple of the hop size, so that their rows line up
+	const size_t prefixFrames = ( ( format.fftSize + mHopSize - 1 ) / mHopSize + settleRows ) * mHopSize;
+	const size_t chunkFrames = math<size_t>::max( ( mOptions.chunkFrames + mHopSize - 1 ) / mHopSize, 1 ) * mHopSize;
+
+	auto &       scheduler = ph::TaskScheduler::getInstance();
+	const size_t maxChunks = mOptions.maxChunksInFlight > 0 ? mOptions.maxChunksInFlight : math<size_t>::max( 2 * scheduler.getNumWorkers(), 2 );
+
+	mRow.assign( getRowWidth(), 0.0f );
+	mNumRowsAnalyzed = 0;
+	mNumRowsWritten = 0;
+
+	// writes the oldest chunk once it is done
+	std::deque<std::shared_ptr<Chunk>> chunks;
+	auto                               writeOldest = [&]() {
+		auto chunk = chunks.front();
+		chunks.pop_front();
+
+		chunk->task->wait();
+		chunk->task->rethrow();
+		chunk->task.reset();
+
+		write( *chunk, rowFn );
+	};
+
+	// the end of the audio read so far
+	std::vector<float> historyLeft;
+	std::vector<float> historyRight;
+
+	size_t totalFrames = 0;
+	bool   isEof = false;
+	while( !isEof ) {
+		auto chunk = std::make_shared<Chunk>();
+
+		// start with the end of the previous chunk
+		const size_t prefix = historyLeft.size();
+		chunk->left = historyLeft;
+		chunk->right = historyRight;
+		chunk->left.resize( prefix + chunkFrames );
+		chunk->right.resize( prefix + chunkFrames );
+		chunk->numSkippedRows = prefix / mHopSize;
+
+		// read the audio sequentially
+		size_t numFrames = 0;
+		while( numFrames < chunkFrames ) {
+			const size_t count = readFn( &chunk->left[prefix + numFrames], &chunk->right[prefix + numFrames], chunkFrames - numFrames );
+			if( count == 0 ) {
+				isEof = true;
+				break;
+			}
+
+			numFrames += count;
+		}
+
+		if( numFrames == 0 )
+			break;
+
+		chunk->left.resize( prefix + numFrames );
+		chunk->right.resize( prefix + numFrames );
+		totalFrames += numFrames;
+
+		const size_t keep = math<size_t>::min( prefixFrames, chunk->left.size() );
+		historyLeft.assign( chunk->left.end() - keep, chunk->left.end() );
+		historyRight.assign( chunk->right.end() - keep, chunk->right.end() );
+
+		// analyze the chunk on a worker thread
+		chunk->task = scheduler.submit( [chunk, format, sampleRate]() {
+			SpectrumAnalyzer analyzer( sampleRate, format );
+
+			const size_t numBands = analyzer.getNumBands();
+			const size_t numRows = chunk->left.size() / format.hopSize;
+			chunk->rows.reserve( 2 * numBands * ( numRows - math<size_t>::min( numRows, chunk->numSkippedRows ) ) );
+
+			size_t index = 0;
+			analyzer.process( chunk->left.data(), chunk->right.data(), chunk->left.size(), [&]( const float *left, const float *right ) {
+				if( index++ < chunk->numSkippedRows )
+					return;
+
+				chunk->rows.insert( chunk->rows.end(), left, left + numBands );
+				chunk->rows.insert( chunk->rows.end(), right, right + numBands );
+			} );
+
+			// the samples are no longer needed
+			std::vector<float>().swap( chunk->left );
+			std::vector<float>().swap( chunk->right );
+		} );
+
+		chunks.push_back( chunk );
+
+		// write finished chunks in order, or wait for the oldest one if too many are in flight
+		while( !chunks.empty() && ( chunks.size() >= maxChunks || chunks.front()->task->isDone() ) )
+			writeOldest();
+	}
+
+	while( !chunks.empty() )
+		writeOldest();
+
+	// when writing frames, the last row is shown until the end of the audio
+	if( mOptions.frameRate > 0.0 ) {
+		const size_t numFrames = size_t( math<double>::ceil( totalFrames * mOptions.frameRate / mSampleRate ) );
+		while( mNumRowsWritten < numFrames ) {
+			rowFn( mRow.data() );
+			mNumRowsWritten++;
+		}
+	}
+
+	return mNumRowsWritten;
+}
+
+void SpectrogramRenderer::write( const Chunk &chunk, const RowFn &rowFn )
+{
+	const size_t numRows = chunk.rows.size() / ( 2 * mNumBands );
+	for( size_t i = 0; i < numRows; ++i ) {
+		const float *left = &chunk.rows[2 * mNumBands * i];
+		const float *right = left + mNumBands;
+
+		if( mOptions.frameRate > 0.0 ) {
+			// a row is finished at the end of its hop, frames before that time still show the previous row.
+			// Note: compares frame * sampleRate with end * frameRate, which is exact for whole frame rates.
+			const double end = double( mNumRowsAnalyzed + 1 ) * mHopSize;
+			while( double( mNumRowsWritten ) * mSampleRate < end * mOptions.frameRate ) {
+				rowFn( mRow.data() );
+				mNumRowsWritten++;
+			}
+
+			combine( left, right, mRow.data() );
+		}
+		else {
+			combine( left, right, mRow.data() );
+			rowFn( mRow.data() );
+			mNumRowsWritten++;
+		}
+
+		mNumRowsAnalyzed++;
+	}
+}
+
+void SpectrogramRenderer::combine( const float *left, const float *right, float *row ) const
+{
+	switch( mOptions.layout ) {
+	case MIX:
+		for( size_t i = 0; i < mNumBands; ++i )
+			row[i] = 0.5f * ( left[i] + right[i] );
+		break;
+	case LEFT:
+		std::copy( left, left + mNumBands, row );
+		break;
+	case RIGHT:
+		std::copy( right, right + mNumBands, row );
+		break;
+	case STEREO:
+		std::copy( left, left + mNumBands, row );
+		std::copy( right, right + mNumBands, row + mNumBands );
+		break;
+	}
+}
@@ -0,0 +1,189 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SpectrumAnalyzer.h"
+
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+
+SpectrumAnalyzer::SpectrumAnalyzer( size_t sampleRate, const Format &format )
+    : mFormat( format )
+    , mSampleRate( sampleRate )
+{
+	// sanitize the format
+	mFormat.hopSize = math<size_t>::clamp( mFormat.hopSize, 1, mFormat.fftSize );
+	mFormat.numBands = math<size_t>::max( mFormat.numBands, 1 );
+	mFormat.smoothing = math<float>::clamp( mFormat.smoothing, 0.0f, 0.99f );
+
+	mFft.reset( new audio::dsp::Fft( mFormat.fftSize ) );
+	mFftBuffer = audio::Buffer( mFormat.fftSize );
+	mBufferSpectral = audio::BufferSpectral( mFormat.fftSize );
+	mMagnitudes.resize( mFormat.fftSize / 2 + 1 );
+
+	mWindow.resize( mFormat.fftSize );
+	audio::dsp::generateWindow( mFormat.windowType, mWindow.data(), mWindow.size() );
+
+	for( size_t ch = 0; ch < 2; ++ch ) {
+		mSamples[ch].resize( mFormat.fftSize );
+		mRow[ch].resize( mFormat.numBands );
+	}
+
+	createBands();
+	reset();
+}
+
+void SpectrumAnalyzer::reset()
+{
+	for( size_t ch = 0; ch < 2; ++ch ) {
+		std::fill( mSamples[ch].begin(), mSamples[ch].end(), 0.0f );
+		std::fill( mRow[ch].begin(), mRow[ch].end(), 0.0f );
+	}
+
+	mWritePos = 0;
+	mSamplesUntilHop = mFormat.hopSize;
+}
+
+size_t SpectrumAnalyzer::process( const float *left, const float *right, size_t numFrames, const RowFn &rowFn )
+{
+	const size_t size = mFormat.fftSize;
+
+	size_t rows = 0;
+	while( numFrames > 0 ) {
+		// copy samples until the next hop or the end of the circular buffer, whichever comes first
+		const size_t count = math<size_t>::min( math<size_t>::min( numFrames, mSamplesUntilHop ), size - mWritePos );
+		std::copy( left, left + count, mSamples[0].begin() + mWritePos );
+		std::copy( right, right + count, mSamples[1].begin() + mWritePos );
+
+		left += count;
+		right += count;
+		numFrames -= count;
+
+		mWritePos = ( mWritePos + count ) % size;
+		mSamplesUntilHop -= count;
+
+		if( mSamplesUntilHop == 0 ) {
+			analyze( 0 );
+			analyze( 1 );
+
+			if( rowFn )
+				rowFn( mRow[0].data(), mRow[1].data() );
+
+			mSamplesUntilHop = mFormat.hopSize;
+			rows++;
+		}
+	}
+
+	return rows;
+}
+
+void SpectrumAnalyzer::createBands()
+{
+	const size_t size = mFormat.fftSize;
+	const size_t numBins = size / 2;
+	const size_t numBands = mFormat.numBands;
+
+	// the bands are spaced logarithmically between the lowest and highest frequency
+	const float nyquist = 0.5f * mSampleRate;
+	const float maxFrequency = math<float>::clamp( mFormat.maxFrequency, 1.0f, nyquist );
+	const float minFrequency = math<float>::clamp( mFormat.minFrequency, 1.0f, maxFrequency );
+	const float ratio = maxFrequency / minFrequency;
+	const float binsPerHz = float( size ) / mSampleRate;
+
+	auto binAt = [&]( float band ) {
+		const float t = numBands > 1 ? band / float( numBands - 1 ) : 0.0f;
+		return minFrequency * math<float>::pow( ratio, t ) * binsPerHz;
+	};
+
+	mBands.resize( numBands );
+	for( size_t i = 0; i < numBands; ++i ) {
+		Band &band = mBands[i];
+
+		// each band covers the bins halfway between its center and the centers of its neighbours
+		const float center = binAt( float( i ) );
+		const float lo = binAt( i - 0.5f );
+		const float hi = binAt( i + 0.5f );
+
+		const size_t first = size_t( math<float>::ceil( lo ) );
+		const size_t last = math<size_t>::min( size_t( math<float>::floor( hi ) ), numBins );
+
+		if( last >= first && first <= numBins ) {
+			band.first = first;
+			band.count = last - first + 1;
+			band.fraction = 0.0f;
+		}
+		else {
+			// the band does not contain a single bin, so interpolate between the nearest two
+			const float bin = math<float>::min( center, float( numBins - 1 ) );
+			band.first = size_t( bin );
+			band.count = 0;
+			band.fraction = bin - band.first;
+		}
+	}
+}
+
+void SpectrumAnalyzer::analyze( size_t channel )
+{
+	const size_t size = mFormat.fftSize;
+
+	// unroll the circular buffer, oldest sample first, and apply the window
+	const std::vector<float> &samples = mSamples[channel];
+	float *                   buffer = mFftBuffer.getData();
+	for( size_t i = 0; i < size; ++i )
+		buffer[i] = samples[( mWritePos + i ) % size] * mWindow[i];
+
+	mFft->forward( &mFftBuffer, &mBufferSpectral );
+
+	// compute the normalized magnitude spectrum, the same way audio::MonitorSpectralNode does
+	const float *real = mBufferSpectral.getReal();
+	const float *imag = mBufferSpectral.getImag();
+	const float  scale = 1.0f / size;
+
+	// the Nyquist component is packed into the imaginary part of the first bin
+	mMagnitudes[0] = math<float>::abs( real[0] ) * scale;
+	mMagnitudes[size / 2] = math<float>::abs( imag[0] ) * scale;
+	for( size_t i = 1; i < size / 2; ++i )
+		mMagnitudes[i] = math<float>::sqrt( real[i] * real[i] + imag[i] * imag[i] ) * scale;
+
+	// map the bins to bands and smooth them over time
+	const float         smoothing = mFormat.smoothing;
+	std::vector<float> &row = mRow[channel];
+	for( size_t i = 0; i < mBands.size(); ++i ) {
+		const Band &band = mBands[i];
+
+		float value;
+		if( band.count == 0 ) {
+			value = mMagnitudes[band.first] + band.fraction * ( mMagnitudes[band.first + 1] - mMagnitudes[band.first] );
+		}
+		else {
+			value = 0.0f;
+			for( size_t j = 0; j < band.count; ++j )
+				value += mMagnitudes[band.first + j];
+			value /= band.count;
+		}
+
+		row[i] = row[i] * smoothing + value * ( 1.0f - smoothing );
+	}
+}
@@ -0,0 +1,144 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SpectrumNode.h"
+
+#include "cinder/CinderMath.h"
+
+using namespace ci;
+
+SpectrumNode::SpectrumNode( const SpectrumAnalyzer::Format &analysis, const Format &format )
+    : Node( Format( format ).channels( 2 ) )
+    , mAnalysisFormat( analysis )
+    , mIsRunning( false )
+    , mNumDroppedBlocks( 0 )
+{
+}
+
+SpectrumNode::~SpectrumNode()
+{
+	// make sure the analysis thread has stopped
+	uninitialize();
+}
+
+void SpectrumNode::initialize()
+{
+	// room for a quarter of a second of audio and a few dozen rows
+	const size_t numFrames = math<size_t>::max( getSampleRate() / 4, 4 * getFramesPerBlock() );
+	for( size_t ch = 0; ch < 2; ++ch )
+		mSamples[ch].reset( new audio::dsp::RingBufferT<float>( numFrames ) );
+
+	mRows.reset( new audio::dsp::RingBufferT<float>( 32 * 2 * mAnalysisFormat.numBands ) );
+
+	mIsRunning = true;
+	mThread = std::thread( &SpectrumNode::run, this, getSampleRate(), getFramesPerBlock() );
+}
+
+void SpectrumNode::uninitialize()
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mIsRunning = false;
+	}
+	mCondition.notify_one();
+
+	if( mThread.joinable() )
+		mThread.join();
+}
+
+void SpectrumNode::process( audio::Buffer *buffer )
+{
+	// this is the audio thread: copy the samples and return as soon as possible
+	const size_t numFrames = buffer->getNumFrames();
+	if( mSamples[0]->getAvailableWrite() < numFrames || mSamples[1]->getAvailableWrite() < numFrames ) {
+		mNumDroppedBlocks++;
+		return;
+	}
+
+	// only the analysis thread frees up space, so both writes will succeed
+	mSamples[0]->write( buffer->getChannel( 0 ), numFrames );
+	mSamples[1]->write( buffer->getChannel( 1 ), numFrames );
+}
+
+void SpectrumNode::run( size_t sampleRate, size_t framesPerBlock )
+{
+	SpectrumAnalyzer analyzer( sampleRate, mAnalysisFormat );
+
+	const size_t numBands = analyzer.getNumBands();
+	const size_t blockSize = analyzer.getFormat().hopSize;
+
+	std::vector<float> left( blockSize ), right( blockSize );
+	std::vector<float> row( 2 * numBands );
+
+	auto rowFn = [&]( const float *l, const float *r ) {
+		// if the render thread is not reading rows, simply drop this one
+		if( mRows->getAvailableWrite() < row.size() )
+			return;
+
+		std::copy( l, l + numBands, row.begin() );
+		std::copy( r, r + numBands, row.begin() + numBands );
+		mRows->write( row.data(), row.size() );
+	};
+
+	// the right channel is written last, so it tells us how many frames are available in both
+	auto getAvailable = [&]() { return math<size_t>::min( mSamples[0]->getAvailableRead(), mSamples[1]->getAvailableRead() ); };
+
+	// notifying a condition variable is not real-time safe, so the audio thread does not signal new samples.
+	// Instead, check for them twice per block. Only uninitialize() signals, so that stopping is immediate.
+	const auto pollInterval = std::chrono::microseconds( 500000 * framesPerBlock / math<size_t>::max( sampleRate, 1 ) );
+
+	for( ;; ) {
+		size_t available = 0;
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			while( mIsRunning && ( available = getAvailable() ) == 0 )
+				mCondition.wait_for( lock, pollInterval );
+
+			if( !mIsRunning )
+				break;
+		}
+
+		const size_t numFrames = math<size_t>::min( available, blockSize );
+		mSamples[0]->read( left.data(), numFrames );
+		mSamples[1]->read( right.data(), numFrames );
+
+		analyzer.process( left.data(), right.data(), numFrames, rowFn );
+	}
+}
+
+bool SpectrumNode::readRow( float *left, float *right )
+{
+	if( !mRows )
+		return false;
+
+	const size_t numBands = mAnalysisFormat.numBands;
+
+	// skip all but the most recent row
+	bool found = false;
+	while( mRows->getAvailableRead() >= 2 * numBands ) {
+		mRows->read( left, numBands );
+		mRows->read( right, numBands );
+		found = true;
+	}
+
+	return found;
+}
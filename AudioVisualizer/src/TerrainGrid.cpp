@@ -0,0 +1,99 @@
+/*
+ Copyright (c) 2014, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TerrainGrid.h"
+#include "TaskScheduler.h"
+
+using namespace ci;
+
+TerrainGrid::TerrainGrid()
+    : mWidth( 0 )
+    , mHeight( 0 )
+    , mMultithreaded( true )
+{
+}
+
+void TerrainGrid::build( size_t width, size_t height, const vec2 &size )
+{
+	mWidth = width;
+	mHeight = height;
+	mSize = size;
+
+	// only grow the buffers, shrinking a vector keeps its memory
+	if( mVertices.size() < getNumVertices() )
+		mVertices.resize( getNumVertices() );
+	if( mIndices.size() < getNumIndices() )
+		mIndices.resize( getNumIndices() );
+
+	mColumnCoords.resize( width );
+	mColumnColors.resize( width );
+	for( size_t w = 0; w < width; ++w ) {
+		const float s = width > 1 ? w / float( width - 1 ) : 0.0f;
+
+		// note: the frequency bands are spaced logarithmically, so we draw all of them
+		mColumnCoords[w] = 1.0f - s;
+		mColumnColors[w] = Colorf( CM_HSV, s, 0.5f, 0.75f );
+	}
+
+	// every row can be written independently, so split them into one range per thread
+	if( !mMultithreaded || height < 64 )
+		buildRows( 0, height );
+	else
+		ph::TaskScheduler::getInstance().parallelFor( 0, height, [this]( size_t begin, size_t end ) { buildRows( begin, end ); } );
+}
+
+void TerrainGrid::buildRows( size_t begin, size_t end )
+{
+	const size_t width = mWidth;
+	const size_t height = mHeight;
+	const float  stepX = width > 1 ? mSize.x / ( width - 1 ) : 0.0f;
+	const float  stepZ = height > 1 ? mSize.y / ( height - 1 ) : 0.0f;
+
+	for( size_t h = begin; h < end; ++h ) {
+		const float t = height > 1 ? h / float( height - 1 ) : 0.0f;
+		const float z = h * stepZ;
+
+		// add vertices
+		TerrainVertex *vertex = &mVertices[h * width];
+		for( size_t w = 0; w < width; ++w, ++vertex ) {
+			vertex->position = vec3( w * stepX, 0, z );
+			vertex->color = mColumnColors[w];
+			vertex->texCoord = vec2( mColumnCoords[w], t );
+		}
+
+		// add polygon indices
+		if( h + 1 >= height )
+			continue;
+
+		uint32_t *index = &mIndices[6 * h * ( width - 1 )];
+		for( size_t w = 0; w + 1 < width; ++w ) {
+			const uint32_t offset = uint32_t( h * width + w );
+
+			*index++ = offset;
+			*index++ = offset + uint32_t( width );
+			*index++ = offset + uint32_t( width ) + 1;
+			*index++ = offset;
+			*index++ = offset + uint32_t( width ) + 1;
+			*index++ = offset + 1;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cinder/Vector.h"
+
+#include <vector>
+
+class Balls;
+
+//! Per-instance data for drawing a ball, or one segment of its motion blur trail.
+struct BallInstance {
+	ci::vec2 position;
+	ci::vec4 color; // rgb has been divided by the number of segments in the trail, so they add up to the ball's color
+};
+
+//! Turns the balls into a list of instances, so they can be drawn with a single instanced draw call. This does not
+//! use OpenGL, so it can run and be verified without a GPU.
+class BallInstances {
+  public:
+	BallInstances();
+
+	//! fills the list with one instance per ball, or with 3 to 30 instances per ball for the motion blur trail
+	//! between its previous and current position, depending on the distance traveled
+	void build( const Balls &balls, bool useMotionBlur );
+
+	const std::vector<BallInstance> &getInstances() const { return mInstances; }
+
+	size_t size() const { return mInstances.size(); }
+	bool   empty() const { return mInstances.empty(); }
+
+	//! returns the number of draw calls needed when drawing each instance separately
+	size_t getNumDrawCallsNotInstanced() const { return mInstances.size(); }
+
+  public:
+	static const int kMinTrailSize = 3;
+	static const int kMaxTrailSize = 30;
+
+  private:
+	std::vector<BallInstance> mInstances;
+};
@@ -0,0 +1,110 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Balls.h"
+
+#include <cstdint>
+#include <random>
+
+//! The complete simulation, without any dependency on OpenGL, the window or the system clock. Given the same seed,
+//! time step and bounds, it produces exactly the same balls and the same results step after step, so runs can be
+//! reproduced and the physics can be measured without a window.
+class BallWorld {
+  public:
+	struct Options {
+		Options()
+		    : seed( 0 )
+		    , timeStep( 1.0 / 60.0 )
+		    , bounds( 640, 480 )
+		    , speed( 0.5f )
+		    , numBalls( 25 )
+		    , scatter( false )
+		    , collisionMode( Balls::DISCRETE )
+		{
+		}
+
+		//! seed of the random generator used to create the balls
+		uint32_t seed;
+		//! duration of a single step in seconds
+		double timeStep;
+		//! size of the area the balls bounce around in
+		ci::vec2 bounds;
+		//! multiplier for velocity and gravity, to tweak the speed of the system
+		float speed;
+		//! number of balls to create initially
+		size_t numBalls;
+		//! if TRUE, the initial balls are spread out over the whole area instead of dropped from above
+		bool scatter;
+		//! see Balls::setCollisionMode()
+		Balls::CollisionMode collisionMode;
+	};
+
+	BallWorld( const Options &options = Options() );
+
+	//! returns options for \a numBalls balls spread out over a square with about the same density as a window with a
+	//! few thousand balls, so that the physics can be compared for different numbers of balls
+	static Options createBenchmarkOptions( size_t numBalls, uint32_t seed, Balls::CollisionMode mode = Balls::DISCRETE );
+
+	const Options &getOptions() const { return mOptions; }
+
+	void            setBounds( const ci::vec2 &bounds ) { mOptions.bounds = bounds; }
+	const ci::vec2 &getBounds() const { return mOptions.bounds; }
+
+	//! adds a ball with a random color, dropped from above at a random position
+	void addBall();
+	//! removes the oldest ball
+	void removeBall();
+	//! drops all balls from above again
+	void resetBalls();
+
+	//! advances the simulation by \a elapsedSeconds, in fixed time steps. Time that does not fill a whole step is
+	//! carried over to the next call. Returns the number of steps taken.
+	size_t update( double elapsedSeconds );
+	//! advances the simulation by a single time step
+	void step();
+
+	uint64_t getNumSteps() const { return mNumSteps; }
+
+	Balls &      getBalls() { return mBalls; }
+	const Balls &getBalls() const { return mBalls; }
+
+	//! returns a hash of the positions and velocities of all balls, to verify that two runs are identical
+	uint64_t getChecksum() const;
+
+  private:
+	//! returns a random number in the range [min, max), computed the same way on every platform
+	float nextFloat( float min = 0.0f, float max = 1.0f );
+
+	void createBall( bool scatter );
+	void resetBall( size_t index, bool scatter );
+
+  private:
+	Options mOptions;
+	Balls   mBalls;
+
+	std::mt19937 mRandom;
+
+	double   mAccumulator;
+	uint64_t mNumSteps;
+};
@@ -0,0 +1,180 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+
+#include "SpatialHash.h"
+
+#include <vector>
+
+//! Stores all balls as a structure of arrays and runs their physics. Collisions between balls are found using a
+//! spatial hash, so the cost of a step grows linearly with the number of balls instead of quadratically.
+//! Candidate pairs are resolved in ascending order of their indices, so results do not depend on how the balls are
+//! distributed over the hash table. Balls are moved 4 at a time using SIMD, and large numbers of balls are split
+//! across the threads of the TaskScheduler. Both produce bitwise the same results as the scalar code.
+//!
+//! In continuous mode, balls are swept from their current to their next position and every collision, with another
+//! ball or with the window, is resolved at its time of impact, earliest first. This prevents fast balls from passing
+//! through each other, at a higher cost per step. To keep balls resting against each other from generating an endless
+//! number of events, each ball resolves a limited number of collisions per step; getNumCappedBalls() reports how many
+//! balls reached that limit.
+class Balls {
+  public:
+	static const int kRadius = 10;
+
+	enum CollisionMode { DISCRETE, CONTINUOUS };
+
+	Balls();
+
+	size_t size() const { return mPositionX.size(); }
+	bool   empty() const { return mPositionX.empty(); }
+
+	void clear();
+	void add( const ci::vec2 &position, const ci::vec2 &velocity, const ci::Colorf &color );
+	void erase( size_t index );
+	void reset( size_t index, const ci::vec2 &position, const ci::vec2 &velocity );
+
+	//! set gravity to zero for outer space
+	void  setGravity( float gravity ) { mGravity = gravity; }
+	float getGravity() const { return mGravity; }
+
+	//! selects how collisions are detected by step() (DISCRETE by default)
+	void          setCollisionMode( CollisionMode mode ) { mCollisionMode = mode; }
+	CollisionMode getCollisionMode() const { return mCollisionMode; }
+
+	//! enables or disables moving 4 balls at a time (enabled by default)
+	void setSimdEnabled( bool enabled ) { mSimdEnabled = enabled; }
+	bool isSimdEnabled() const { return mSimdEnabled; }
+	//! enables or disables splitting update() across threads when there are many balls (enabled by default)
+	void setMultithreaded( bool enabled ) { mMultithreaded = enabled; }
+	bool isMultithreaded() const { return mMultithreaded; }
+
+	//! advances the simulation by one time step, using the current collision mode
+	void step( const ci::vec2 &bounds );
+
+	//! moves all balls and bounces them off the left, right and bottom of the area spanned by \a bounds
+	void update( const ci::vec2 &bounds );
+	//! finds and resolves collisions between balls
+	void performCollisions( const ci::vec2 &bounds );
+	//! call after drawing, so the next update will start a new motion blur trail
+	void markDrawn() { mHasBeenDrawn = true; }
+
+	ci::vec2          getPosition( size_t index ) const { return ci::vec2( mPositionX[index], mPositionY[index] ); }
+	ci::vec2          getPrevPosition( size_t index ) const { return ci::vec2( mPrevPositionX[index], mPrevPositionY[index] ); }
+	ci::vec2          getVelocity( size_t index ) const { return ci::vec2( mVelocityX[index], mVelocityY[index] ); }
+	const ci::Colorf &getColor( size_t index ) const { return mColors[index]; }
+
+	//! number of pairs tested and found colliding during the last step
+	size_t getNumPairsTested() const { return mNumPairsTested; }
+	size_t getNumCollisions() const { return mNumCollisions; }
+	//! number of collisions resolved during the last step, including those with the window in continuous mode
+	size_t getNumEvents() const { return mNumEvents; }
+	//! number of balls that reached the maximum number of events per step in continuous mode. Their remaining
+	//! collisions during that step were not resolved.
+	size_t getNumCappedBalls() const { return mNumCappedBalls; }
+
+	//! returns TRUE if both have exactly the same positions and velocities
+	bool isIdentical( const Balls &other ) const;
+
+  private:
+	//! the window edges, corrected for the radius of a ball
+	struct Limits {
+		float left, right, bottom;
+	};
+
+	static Limits getLimits( const ci::vec2 &bounds );
+
+	void integrate( size_t begin, size_t end, const Limits &limits );
+	void integrateScalar( size_t index, const Limits &limits );
+	void integrateSimd( size_t index, const Limits &limits );
+
+	bool isCollidingWith( size_t a, size_t b ) const;
+	void collideWith( size_t a, size_t b, const Limits &limits );
+
+	bool isCollidingWithWindow( size_t index, const Limits &limits ) const;
+	void collideWithWindow( size_t index, const Limits &limits );
+
+	//! a collision of ball \a a with ball \a b, or with one of the window edges, at \a time within the step
+	struct Event {
+		float    time;
+		uint32_t a, b;
+		uint32_t versionA, versionB;
+
+		//! orders events earliest first, for use with std::priority_queue
+		bool operator<( const Event &rhs ) const;
+	};
+
+	enum Edge : uint32_t { LEFT = 0xFFFFFFF0, RIGHT, BOTTOM };
+
+	void stepContinuous( const ci::vec2 &bounds );
+	//! moves the ball to \a time
+	void advance( size_t index, float time );
+	//! returns TRUE if balls \a a and \a b might collide before either of them leaves its reach
+	bool isWithinReach( size_t a, size_t b ) const;
+	//! after a collision, finds new neighbors for ball \a index if it can now travel beyond its reach
+	void updateReach( size_t index, float maxSpeed );
+	//! schedules the first collision of ball \a index with each of its neighbors (only those with a higher index
+	//! if \a higherOnly is TRUE) and with the window edges
+	void scheduleEvents( size_t index, const Limits &limits, bool higherOnly );
+	void scheduleEvent( size_t index, uint32_t other, float time );
+
+  private:
+	std::vector<float> mPositionX;
+	std::vector<float> mPositionY;
+	std::vector<float> mPrevPositionX;
+	std::vector<float> mPrevPositionY;
+	std::vector<float> mVelocityX;
+	std::vector<float> mVelocityY;
+
+	std::vector<ci::Colorf> mColors;
+
+	float         mGravity;
+	bool          mHasBeenDrawn;
+	bool          mSimdEnabled;
+	bool          mMultithreaded;
+	CollisionMode mCollisionMode;
+
+	SpatialHash           mBroadPhase;
+	std::vector<uint32_t> mCandidates;
+
+	// continuous collision detection
+	std::vector<float>    mTime;           // time within the step at which each ball is at its position
+	std::vector<uint32_t> mVersion;        // incremented when a ball changes course, to invalidate its events
+	std::vector<uint32_t> mNumBallEvents;  // events resolved per ball, capped to prevent endless resting contacts
+	std::vector<float>    mReachX;         // each ball stays within mReach of ( mReachX, mReachY ) until the end of the step
+	std::vector<float>    mReachY;
+	std::vector<float>    mReach;
+	std::vector<uint32_t> mNeighborStart;  // candidate neighbors of each ball, in mNeighbors
+	std::vector<uint32_t> mNeighbors;
+	std::vector<uint8_t>  mEscaped;        // set for balls that were sped up beyond their initial reach
+	std::vector<uint32_t> mEscapedBalls;
+	std::vector<std::vector<uint32_t>> mExtraNeighbors; // neighbors found after a ball escaped its reach
+	std::vector<Event>    mEvents;         // heap of scheduled events
+
+	size_t mNumPairsTested;
+	size_t mNumCollisions;
+	size_t mNumEvents;
+	size_t mNumCappedBalls;
+};
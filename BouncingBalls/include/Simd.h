@@ -0,0 +1,132 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define SIMD_SSE2
+#include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+//! Minimal wrapper around 4-wide float vectors, using SSE2 on x86, NEON on ARM and plain C++ elsewhere. Only
+//! operations that round exactly like their scalar counterparts are provided (no fused multiply-add, no approximate
+//! reciprocals), so vectorized code produces bitwise the same results as its scalar version.
+namespace simd {
+
+#if defined( SIMD_SSE2 )
+
+struct float4 {
+	__m128 v;
+};
+
+struct mask4 {
+	__m128 v;
+};
+
+inline float4 load( const float *p ) { return { _mm_loadu_ps( p ) }; }
+inline void   store( float *p, const float4 &a ) { _mm_storeu_ps( p, a.v ); }
+inline float4 set1( float s ) { return { _mm_set1_ps( s ) }; }
+
+inline float4 operator+( const float4 &a, const float4 &b ) { return { _mm_add_ps( a.v, b.v ) }; }
+inline float4 operator-( const float4 &a, const float4 &b ) { return { _mm_sub_ps( a.v, b.v ) }; }
+inline float4 operator*( const float4 &a, const float4 &b ) { return { _mm_mul_ps( a.v, b.v ) }; }
+
+inline mask4 operator<( const float4 &a, const float4 &b ) { return { _mm_cmplt_ps( a.v, b.v ) }; }
+inline mask4 operator>( const float4 &a, const float4 &b ) { return { _mm_cmpgt_ps( a.v, b.v ) }; }
+inline mask4 operator|( const mask4 &a, const mask4 &b ) { return { _mm_or_ps( a.v, b.v ) }; }
+//! returns \a a and not \a b
+inline mask4 andNot( const mask4 &a, const mask4 &b ) { return { _mm_andnot_ps( b.v, a.v ) }; }
+
+//! returns \a a where \a mask is set, \a b elsewhere
+inline float4 select( const mask4 &mask, const float4 &a, const float4 &b ) { return { _mm_or_ps( _mm_and_ps( mask.v, a.v ), _mm_andnot_ps( mask.v, b.v ) ) }; }
+
+#elif defined( SIMD_NEON )
+
+struct float4 {
+	float32x4_t v;
+};
+
+struct mask4 {
+	uint32x4_t v;
+};
+
+inline float4 load( const float *p ) { return { vld1q_f32( p ) }; }
+inline void   store( float *p, const float4 &a ) { vst1q_f32( p, a.v ); }
+inline float4 set1( float s ) { return { vdupq_n_f32( s ) }; }
+
+inline float4 operator+( const float4 &a, const float4 &b ) { return { vaddq_f32( a.v, b.v ) }; }
+inline float4 operator-( const float4 &a, const float4 &b ) { return { vsubq_f32( a.v, b.v ) }; }
+inline float4 operator*( const float4 &a, const float4 &b ) { return { vmulq_f32( a.v, b.v ) }; }
+
+inline mask4 operator<( const float4 &a, const float4 &b ) { return { vcltq_f32( a.v, b.v ) }; }
+inline mask4 operator>( const float4 &a, const float4 &b ) { return { vcgtq_f32( a.v, b.v ) }; }
+inline mask4 operator|( const mask4 &a, const mask4 &b ) { return { vorrq_u32( a.v, b.v ) }; }
+//! returns \a a and not \a b
+inline mask4 andNot( const mask4 &a, const mask4 &b ) { return { vbicq_u32( a.v, b.v ) }; }
+
+//! returns \a a where \a mask is set, \a b elsewhere
+inline float4 select( const mask4 &mask, const float4 &a, const float4 &b ) { return { vbslq_f32( mask.v, a.v, b.v ) }; }
+
+#else
+
+struct float4 {
+	float v[4];
+};
+
+struct mask4 {
+	bool v[4];
+};
+
+inline float4 load( const float *p ) { return { { p[0], p[1], p[2], p[3] } }; }
+inline void   store( float *p, const float4 &a )
+{
+	for( int i = 0; i < 4; ++i )
+		p[i] = a.v[i];
+}
+inline float4 set1( float s ) { return { { s, s, s, s } }; }
+
+inline float4 operator+( const float4 &a, const float4 &b ) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+inline float4 operator-( const float4 &a, const float4 &b ) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+inline float4 operator*( const float4 &a, const float4 &b ) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+
+inline mask4 operator<( const float4 &a, const float4 &b ) { return { { a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2], a.v[3] < b.v[3] } }; }
+inline mask4 operator>( const float4 &a, const float4 &b ) { return { { a.v[0] > b.v[0], a.v[1] > b.v[1], a.v[2] > b.v[2], a.v[3] > b.v[3] } }; }
+inline mask4 operator|( const mask4 &a, const mask4 &b ) { return { { a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2], a.v[3] || b.v[3] } }; }
+//! returns \a a and not \a b
+inline mask4 andNot( const mask4 &a, const mask4 &b ) { return { { a.v[0] && !b.v[0], a.v[1] && !b.v[1], a.v[2] && !b.v[2], a.v[3] && !b.v[3] } }; }
+
+//! returns \a a where \a mask is set, \a b elsewhere
+inline float4 select( const mask4 &mask, const float4 &a, const float4 &b )
+{
+	return { { mask.v[0] ? a.v[0] : b.v[0], mask.v[1] ? a.v[1] : b.v[1], mask.v[2] ? a.v[2] : b.v[2], mask.v[3] ? a.v[3] : b.v[3] } };
+}
+
+#endif
+
+inline float4 &operator+=( float4 &a, const float4 &b ) { return a = a + b; }
+inline float4 &operator-=( float4 &a, const float4 &b ) { return a = a - b; }
+inline float4 &operator*=( float4 &a, const float4 &b ) { return a = a * b; }
+
+} // namespace simd
@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+//! Uniform grid for finding nearby balls, stored as a hash table so that the world does not need to be bounded.
+//! Items are sorted into buckets with a counting sort, so building it is O(n) and does not allocate once its
+//! buffers have grown. Within a bucket, items are stored in ascending order, which keeps queries deterministic.
+class SpatialHash {
+  public:
+	SpatialHash();
+
+	//! sorts \a count items into cells of size \a cellSize, using their positions \a x and \a y
+	void build( const float *x, const float *y, size_t count, float cellSize );
+
+	//! calls \a fn( index ) for every item in the cell containing ( \a x, \a y ) and the 8 cells around it. Items can
+	//! be reported more than once if two of those cells share a bucket, and items from distant cells can be reported
+	//! if their cell hashes to the same bucket. Callers should test the actual distance.
+	template <typename Fn>
+	void query( float x, float y, Fn fn ) const
+	{
+		if( mItems.empty() )
+			return;
+
+		const int cx = getCell( x );
+		const int cy = getCell( y );
+
+		for( int dy = -1; dy <= 1; ++dy ) {
+			for( int dx = -1; dx <= 1; ++dx ) {
+				const uint32_t bucket = getBucket( cx + dx, cy + dy );
+				for( uint32_t i = mStart[bucket], end = mStart[bucket + 1]; i < end; ++i )
+					fn( mItems[i] );
+			}
+		}
+	}
+
+	size_t getNumBuckets() const { return mStart.empty() ? 0 : mStart.size() - 1; }
+
+  private:
+	int getCell( float v ) const
+	{
+		// clamp, so that stray values can not overflow. Converting NaN to int is undefined,
+		// so the first test is written to fail for NaN as well, which puts it in the lowest cell.
+		const float c = std::floor( v * mInvCellSize );
+		if( !( c > -1.0e6f ) )
+			return -1000000;
+		if( c > 1.0e6f )
+			return 1000000;
+		return int( c );
+	}
+
+	uint32_t getBucket( int cx, int cy ) const { return ( uint32_t( cx ) * 73856093u ^ uint32_t( cy ) * 19349663u ) & mMask; }
+
+  private:
+	float    mInvCellSize;
+	uint32_t mMask;
+
+	std::vector<uint32_t> mStart;   // first item of each bucket, followed by the total number of items
+	std::vector<uint32_t> mItems;   // item indices, sorted by bucket
+	std::vector<uint32_t> mBuckets; // bucket of each item
+	std::vector<uint32_t> mScratch; // insertion point of each bucket while building
+};
@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "BallInstances.h"
+#include "Balls.h"
+
+#include "cinder/CinderMath.h"
+
+using namespace ci;
+
+BallInstances::BallInstances()
+{
+}
+
+void BallInstances::build( const Balls &balls, bool useMotionBlur )
+{
+	mInstances.clear();
+	mInstances.reserve( useMotionBlur ? balls.size() * 8 : balls.size() );
+
+	for( size_t i = 0; i < balls.size(); ++i ) {
+		const vec2    prevPosition = balls.getPrevPosition( i );
+		const vec2    position = balls.getPosition( i );
+		const Colorf &color = balls.getColor( i );
+
+		if( useMotionBlur ) {
+			// Determine the number of balls that make up the motion blur trail (minimum of 3, maximum of 30).
+			float trailsize = math<float>::clamp( math<float>::floor( glm::distance( prevPosition, position ) ), float( kMinTrailSize ), float( kMaxTrailSize ) );
+			float segments = trailsize - 1.0f;
+
+			// Each segment adds a fraction of the color (using additive blending).
+			const vec4 segmentColor( color.r / trailsize, color.g / trailsize, color.b / trailsize, 1.0f );
+
+			for( size_t j = 0; j < trailsize; ++j ) {
+				BallInstance instance;
+				instance.position = ci::lerp<vec2>( prevPosition, position, j / segments );
+				instance.color = segmentColor;
+				mInstances.push_back( instance );
+			}
+		}
+		else {
+			BallInstance instance;
+			instance.position = position;
+			instance.color = vec4( color.r, color.g, color.b, 1.0f );
+			mInstances.push_back( instance );
+		}
+	}
+}
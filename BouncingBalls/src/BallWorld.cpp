@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "BallWorld.h"
+
+#include "cinder/CinderMath.h"
+
+#include <cstring>
+
+using namespace ci;
+
+BallWorld::BallWorld( const Options &options )
+    : mOptions( options )
+    , mRandom( options.seed )
+    , mAccumulator( 0.0 )
+    , mNumSteps( 0 )
+{
+	// Note: set gravity to zero for outer space.
+	mBalls.setGravity( 0.981f * mOptions.speed );
+	mBalls.setCollisionMode( mOptions.collisionMode );
+
+	for( size_t i = 0; i < mOptions.numBalls; ++i )
+		createBall( mOptions.scatter );
+}
+
+BallWorld::Options BallWorld::createBenchmarkOptions( size_t numBalls, uint32_t seed, Balls::CollisionMode mode )
+{
+	const float size = 40.0f * math<float>::sqrt( float( numBalls ) );
+
+	Options options;
+	options.seed = seed;
+	options.bounds = vec2( size, size );
+	options.numBalls = numBalls;
+	options.scatter = true;
+	options.collisionMode = mode;
+
+	return options;
+}
+
+void BallWorld::addBall()
+{
+	createBall( false );
+}
+
+void BallWorld::createBall( bool scatter )
+{
+	// Pick a random color.
+	float h = nextFloat( 0.0f, 1.0f );
+	float s = nextFloat( 0.75f, 1.0f );
+	float v = nextFloat( 0.75f, 1.0f );
+
+	mBalls.add( vec2( 0 ), vec2( 0 ), Colorf( CM_HSV, h, s, v ) );
+	resetBall( mBalls.size() - 1, scatter );
+}
+
+void BallWorld::removeBall()
+{
+	if( !mBalls.empty() )
+		mBalls.erase( 0 );
+}
+
+void BallWorld::resetBalls()
+{
+	for( size_t i = 0; i < mBalls.size(); ++i )
+		resetBall( i, false );
+}
+
+void BallWorld::resetBall( size_t index, bool scatter )
+{
+	// Pick a random position.
+	float x = nextFloat() * mOptions.bounds.x;
+	float y = scatter ? nextFloat() * mOptions.bounds.y : -0.1f * mOptions.bounds.y;
+	vec2  position( x, y );
+
+	// Pick a random velocity.
+	x = nextFloat( -15.0f, 15.0f ) * mOptions.speed;
+	y = nextFloat( -15.0f, 0.0f ) * mOptions.speed;
+	vec2 velocity( x, y );
+
+	mBalls.reset( index, position, velocity );
+}
+
+size_t BallWorld::update( double elapsedSeconds )
+{
+	size_t steps = 0;
+
+	mAccumulator += math<double>::min( elapsedSeconds, 0.1 ); // prevents 'spiral of death'
+	while( mAccumulator >= mOptions.timeStep ) {
+		mAccumulator -= mOptions.timeStep;
+
+		step();
+		steps++;
+	}
+
+	return steps;
+}
+
+void BallWorld::step()
+{
+	mBalls.step( mOptions.bounds );
+	mNumSteps++;
+}
+
+uint64_t BallWorld::getChecksum() const
+{
+	// FNV-1a over the bit patterns of all positions and velocities
+	uint64_t hash = 14695981039346656037ULL;
+	auto     combine = [&hash]( float value ) {
+		uint32_t bits;
+		std::memcpy( &bits, &value, sizeof( bits ) );
+		for( int i = 0; i < 4; ++i ) {
+			hash ^= ( bits >> ( 8 * i ) ) & 0xFF;
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	for( size_t i = 0; i < mBalls.size(); ++i ) {
+		const vec2 position = mBalls.getPosition( i );
+		const vec2 velocity = mBalls.getVelocity( i );
+		combine( position.x );
+		combine( position.y );
+		combine( velocity.x );
+		combine( velocity.y );
+	}
+
+	return hash;
+}
+
+float BallWorld::nextFloat( float min, float max )
+{
+	// use the upper 24 bits, which convert to a float exactly; std::uniform_real_distribution is not portable
+	const float unit = float( mRandom() >> 8 ) * ( 1.0f / 16777216.0f );
+	return min + unit * ( max - min );
+}
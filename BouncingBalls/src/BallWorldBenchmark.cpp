@@ -0,0 +1,267 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Runs the BouncingBalls physics without a window and reports the timings as JSON, so that
+// runs can be compared between builds and machines. Usage:
+//
+//   BallWorldBenchmark [--balls 1000,10000,100000] [--steps 600] [--seed 12345]
+//                      [--mode discrete|continuous|both] [--out results.json] [--verify]
+//
+// With --verify, it instead checks that the vectorized, multithreaded integrator stays bitwise identical
+// to the scalar one, and exits with a non-zero status if it does not.
+
+#include "BallWorld.h"
+#include "TaskScheduler.h"
+
+#include "cinder/CinderMath.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+struct Run {
+	size_t               numBalls;
+	Balls::CollisionMode mode;
+	vec2                 bounds;
+	double               seconds;
+	double               minStepSeconds;
+	double               maxStepSeconds;
+	size_t               events;
+	size_t               cappedBalls;
+	uint64_t             checksum;
+};
+
+vector<size_t> parseCounts( const string &str )
+{
+	vector<size_t> counts;
+
+	stringstream ss( str );
+	string       item;
+	while( getline( ss, item, ',' ) ) {
+		if( !item.empty() )
+			counts.push_back( size_t( strtoull( item.c_str(), nullptr, 10 ) ) );
+	}
+
+	return counts;
+}
+
+Run runWorld( size_t count, Balls::CollisionMode mode, uint32_t seed, size_t steps )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const BallWorld::Options options = BallWorld::createBenchmarkOptions( count, seed, mode );
+
+	BallWorld world( options );
+
+	Run run;
+	run.numBalls = count;
+	run.mode = mode;
+	run.bounds = options.bounds;
+	run.seconds = 0.0;
+	run.minStepSeconds = 1.0e30;
+	run.maxStepSeconds = 0.0;
+	run.events = 0;
+	run.cappedBalls = 0;
+
+	for( size_t i = 0; i < steps; ++i ) {
+		const auto start = Clock::now();
+		world.step();
+		const double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+		run.seconds += seconds;
+		run.minStepSeconds = math<double>::min( run.minStepSeconds, seconds );
+		run.maxStepSeconds = math<double>::max( run.maxStepSeconds, seconds );
+		run.events += world.getBalls().getNumEvents();
+		run.cappedBalls += world.getBalls().getNumCappedBalls();
+	}
+
+	run.checksum = world.getChecksum();
+
+	return run;
+}
+
+//! Steps a world with the scalar, single-threaded integrator and one with the vectorized, multithreaded integrator
+//! side by side. Returns the first step after which they differ, or \a steps if they stayed bitwise identical.
+size_t verifyWorld( size_t count, Balls::CollisionMode mode, uint32_t seed, size_t steps )
+{
+	const BallWorld::Options options = BallWorld::createBenchmarkOptions( count, seed, mode );
+
+	BallWorld scalar( options );
+	scalar.getBalls().setSimdEnabled( false );
+	scalar.getBalls().setMultithreaded( false );
+
+	BallWorld simd( options );
+	simd.getBalls().setSimdEnabled( true );
+	simd.getBalls().setMultithreaded( true );
+
+	for( size_t i = 0; i < steps; ++i ) {
+		scalar.step();
+		simd.step();
+
+		if( !simd.getBalls().isIdentical( scalar.getBalls() ) )
+			return i;
+	}
+
+	return steps;
+}
+
+void writeJson( ostream &out, uint32_t seed, double timeStep, size_t steps, const vector<Run> &runs )
+{
+	out << "{" << endl;
+	out << "  \"seed\": " << seed << "," << endl;
+	out << "  \"timeStep\": " << timeStep << "," << endl;
+	out << "  \"steps\": " << steps << "," << endl;
+	out << "  \"runs\": [" << endl;
+
+	for( size_t i = 0; i < runs.size(); ++i ) {
+		const Run &run = runs[i];
+
+		out << "    {" << endl;
+		out << "      \"balls\": " << run.numBalls << "," << endl;
+		out << "      \"mode\": \"" << ( run.mode == Balls::CONTINUOUS ? "continuous" : "discrete" ) << "\"," << endl;
+		out << "      \"bounds\": [" << run.bounds.x << ", " << run.bounds.y << "]," << endl;
+		out << "      \"seconds\": " << run.seconds << "," << endl;
+		// JSON can not represent infinity, which a clock with a coarse resolution could produce for small runs
+		if( run.seconds > 0.0 )
+			out << "      \"stepsPerSecond\": " << steps / run.seconds << "," << endl;
+		else
+			out << "      \"stepsPerSecond\": null," << endl;
+		out << "      \"msPerStep\": { \"mean\": " << 1000.0 * run.seconds / steps << ", \"min\": " << 1000.0 * run.minStepSeconds
+		    << ", \"max\": " << 1000.0 * run.maxStepSeconds << " }," << endl;
+		out << "      \"eventsPerStep\": " << double( run.events ) / steps << "," << endl;
+		out << "      \"cappedBallsPerStep\": " << double( run.cappedBalls ) / steps << "," << endl;
+		// as a string, because JSON readers usually can't represent all 64-bit integers
+		out << "      \"checksum\": \"" << std::hex << run.checksum << std::dec << "\"" << endl;
+		out << "    }" << ( i + 1 < runs.size() ? "," : "" ) << endl;
+	}
+
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
+
+} // namespace
+
+int main( int argc, char *argv[] )
+{
+	vector<size_t> counts = { 1000, 10000, 100000 };
+	size_t         steps = 600;
+	uint32_t       seed = 12345;
+	string         mode = "both";
+	string         path;
+	bool           verify = false;
+
+	for( int i = 1; i < argc; ++i ) {
+		const string arg( argv[i] );
+		if( arg == "--verify" ) {
+			verify = true;
+			continue;
+		}
+
+		if( i + 1 == argc ) {
+			cerr << "Missing value for argument: " << arg << endl;
+			return 1;
+		}
+
+		const string value( argv[++i] );
+
+		if( arg == "--balls" )
+			counts = parseCounts( value );
+		else if( arg == "--steps" )
+			steps = size_t( strtoull( value.c_str(), nullptr, 10 ) );
+		else if( arg == "--seed" )
+			seed = uint32_t( strtoul( value.c_str(), nullptr, 10 ) );
+		else if( arg == "--mode" )
+			mode = value;
+		else if( arg == "--out" )
+			path = value;
+		else {
+			cerr << "Unknown argument: " << arg << endl;
+			return 1;
+		}
+	}
+
+	if( counts.empty() || steps == 0 || ( mode != "discrete" && mode != "continuous" && mode != "both" ) ) {
+		cerr << "Usage: " << argv[0] << " [--balls 1000,10000,100000] [--steps 600] [--seed 12345] [--mode discrete|continuous|both] [--out results.json] [--verify]" << endl;
+		return 1;
+	}
+
+	if( verify ) {
+		bool identical = true;
+		for( size_t count : counts ) {
+			for( auto collisionMode : { Balls::DISCRETE, Balls::CONTINUOUS } ) {
+				if( ( collisionMode == Balls::DISCRETE && mode == "continuous" ) || ( collisionMode == Balls::CONTINUOUS && mode == "discrete" ) )
+					continue;
+
+				const size_t step = verifyWorld( count, collisionMode, seed, steps );
+				cout << count << " balls, " << ( collisionMode == Balls::CONTINUOUS ? "continuous" : "discrete" ) << ": ";
+				if( step == steps ) {
+					cout << "identical after " << steps << " steps" << endl;
+				}
+				else {
+					cout << "MISMATCH after step " << step << endl;
+					identical = false;
+				}
+			}
+		}
+
+		ph::TaskScheduler::getInstance().shutdown();
+		return identical ? 0 : 1;
+	}
+
+	vector<Run> runs;
+	for( size_t count : counts ) {
+		if( mode != "continuous" )
+			runs.push_back( runWorld( count, Balls::DISCRETE, seed, steps ) );
+		if( mode != "discrete" )
+			runs.push_back( runWorld( count, Balls::CONTINUOUS, seed, steps ) );
+
+		cerr << "Finished " << count << " balls." << endl;
+	}
+
+	// stop the worker threads used by the integrator
+	ph::TaskScheduler::getInstance().shutdown();
+
+	const double timeStep = BallWorld::Options().timeStep;
+	if( path.empty() ) {
+		writeJson( cout, seed, timeStep, steps, runs );
+	}
+	else {
+		ofstream file( path.c_str() );
+		if( !file ) {
+			cerr << "Could not write to " << path << endl;
+			return 1;
+		}
+
+		writeJson( file, seed, timeStep, steps, runs );
+	}
+
+	return 0;
+}
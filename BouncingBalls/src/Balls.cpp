@@ -0,0 +1,696 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Balls.h"
+#include "Simd.h"
+#include "TaskScheduler.h"
+
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+
+//! below this number of balls, update() does not use multiple threads
+static const size_t kParallelThreshold = 16384;
+//! maximum number of collisions per ball per step in continuous mode, prevents balls resting against each other
+//! from generating an endless number of events
+static const uint32_t kMaxEventsPerBall = 16;
+
+Balls::Balls()
+    : mGravity( 0.0f )
+    , mHasBeenDrawn( false )
+    , mSimdEnabled( true )
+    , mMultithreaded( true )
+    , mCollisionMode( DISCRETE )
+    , mNumPairsTested( 0 )
+    , mNumCollisions( 0 )
+    , mNumEvents( 0 )
+    , mNumCappedBalls( 0 )
+{
+}
+
+void Balls::clear()
+{
+	mPositionX.clear();
+	mPositionY.clear();
+	mPrevPositionX.clear();
+	mPrevPositionY.clear();
+	mVelocityX.clear();
+	mVelocityY.clear();
+	mColors.clear();
+}
+
+void Balls::add( const vec2 &position, const vec2 &velocity, const Colorf &color )
+{
+	mPositionX.push_back( position.x );
+	mPositionY.push_back( position.y );
+	mPrevPositionX.push_back( position.x );
+	mPrevPositionY.push_back( position.y );
+	mVelocityX.push_back( velocity.x );
+	mVelocityY.push_back( velocity.y );
+	mColors.push_back( color );
+}
+
+void Balls::erase( size_t index )
+{
+	mPositionX.erase( mPositionX.begin() + index );
+	mPositionY.erase( mPositionY.begin() + index );
+	mPrevPositionX.erase( mPrevPositionX.begin() + index );
+	mPrevPositionY.erase( mPrevPositionY.begin() + index );
+	mVelocityX.erase( mVelocityX.begin() + index );
+	mVelocityY.erase( mVelocityY.begin() + index );
+	mColors.erase( mColors.begin() + index );
+}
+
+void Balls::reset( size_t index, const vec2 &position, const vec2 &velocity )
+{
+	mPositionX[index] = mPrevPositionX[index] = position.x;
+	mPositionY[index] = mPrevPositionY[index] = position.y;
+	mVelocityX[index] = velocity.x;
+	mVelocityY[index] = velocity.y;
+}
+
+void Balls::step( const vec2 &bounds )
+{
+	if( mCollisionMode == CONTINUOUS ) {
+		stepContinuous( bounds );
+	}
+	else {
+		update( bounds );
+		performCollisions( bounds );
+
+		mNumEvents = mNumCollisions;
+		mNumCappedBalls = 0;
+	}
+}
+
+void Balls::update( const vec2 &bounds )
+{
+	// Look up the window edges only once.
+	const Limits limits = getLimits( bounds );
+	const size_t count = size();
+
+	if( !mMultithreaded || count < kParallelThreshold ) {
+		integrate( 0, count, limits );
+	}
+	else {
+		// Split the balls into one range per thread, in multiples of 4 so each range can be fully vectorized.
+		ph::TaskScheduler::getInstance().parallelFor( 0, count, [this, &limits]( size_t begin, size_t end ) { integrate( begin, end, limits ); }, 4 );
+	}
+
+	//
+	mHasBeenDrawn = false;
+}
+
+bool Balls::isIdentical( const Balls &other ) const
+{
+	return mPositionX == other.mPositionX && mPositionY == other.mPositionY && mVelocityX == other.mVelocityX && mVelocityY == other.mVelocityY;
+}
+
+Balls::Limits Balls::getLimits( const vec2 &bounds )
+{
+	Limits limits;
+	limits.left = 0.0f + kRadius;
+	limits.right = bounds.x - kRadius;
+	limits.bottom = bounds.y - kRadius;
+
+	return limits;
+}
+
+void Balls::integrate( size_t begin, size_t end, const Limits &limits )
+{
+	size_t i = begin;
+
+	if( mSimdEnabled ) {
+		for( ; i + 4 <= end; i += 4 )
+			integrateSimd( i, limits );
+	}
+
+	for( ; i < end; ++i )
+		integrateScalar( i, limits );
+}
+
+void Balls::integrateScalar( size_t index, const Limits &limits )
+{
+	// Store current position.
+	if( mHasBeenDrawn ) {
+		mPrevPositionX[index] = mPositionX[index];
+		mPrevPositionY[index] = mPositionY[index];
+	}
+
+	// First, update the ball's velocity.
+	if( !isCollidingWithWindow( index, limits ) )
+		mVelocityY[index] += mGravity;
+
+	// Next, update the ball's position.
+	mPositionX[index] += mVelocityX[index];
+	mPositionY[index] += mVelocityY[index];
+
+	// Finally, perform collision detection.
+	collideWithWindow( index, limits );
+}
+
+void Balls::integrateSimd( size_t index, const Limits &limits )
+{
+	using namespace simd;
+
+	// This does exactly the same as integrateScalar() for 4 balls at once,
+	// replacing each branch by computing both outcomes and selecting one.
+	const float4 left = set1( limits.left );
+	const float4 right = set1( limits.right );
+	const float4 bottom = set1( limits.bottom );
+	const float4 zero = set1( 0.0f );
+
+	float4 x = load( &mPositionX[index] );
+	float4 y = load( &mPositionY[index] );
+	float4 vx = load( &mVelocityX[index] );
+	float4 vy = load( &mVelocityY[index] );
+
+	// Store current position.
+	float4 px = mHasBeenDrawn ? x : load( &mPrevPositionX[index] );
+	float4 py = mHasBeenDrawn ? y : load( &mPrevPositionY[index] );
+
+	// First, update the ball's velocity.
+	const mask4 touching = ( x < left ) | ( x > right ) | ( y > bottom );
+	vy = select( touching, vy, vy + set1( mGravity ) );
+
+	// Next, update the ball's position.
+	x += vx;
+	y += vy;
+
+	// 1) bounce off the left or right side of the window
+	const mask4 hitSide = ( x < left ) | ( x > right );
+	px = select( hitSide, x, px );
+	py = select( hitSide, y, py );
+	x = select( hitSide, x - vx, x );
+	vx = select( hitSide, vx * set1( -0.95f ), vx );
+
+	// 2) bounce off the bottom of the window
+	const mask4 hitBottom = y > bottom;
+	px = select( hitBottom, x, px );
+	py = select( hitBottom, y, py );
+	y = select( hitBottom, y - vy, y );
+	vx = select( hitBottom, vx * set1( 0.95f ), vx );
+	vy = select( hitBottom, vy * set1( -0.9f ), vy );
+
+	// 3) if ball is still outside window, reset it
+	const mask4 outsideLeft = x < left;
+	const mask4 outsideRight = andNot( x > right, outsideLeft );
+	x = select( outsideLeft, left, select( outsideRight, right, x ) );
+	vx = select( outsideLeft | outsideRight, zero, vx );
+
+	const mask4 outsideBottom = y > bottom;
+	y = select( outsideBottom, bottom, y );
+	vy = select( outsideBottom, zero, vy );
+
+	store( &mPositionX[index], x );
+	store( &mPositionY[index], y );
+	store( &mVelocityX[index], vx );
+	store( &mVelocityY[index], vy );
+	store( &mPrevPositionX[index], px );
+	store( &mPrevPositionY[index], py );
+}
+
+void Balls::performCollisions( const vec2 &bounds )
+{
+	const Limits limits = getLimits( bounds );
+
+	mNumPairsTested = 0;
+	mNumCollisions = 0;
+
+	// sort the balls into cells as large as a ball, so colliding balls are always in neighboring cells
+	mBroadPhase.build( mPositionX.data(), mPositionY.data(), size(), 2.0f * kRadius );
+
+	// check every candidate pair only once, in ascending order like a brute force test would
+	for( size_t i = 0; i < size(); ++i ) {
+		mCandidates.clear();
+		mBroadPhase.query( mPositionX[i], mPositionY[i], [&]( uint32_t j ) {
+			if( j > i )
+				mCandidates.push_back( j );
+		} );
+
+		std::sort( mCandidates.begin(), mCandidates.end() );
+		mCandidates.erase( std::unique( mCandidates.begin(), mCandidates.end() ), mCandidates.end() );
+
+		for( uint32_t j : mCandidates ) {
+			mNumPairsTested++;
+
+			// do quick check
+			if( isCollidingWith( i, j ) ) {
+				// do collision
+				collideWith( i, j, limits );
+				mNumCollisions++;
+			}
+		}
+	}
+}
+
+bool Balls::isCollidingWith( size_t a, size_t b ) const
+{
+	// This is a simplification: there is a change we will miss the collision.
+	return ( glm::distance( getPosition( a ), getPosition( b ) ) < ( 2 * kRadius ) );
+}
+
+void Balls::collideWith( size_t a, size_t b, const Limits &limits )
+{
+	static const float kMinimal = 2.0f * kRadius;
+
+	vec2 positionA = getPosition( a );
+	vec2 positionB = getPosition( b );
+	vec2 velocityA( mVelocityX[a], mVelocityY[a] );
+	vec2 velocityB( mVelocityX[b], mVelocityY[b] );
+
+	// 1) we have already established that the two balls are colliding,
+	// let's move back in time to the moment before collision
+	positionA -= velocityA;
+	positionB -= velocityB;
+
+	// 2) convert to simple 1-dimensional collision
+	//	by projecting onto line through both centers
+	vec2 line = positionB - positionA;
+	vec2 unit = glm::normalize( line );
+
+	float distance = glm::dot( line, unit );
+	float velocity_a = glm::dot( velocityA, unit );
+	float velocity_b = glm::dot( velocityB, unit );
+	if( velocity_a == velocity_b || glm::dot( line, line ) == 0.0f ) {
+		// no collision will happen (or the balls were at the same position, so there is no line to project onto)
+		mPositionX[a] = positionA.x;
+		mPositionY[a] = positionA.y;
+		mPositionX[b] = positionB.x;
+		mPositionY[b] = positionB.y;
+		return;
+	}
+
+	// 3) find time of collision
+	float t = ( kMinimal - distance ) / ( velocity_b - velocity_a );
+
+	// 4) move to that moment in time
+	positionA += t * velocityA;
+	positionB += t * velocityB;
+
+	// 5) exchange velocities
+	velocityA -= velocity_a * unit;
+	velocityA += velocity_b * unit;
+
+	velocityB -= velocity_b * unit;
+	velocityB += velocity_a * unit;
+
+	// 6) move forward to current time
+	positionA += ( 1.0f - t ) * velocityA;
+	positionB += ( 1.0f - t ) * velocityB;
+
+	mPositionX[a] = positionA.x;
+	mPositionY[a] = positionA.y;
+	mVelocityX[a] = velocityA.x;
+	mVelocityY[a] = velocityA.y;
+
+	mPositionX[b] = positionB.x;
+	mPositionY[b] = positionB.y;
+	mVelocityX[b] = velocityB.x;
+	mVelocityY[b] = velocityB.y;
+
+	// 7) make sure the balls stay within window
+	collideWithWindow( a, limits );
+	collideWithWindow( b, limits );
+}
+
+bool Balls::isCollidingWithWindow( size_t index, const Limits &limits ) const
+{
+	if( mPositionX[index] < limits.left || mPositionX[index] > limits.right )
+		return true;
+	if( mPositionY[index] > limits.bottom )
+		return true;
+
+	return false;
+}
+
+void Balls::collideWithWindow( size_t index, const Limits &limits )
+{
+	float &x = mPositionX[index];
+	float &y = mPositionY[index];
+	float &vx = mVelocityX[index];
+	float &vy = mVelocityY[index];
+
+	//	1) check if the ball hits the left or right side of the window
+	if( x < limits.left || x > limits.right ) {
+		// to reduce the visual effect of the ball missing the border,
+		// set the previous position to where we are now
+		mPrevPositionX[index] = x;
+		mPrevPositionY[index] = y;
+		// move the ball back into window without adding energy,
+		// by placing it where it would have been without friction
+		x -= vx;
+		// reduce velocity due to friction
+		vx *= -0.95f;
+	}
+	//	2) check if the ball this the bottom of the window
+	if( y > limits.bottom ) {
+		// to reduce the visual effect of the ball missing the border,
+		// set the previous position to where we are now
+		mPrevPositionX[index] = x;
+		mPrevPositionY[index] = y;
+		// move the ball back into window without adding energy,
+		// by placing it where it would have been without friction
+		y -= vy;
+		// reduce velocity due to friction
+		vx *= 0.95f;
+		vy *= -0.9f;
+	}
+
+	//  3) if ball is still outside window,
+	//		it was probably moving very slow or fast. Let's reset it then.
+	if( x < limits.left ) {
+		x = limits.left;
+		vx = 0.0f;
+	}
+	else if( x > limits.right ) {
+		x = limits.right;
+		vx = 0.0f;
+	}
+	if( y > limits.bottom ) {
+		y = limits.bottom;
+		vy = 0.0f;
+	}
+}
+
+bool Balls::Event::operator<( const Event &rhs ) const
+{
+	// std::priority_queue pops the largest item, so the earliest event must compare largest.
+	// Ties are broken by ball index, to keep the order deterministic.
+	if( time != rhs.time )
+		return time > rhs.time;
+	if( a != rhs.a )
+		return a > rhs.a;
+	return b > rhs.b;
+}
+
+void Balls::stepContinuous( const vec2 &bounds )
+{
+	const Limits limits = getLimits( bounds );
+	const size_t count = size();
+
+	mNumPairsTested = 0;
+	mNumCollisions = 0;
+	mNumEvents = 0;
+	mNumCappedBalls = 0;
+
+	// 1) apply gravity and find the fastest ball
+	float maxSpeed = 0.0f;
+	mReach.resize( count );
+	for( size_t i = 0; i < count; ++i ) {
+		if( mHasBeenDrawn ) {
+			mPrevPositionX[i] = mPositionX[i];
+			mPrevPositionY[i] = mPositionY[i];
+		}
+
+		if( !isCollidingWithWindow( i, limits ) )
+			mVelocityY[i] += mGravity;
+
+		mReach[i] = glm::length( vec2( mVelocityX[i], mVelocityY[i] ) );
+		maxSpeed = math<float>::max( maxSpeed, mReach[i] );
+	}
+
+	mHasBeenDrawn = false;
+
+	// 2) find balls that might collide during this step. Bouncing off the window does not speed a ball up, so until
+	//    it collides with another ball, it stays within its speed (its reach) of where it starts. Two balls can only
+	//    collide if they start at most 2 radii plus both of their reaches apart.
+	mReachX.assign( mPositionX.begin(), mPositionX.end() );
+	mReachY.assign( mPositionY.begin(), mPositionY.end() );
+
+	mBroadPhase.build( mReachX.data(), mReachY.data(), count, 2.0f * ( kRadius + maxSpeed ) );
+
+	mNeighborStart.resize( count + 1 );
+	mNeighbors.clear();
+	for( size_t i = 0; i < count; ++i ) {
+		mNeighborStart[i] = uint32_t( mNeighbors.size() );
+
+		mCandidates.clear();
+		mBroadPhase.query( mReachX[i], mReachY[i], [&]( uint32_t j ) {
+			if( j != i && isWithinReach( i, j ) )
+				mCandidates.push_back( j );
+		} );
+
+		std::sort( mCandidates.begin(), mCandidates.end() );
+		mCandidates.erase( std::unique( mCandidates.begin(), mCandidates.end() ), mCandidates.end() );
+		mNeighbors.insert( mNeighbors.end(), mCandidates.begin(), mCandidates.end() );
+	}
+	mNeighborStart[count] = uint32_t( mNeighbors.size() );
+
+	// 3) schedule the first collisions
+	mTime.assign( count, 0.0f );
+	mVersion.assign( count, 0 );
+	mNumBallEvents.assign( count, 0 );
+	mEscaped.assign( count, 0 );
+	mEscapedBalls.clear();
+	mExtraNeighbors.resize( count );
+	for( auto &neighbors : mExtraNeighbors )
+		neighbors.clear();
+	mEvents.clear();
+
+	for( size_t i = 0; i < count; ++i )
+		scheduleEvents( i, limits, true );
+
+	// 4) resolve collisions in order of time of impact, rescheduling the balls involved. Each ball resolves at most
+	//    kMaxEventsPerBall events, after which it keeps its course until the end of the step.
+	const auto reschedule = [&]( size_t index ) {
+		updateReach( index, maxSpeed );
+
+		mVersion[index]++;
+		if( ++mNumBallEvents[index] < kMaxEventsPerBall )
+			scheduleEvents( index, limits, false );
+		else if( mNumBallEvents[index] == kMaxEventsPerBall )
+			mNumCappedBalls++;
+	};
+
+	while( !mEvents.empty() ) {
+		const Event event = mEvents.front();
+		std::pop_heap( mEvents.begin(), mEvents.end() );
+		mEvents.pop_back();
+
+		// skip events of balls that have changed course since the event was scheduled
+		const bool isEdge = event.b >= LEFT;
+		if( mVersion[event.a] != event.versionA || ( !isEdge && mVersion[event.b] != event.versionB ) )
+			continue;
+
+		const size_t a = event.a;
+		advance( a, event.time );
+
+		if( isEdge ) {
+			// to reduce the visual effect of the ball missing the border,
+			// set the previous position to where it hit the window
+			mPrevPositionX[a] = mPositionX[a];
+			mPrevPositionY[a] = mPositionY[a];
+
+			// reduce velocity due to friction
+			if( event.b == BOTTOM ) {
+				mVelocityX[a] *= 0.95f;
+				mVelocityY[a] *= -0.9f;
+			}
+			else {
+				mVelocityX[a] *= -0.95f;
+			}
+		}
+		else {
+			const size_t b = event.b;
+			advance( b, event.time );
+
+			// exchange the velocities along the line through both centers
+			const vec2 line( mPositionX[b] - mPositionX[a], mPositionY[b] - mPositionY[a] );
+			if( glm::dot( line, line ) > 0.0f ) {
+				const vec2  unit = glm::normalize( line );
+				const float velocity_a = mVelocityX[a] * unit.x + mVelocityY[a] * unit.y;
+				const float velocity_b = mVelocityX[b] * unit.x + mVelocityY[b] * unit.y;
+
+				mVelocityX[a] += ( velocity_b - velocity_a ) * unit.x;
+				mVelocityY[a] += ( velocity_b - velocity_a ) * unit.y;
+				mVelocityX[b] += ( velocity_a - velocity_b ) * unit.x;
+				mVelocityY[b] += ( velocity_a - velocity_b ) * unit.y;
+			}
+
+			mNumCollisions++;
+			reschedule( b );
+		}
+
+		mNumEvents++;
+		reschedule( a );
+	}
+
+	// 5) move all balls to the end of the step and make sure they stay within the window
+	for( size_t i = 0; i < count; ++i ) {
+		advance( i, 1.0f );
+
+		if( mPositionX[i] < limits.left ) {
+			mPositionX[i] = limits.left;
+			mVelocityX[i] = 0.0f;
+		}
+		else if( mPositionX[i] > limits.right ) {
+			mPositionX[i] = limits.right;
+			mVelocityX[i] = 0.0f;
+		}
+		if( mPositionY[i] > limits.bottom ) {
+			mPositionY[i] = limits.bottom;
+			mVelocityY[i] = 0.0f;
+		}
+	}
+}
+
+void Balls::advance( size_t index, float time )
+{
+	const float dt = time - mTime[index];
+
+	mPositionX[index] += dt * mVelocityX[index];
+	mPositionY[index] += dt * mVelocityY[index];
+	mTime[index] = time;
+}
+
+bool Balls::isWithinReach( size_t a, size_t b ) const
+{
+	const vec2  d( mReachX[b] - mReachX[a], mReachY[b] - mReachY[a] );
+	const float distance = 2.0f * kRadius + mReach[a] + mReach[b];
+
+	return glm::dot( d, d ) <= distance * distance;
+}
+
+void Balls::updateReach( size_t index, float maxSpeed )
+{
+	// nothing changes as long as the ball can not travel beyond its reach during the rest of the step
+	const vec2  position( mPositionX[index], mPositionY[index] );
+	const float remaining = ( 1.0f - mTime[index] ) * glm::length( vec2( mVelocityX[index], mVelocityY[index] ) );
+	if( glm::distance( position, vec2( mReachX[index], mReachY[index] ) ) + remaining <= mReach[index] )
+		return;
+
+	// the ball has been sped up by a collision, so find new neighbors from where it is now
+	mReachX[index] = position.x;
+	mReachY[index] = position.y;
+	mReach[index] = remaining;
+
+	if( !mEscaped[index] ) {
+		mEscaped[index] = 1;
+		mEscapedBalls.push_back( uint32_t( index ) );
+	}
+
+	const auto add = [&]( uint32_t other ) {
+		if( other != index && isWithinReach( index, other ) ) {
+			mExtraNeighbors[index].push_back( other );
+			mExtraNeighbors[other].push_back( uint32_t( index ) );
+		}
+	};
+
+	// the broad phase still has the balls that did not escape at their initial reach, which is at most maxSpeed.
+	// If the new reach is larger, all balls have to be tested.
+	if( remaining <= maxSpeed ) {
+		mBroadPhase.query( position.x, position.y, [&]( uint32_t other ) {
+			if( !mEscaped[other] )
+				add( other );
+		} );
+	}
+	else {
+		for( size_t other = 0; other < size(); ++other ) {
+			if( !mEscaped[other] )
+				add( uint32_t( other ) );
+		}
+	}
+
+	for( uint32_t other : mEscapedBalls )
+		add( other );
+}
+
+void Balls::scheduleEvents( size_t index, const Limits &limits, bool higherOnly )
+{
+	const float x = mPositionX[index];
+	const float y = mPositionY[index];
+	const float vx = mVelocityX[index];
+	const float vy = mVelocityY[index];
+	const float t = mTime[index];
+
+	// time of impact with the window edges, immediately if the ball is already past an edge
+	if( vx < 0.0f )
+		scheduleEvent( index, LEFT, t + math<float>::max( 0.0f, ( limits.left - x ) / vx ) );
+	else if( vx > 0.0f )
+		scheduleEvent( index, RIGHT, t + math<float>::max( 0.0f, ( limits.right - x ) / vx ) );
+	if( vy > 0.0f )
+		scheduleEvent( index, BOTTOM, t + math<float>::max( 0.0f, ( limits.bottom - y ) / vy ) );
+
+	// time of impact with the neighbors, found by solving |d + w * s| = 2r for the smallest s,
+	// where d and w are the differences in position and velocity at a common time
+	static const float kMinimalSquared = 4.0f * kRadius * kRadius;
+
+	const auto schedulePair = [&]( uint32_t other ) {
+		mNumPairsTested++;
+
+		const float time = math<float>::max( t, mTime[other] );
+		const vec2  d( ( mPositionX[other] + ( time - mTime[other] ) * mVelocityX[other] ) - ( x + ( time - t ) * vx ),
+		    ( mPositionY[other] + ( time - mTime[other] ) * mVelocityY[other] ) - ( y + ( time - t ) * vy ) );
+		const vec2 w( mVelocityX[other] - vx, mVelocityY[other] - vy );
+
+		const float b = glm::dot( d, w );
+		if( b >= 0.0f )
+			return; // moving apart
+
+		const float c = glm::dot( d, d ) - kMinimalSquared;
+		if( c < 0.0f ) {
+			// already touching and approaching
+			scheduleEvent( index, other, time );
+			return;
+		}
+
+		const float a = glm::dot( w, w );
+		const float discriminant = b * b - a * c;
+		if( discriminant < 0.0f )
+			return; // passing each other
+
+		scheduleEvent( index, other, time + ( -b - math<float>::sqrt( discriminant ) ) / a );
+	};
+
+	// the neighbors found at the start of the step no longer apply once a ball has escaped its reach.
+	// Balls that escaped have added themselves to the extra neighbors of the balls they might hit.
+	if( !mEscaped[index] ) {
+		for( uint32_t k = mNeighborStart[index]; k < mNeighborStart[index + 1]; ++k ) {
+			const uint32_t other = mNeighbors[k];
+			if( ( !higherOnly || other > index ) && !mEscaped[other] )
+				schedulePair( other );
+		}
+	}
+
+	for( uint32_t other : mExtraNeighbors[index] )
+		schedulePair( other );
+}
+
+void Balls::scheduleEvent( size_t index, uint32_t other, float time )
+{
+	if( time > 1.0f )
+		return;
+
+	Event event;
+	event.time = time;
+	event.a = uint32_t( index );
+	event.b = other;
+	event.versionA = mVersion[index];
+	event.versionB = ( other < LEFT ) ? mVersion[other] : 0;
+
+	mEvents.push_back( event );
+	std::push_heap( mEvents.begin(), mEvents.end() );
+}
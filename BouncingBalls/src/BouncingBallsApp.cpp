@@ -21,8 +21,8 @@
  */
 
 #include "cinder/ImageIo.h"
-#include "cinder/Rand.h"
 #include "cinder/Timer.h"
+#include "cinder/Utilities.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/Batch.h"
@@ -32,236 +32,51 @@
 #include "cinder/gl/VboMesh.h"
 #include "cinder/gl/gl.h"
 
+#include "BallInstances.h"
+#include "BallWorld.h"
+#include "TaskScheduler.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
-
-//////////////////////////////////////////
-
-typedef shared_ptr<class Ball> BallRef;
-
-class Ball {
-  public:
-	Ball();
-
-	void reset();
-
-	void update();
-	void draw( const gl::BatchRef &batch, bool useMotionBlur = true );
-
-	bool isCollidingWith( BallRef other );
-	void collideWith( BallRef other );
-
-	bool isCollidingWithWindow();
-	void collideWithWindow();
-
-  public:
-	static const int kRadius = 10;
-
-  public:
-	vec2 mPrevPosition;
-	vec2 mPosition;
-	vec2 mVelocity;
-
-	Colorf mColor;
-
-	float mGravity;
-
-	bool mHasBeenDrawn;
-};
-
-Ball::Ball()
-{
-	// Pick a random color.
-	float h = Rand::randFloat( 0.0f, 1.0f );
-	float s = Rand::randFloat( 0.75f, 1.0f );
-	float v = Rand::randFloat( 0.75f, 1.0f );
-	mColor = Colorf( CM_HSV, h, s, v );
-
-	reset();
-}
-
-void Ball::reset()
-{
-	// Pick a random position.
-	float x = Rand::randFloat() * getWindowWidth();
-	float y = -0.1f * getWindowHeight();
-	mPosition = vec2( x, y );
-	mPrevPosition = mPosition;
-
-	// Note: you can use the multiplier to tweak the speed of the system.
-	float multiplier = 0.5f;
-
-	// Note: set gravity to zero for outer space.
-	mGravity = 0.981f * multiplier;
-
-	// Pick a random velocity.
-	x = Rand::randFloat( -15.0f, 15.0f ) * multiplier;
-	y = Rand::randFloat( -15.0f, 0.0f ) * multiplier;
-	mVelocity = vec2( x, y );
-
-	//
-	mHasBeenDrawn = false;
-}
-
-void Ball::update()
-{
-	// Store current position.
-	if( mHasBeenDrawn )
-		mPrevPosition = mPosition;
-
-	// First, update the ball's velocity.
-	if( !isCollidingWithWindow() )
-		mVelocity.y += mGravity;
-
-	// Next, update the ball's position.
-	mPosition += mVelocity;
-
-	// Finally, perform collision detection.
-	collideWithWindow();
-
-	//
-	mHasBeenDrawn = false;
-}
-
-void Ball::draw( const gl::BatchRef &batch, bool useMotionBlur )
-{
-	// Store the current model matrix.
-	gl::pushModelMatrix();
-
-	if( useMotionBlur ) {
-		// Determine the number of balls that make up the motion blur trail (minimum of 3, maximum of 30).
-		float trailsize = math<float>::clamp( math<float>::floor( glm::distance( mPrevPosition, mPosition ) ), 3.0f, 30.0f );
-		float segments = trailsize - 1.0f;
-
-		// Draw ball with motion blur (using additive blending).
-		gl::ScopedColor color( mColor / trailsize );
-
-		vec2 offset( 0.0f, 0.0f );
-		for( size_t i = 0; i < trailsize; ++i ) {
-			vec2 difference = ci::lerp<vec2>( mPrevPosition, mPosition, i / segments ) - offset;
-			offset += difference;
-
-			gl::translate( difference );
-			batch->draw();
-		}
-	}
-	else {
-		// Draw ball without motion blur.
-		gl::ScopedColor color( mColor );
-		gl::translate( mPosition );
-		batch->draw();
-	}
-
-	// Restore the model matrix.
-	gl::popModelMatrix();
-
-	//
-	mHasBeenDrawn = true;
-}
-
-bool Ball::isCollidingWith( BallRef other )
-{
-	// This is a simplification: there is a change we will miss the collision.
-	return ( glm::distance( mPosition, other->mPosition ) < ( 2 * kRadius ) );
-}
-
-void Ball::collideWith( BallRef other )
-{
-	static const float kMinimal = 2.0f * kRadius;
-
-	// 1) we have already established that the two balls are colliding,
-	// let's move back in time to the moment before collision
-	mPosition -= mVelocity;
-	other->mPosition -= other->mVelocity;
-
-	// 2) convert to simple 1-dimensional collision
-	//	by projecting onto line through both centers
-	vec2 line = other->mPosition - mPosition;
-	vec2 unit = glm::normalize( line );
-
-	float distance = glm::dot( line, unit );
-	float velocity_a = glm::dot( mVelocity, unit );
-	float velocity_b = glm::dot( other->mVelocity, unit );
-	if( velocity_a == velocity_b )
-		return; // no collision will happen
-
-	// 3) find time of collision
-	float t = ( kMinimal - distance ) / ( velocity_b - velocity_a );
-
-	// 4) move to that moment in time
-	mPosition += t * mVelocity;
-	other->mPosition += t * other->mVelocity;
-
-	// 5) exchange velocities
-	mVelocity -= velocity_a * unit;
-	mVelocity += velocity_b * unit;
-
-	other->mVelocity -= velocity_b * unit;
-	other->mVelocity += velocity_a * unit;
-
-	// 6) move forward to current time
-	mPosition += ( 1.0f - t ) * mVelocity;
-	other->mPosition += ( 1.0f - t ) * other->mVelocity;
-
-	// 7) make sure the balls stay within window
-	collideWithWindow();
-	other->collideWithWindow();
-}
-
-bool Ball::isCollidingWithWindow()
-{
-	if( mPosition.x < ( 0.0f + kRadius ) || mPosition.x > ( getWindowWidth() - kRadius ) )
-		return true;
-	if( mPosition.y > ( getWindowHeight() - kRadius ) )
-		return true;
-
-	return false;
-}
-
-void Ball::collideWithWindow()
-{
-	//	1) check if the ball hits the left or right side of the window
-	if( mPosition.x < ( 0.0f + kRadius ) || mPosition.x > ( getWindowWidth() - kRadius ) ) {
-		// to reduce the visual effect of the ball missing the border,
-		// set the previous position to where we are now
-		mPrevPosition = mPosition;
-		// move the ball back into window without adding energy,
-		// by placing it where it would have been without friction
-		mPosition.x -= mVelocity.x;
-		// reduce velocity due to friction
-		mVelocity.x *= -0.95f;
-	}
-	//	2) check if the ball this the bottom of the window
-	if( mPosition.y > ( getWindowHeight() - kRadius ) ) {
-		// to reduce the visual effect of the ball missing the border,
-		// set the previous position to where we are now
-		mPrevPosition = mPosition;
-		// move the ball back into window without adding energy,
-		// by placing it where it would have been without friction
-		mPosition.y -= mVelocity.y;
-		// reduce velocity due to friction
-		mVelocity.x *= 0.95f;
-		mVelocity.y *= -0.9f;
-	}
-
-	//  3) if ball is still outside window,
-	//		it was probably moving very slow or fast. Let's reset it then.
-	if( mPosition.x < ( 0.0f + kRadius ) ) {
-		mPosition.x = 0.0f + (float)kRadius;
-		mVelocity.x = 0.0f;
-	}
-	else if( mPosition.x > ( getWindowWidth() - kRadius ) ) {
-		mPosition.x = getWindowWidth() - (float)kRadius;
-		mVelocity.x = 0.0f;
-	}
-	if( mPosition.y > ( getWindowHeight() - kRadius ) ) {
-		mPosition.y = getWindowHeight() - (float)kRadius;
-		mVelocity.y = 0.0f;
-	}
-}
-
+// Draws the ball mesh once for every instance, offset by the instance position.
+static const char *kInstancedVertexShader
+    = "#version 150\n"
+      ""
+      "uniform mat4 ciModelViewProjection;\n"
+      ""
+      "in vec4 ciPosition;\n"
+      "in vec2 ciTexCoord0;\n"
+      ""
+      "in vec2 iPosition;\n"
+      "in vec4 iColor;\n"
+      ""
+      "out vec2 vertTexCoord0;\n"
+      "out vec4 vertColor;\n"
+      ""
+      "void main()\n"
+      "{\n"
+      "	vertTexCoord0 = ciTexCoord0;\n"
+      "	vertColor = iColor;\n"
+      ""
+      "	gl_Position = ciModelViewProjection * ( ciPosition + vec4( iPosition, 0.0, 0.0 ) );\n"
+      "}";
+
+static const char *kInstancedFragmentShader
+    = "#version 150\n"
+      ""
+      "uniform sampler2D uTex0;\n"
+      ""
+      "in vec2 vertTexCoord0;\n"
+      "in vec4 vertColor;\n"
+      ""
+      "out vec4 fragColor;\n"
+      ""
+      "void main()\n"
+      "{\n"
+      "	fragColor = texture( uTex0, vertTexCoord0 ) * vertColor;\n"
+      "}";
 
 //////////////////////////////////////////
 
@@ -270,18 +85,27 @@ class BouncingBallsApp : public App {
 	void setup();
 	void update();
 	void draw();
+	void resize();
+
+	void cleanup();
 
 	void keyDown( KeyEvent event );
 
   private:
-	void performCollisions();
+	//! makes sure the instance buffer can hold \a count instances
+	void reserveInstances( size_t count );
+
+	//! runs the physics without drawing for a number of ball counts and prints the steps per second
+	void benchmark();
 
   private:
 	bool mUseMotionBlur;
+	bool mUseInstancing;
 	bool mIsPaused;
 
-	// our list of balls
-	std::vector<BallRef> mBalls;
+	// the simulation
+	std::unique_ptr<BallWorld> mWorld;
+	double                     mTime;
 
 	// mesh and texture
 	gl::VboMeshRef mMesh;
@@ -290,24 +114,49 @@ class BouncingBallsApp : public App {
 
 	// default shader
 	gl::GlslProgRef mShader;
+
+	// instanced drawing of balls and motion blur trails
+	BallInstances   mInstances;
+	gl::VboRef      mInstanceVbo;
+	gl::BatchRef    mInstancedBatch;
+	gl::GlslProgRef mInstancedShader;
+
+	// number of draw calls of the last frame
+	size_t mNumDrawCalls;
 };
 
 void BouncingBallsApp::setup()
 {
-	// randomize the random generator
-	Rand::randSeed( clock() );
+	// use a random seed, unless one was passed on the command line using --seed <number>
+	uint32_t    seed = uint32_t( clock() );
+	const auto &args = getCommandLineArgs();
+	for( size_t i = 0; i + 1 < args.size(); ++i ) {
+		if( args[i] == "--seed" )
+			seed = fromString<uint32_t>( args[i + 1] );
+	}
+
+	// print the seed, so that the run can be reproduced
+	console() << "Seed: " << seed << std::endl;
 
 	//
 	mUseMotionBlur = true;
+	mUseInstancing = true;
 	mIsPaused = false;
+	mNumDrawCalls = 0;
 
 	// allow maximum frame rate
 	disableFrameRate();
 	gl::enableVerticalSync( false );
 
-	// create a few balls
-	for( size_t i = 0; i < 25; ++i )
-		mBalls.push_back( BallRef( new Ball() ) );
+	// create the simulation with a few balls, running at a steady 60 updates per second
+	BallWorld::Options options;
+	options.seed = seed;
+	options.timeStep = 1.0 / 60.0;
+	options.bounds = getWindowSize();
+	options.numBalls = 25;
+
+	mWorld.reset( new BallWorld( options ) );
+	mTime = getElapsedSeconds();
 
 	// create a default shader with color and texture support
 	mShader = gl::context()->getStockShader( gl::ShaderDef().color().texture() );
@@ -327,7 +176,7 @@ void BouncingBallsApp::setup()
 		vec2  v( sinf( angle ), cosf( angle ) );
 
 		texcoords.push_back( vec2( 0.5f, 0.5f ) + 0.5f * v );
-		positions.push_back( (float)Ball::kRadius * vec3( v, 0.0f ) );
+		positions.push_back( (float)Balls::kRadius * vec3( v, 0.0f ) );
 	}
 
 	gl::VboMesh::Layout layout;
@@ -342,52 +191,95 @@ void BouncingBallsApp::setup()
 	// combine mesh and shader into batch for much better performance
 	mBatch = gl::Batch::create( mMesh, mShader );
 
+	// create a shader that draws all balls and their trails in a single draw call
+	mInstancedShader = gl::GlslProg::create( kInstancedVertexShader, kInstancedFragmentShader );
+	reserveInstances( 1024 );
+
 	// load texture
 	mTexture = gl::Texture::create( loadImage( loadAsset( "ball.png" ) ) );
 }
 
 void BouncingBallsApp::update()
 {
-	// Use a fixed time step for a steady 60 updates per second.
-	static const double timestep = 1.0 / 60.0;
-
-	// Keep track of time.
-	static double time = getElapsedSeconds();
-	static double accumulator = 0.0;
-
 	// Calculate elapsed time since last frame.
-	double elapsed = getElapsedSeconds() - time;
-	time += elapsed;
-
-	// Update the simulation.
-	accumulator += math<double>::min( elapsed, 0.1 ); // prevents 'spiral of death'
-	while( accumulator >= timestep ) {
-		accumulator -= timestep;
+	double elapsed = getElapsedSeconds() - mTime;
+	mTime += elapsed;
 
-		if( !mIsPaused ) {
-			// Move the balls.
-			for( auto &ball : mBalls )
-				ball->update();
-
-			// Perform collision detection and response.
-			performCollisions();
-		}
-	}
+	// Update the simulation, which will move the balls and perform collision detection and response
+	// using a fixed time step.
+	if( !mIsPaused )
+		mWorld->update( elapsed );
 }
 
 void BouncingBallsApp::draw()
 {
 	gl::clear();
 
-	gl::ScopedBlendAdditive blend;
+	// Create an instance for every ball, or for every segment of its motion blur trail.
+	Balls &balls = mWorld->getBalls();
+	mInstances.build( balls, mUseMotionBlur );
+	balls.markDrawn();
+
+	{
+		gl::ScopedBlendAdditive blend;
+		gl::ScopedTextureBind   tex0( mTexture );
+
+		if( mUseInstancing ) {
+			if( !mInstances.empty() ) {
+				reserveInstances( mInstances.size() );
+
+				void *ptr = mInstanceVbo->mapReplace();
+				memcpy( ptr, mInstances.getInstances().data(), mInstances.size() * sizeof( BallInstance ) );
+				mInstanceVbo->unmap();
+
+				gl::ScopedGlslProg shader( mInstancedShader );
+				mInstancedShader->uniform( "uTex0", 0 );
+
+				mInstancedBatch->drawInstanced( mInstances.size() );
+			}
+
+			mNumDrawCalls = mInstances.empty() ? 0 : 1;
+		}
+		else {
+			// For comparison: draw each instance separately.
+			gl::ScopedGlslProg shader( mShader );
+			mShader->uniform( "uTex0", 0 );
+
+			for( auto &instance : mInstances.getInstances() ) {
+				gl::ScopedModelMatrix model;
+				gl::ScopedColor       color( ColorA( instance.color.r, instance.color.g, instance.color.b, instance.color.a ) );
+				gl::translate( instance.position );
+				mBatch->draw();
+			}
+
+			mNumDrawCalls = mInstances.getNumDrawCallsNotInstanced();
+		}
+	}
 
-	gl::ScopedGlslProg shader( mShader );
-	mShader->uniform( "uTex0", 0 );
+	// Show the number of draw calls.
+	std::stringstream str;
+	str << balls.size() << " balls, " << mInstances.size() << " instances, " << mNumDrawCalls << " draw calls";
+	str << ( mUseInstancing ? " (instanced)" : " (not instanced)" );
+	gl::drawString( str.str(), vec2( 10, 10 ) );
+
+	str.str( std::string() );
+	str << ( balls.getCollisionMode() == Balls::CONTINUOUS ? "continuous" : "discrete" ) << " collisions, ";
+	str << balls.getNumEvents() << " events per step";
+	if( balls.getNumCappedBalls() > 0 )
+		str << ", " << balls.getNumCappedBalls() << " balls reached the event limit";
+	gl::drawString( str.str(), vec2( 10, 24 ) );
+}
 
-	gl::ScopedTextureBind tex0( mTexture );
+void BouncingBallsApp::resize()
+{
+	// the balls bounce off the edges of the window
+	mWorld->setBounds( getWindowSize() );
+}
 
-	for( auto &ball : mBalls )
-		ball->draw( mBatch, mUseMotionBlur );
+void BouncingBallsApp::cleanup()
+{
+	// stop the threads used by the physics
+	ph::TaskScheduler::getInstance().shutdown();
 }
 
 void BouncingBallsApp::keyDown( KeyEvent event )
@@ -399,8 +291,7 @@ void BouncingBallsApp::keyDown( KeyEvent event )
 		break;
 	case KeyEvent::KEY_SPACE:
 		// reset all balls
-		for( auto &ball : mBalls )
-			ball->reset();
+		mWorld->resetBalls();
 		break;
 	case KeyEvent::KEY_RETURN:
 		// pause/resume simulation
@@ -413,13 +304,12 @@ void BouncingBallsApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_PLUS:
 	case KeyEvent::KEY_KP_PLUS:
 		// create a new ball
-		mBalls.push_back( BallRef( new Ball() ) );
+		mWorld->addBall();
 		break;
 	case KeyEvent::KEY_MINUS:
 	case KeyEvent::KEY_KP_MINUS:
 		// remove the oldest ball
-		if( !mBalls.empty() )
-			mBalls.erase( mBalls.begin() );
+		mWorld->removeBall();
 		break;
 	case KeyEvent::KEY_f:
 		setFullScreen( !isFullScreen() );
@@ -430,6 +320,16 @@ void BouncingBallsApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_m:
 		mUseMotionBlur = !mUseMotionBlur;
 		break;
+	case KeyEvent::KEY_i:
+		mUseInstancing = !mUseInstancing;
+		break;
+	case KeyEvent::KEY_c:
+		// switch between discrete and continuous collision detection
+		mWorld->getBalls().setCollisionMode( mWorld->getBalls().getCollisionMode() == Balls::DISCRETE ? Balls::CONTINUOUS : Balls::DISCRETE );
+		break;
+	case KeyEvent::KEY_b:
+		benchmark();
+		break;
 	case KeyEvent::KEY_1:
 		setFrameRate( 10.0f );
 		break;
@@ -445,20 +345,106 @@ void BouncingBallsApp::keyDown( KeyEvent event )
 	}
 }
 
-void BouncingBallsApp::performCollisions()
+void BouncingBallsApp::reserveInstances( size_t count )
+{
+	size_t capacity = mInstanceVbo ? mInstanceVbo->getSize() / sizeof( BallInstance ) : 0;
+	if( capacity >= count )
+		return;
+
+	while( capacity < count )
+		capacity = math<size_t>::max( 1024, 2 * capacity );
+
+	// a mesh can not replace its instance buffer, so create a new mesh using the same vertex buffers
+	mInstanceVbo = gl::Vbo::create( GL_ARRAY_BUFFER, capacity * sizeof( BallInstance ), nullptr, GL_STREAM_DRAW );
+
+	geom::BufferLayout instanceDataLayout;
+	instanceDataLayout.append( geom::Attrib::CUSTOM_0, 2, sizeof( BallInstance ), offsetof( BallInstance, position ), 1 /* per instance */ );
+	instanceDataLayout.append( geom::Attrib::CUSTOM_1, 4, sizeof( BallInstance ), offsetof( BallInstance, color ), 1 /* per instance */ );
+
+	auto mesh = gl::VboMesh::create( mMesh->getNumVertices(), mMesh->getGlPrimitive(), mMesh->getVertexArrayLayoutVbos() );
+	mesh->appendVbo( instanceDataLayout, mInstanceVbo );
+
+	mInstancedBatch = gl::Batch::create( mesh, mInstancedShader, { { geom::Attrib::CUSTOM_0, "iPosition" }, { geom::Attrib::CUSTOM_1, "iColor" } } );
+}
+
+void BouncingBallsApp::benchmark()
 {
-	// determine which balls are colliding,
-	// by checking every pair of balls only once
-	std::vector<BallRef>::iterator itr1, itr2;
-	for( itr1 = mBalls.begin(); itr1 < mBalls.end() - 1; ++itr1 ) {
-		for( itr2 = itr1 + 1; itr2 < mBalls.end(); ++itr2 ) {
-			// do quick check
-			if( ( *itr1 )->isCollidingWith( *itr2 ) ) {
-				// do collision
-				( *itr1 )->collideWith( *itr2 );
+	static const size_t kCounts[] = { 1000, 10000, 100000 };
+
+	// Creates the same balls for the same count, like the BallWorldBenchmark project does.
+	auto createWorld = []( size_t count ) { return std::unique_ptr<BallWorld>( new BallWorld( BallWorld::createBenchmarkOptions( count, 12345 ) ) ); };
+
+	console() << "Benchmarking physics:" << std::endl;
+	console() << "balls\tmode\tsteps/s\tpairs/step\tevents/step\tus/event" << std::endl;
+
+	for( size_t count : kCounts ) {
+		for( auto mode : { Balls::DISCRETE, Balls::CONTINUOUS } ) {
+			auto   world = createWorld( count );
+			Balls &balls = world->getBalls();
+			balls.setCollisionMode( mode );
+
+			// Run for at least a second and at least 10 steps.
+			size_t pairs = 0;
+			size_t events = 0;
+			size_t steps = 0;
+
+			Timer timer( true );
+			while( steps < 10 || timer.getSeconds() < 1.0 ) {
+				world->step();
+
+				pairs += balls.getNumPairsTested();
+				events += balls.getNumEvents();
+				steps++;
 			}
+			timer.stop();
+
+			console() << count << "\t" << ( mode == Balls::CONTINUOUS ? "continuous" : "discrete" ) << "\t";
+			console() << steps / timer.getSeconds() << "\t" << pairs / steps << "\t" << events / steps << "\t";
+			console() << 1.0e6 * timer.getSeconds() / math<size_t>::max( events, 1 ) << std::endl;
 		}
 	}
+
+	console() << "Comparing integrators:" << std::endl;
+	console() << "balls\tscalar update (ms)\tsimd update (ms)\tidentical" << std::endl;
+
+	for( size_t count : kCounts ) {
+		// Compare the scalar integrator with the vectorized and multithreaded one, starting from the same balls.
+		auto   scalarWorld = createWorld( count );
+		Balls &scalar = scalarWorld->getBalls();
+		scalar.setSimdEnabled( false );
+		scalar.setMultithreaded( false );
+
+		auto   simdWorld = createWorld( count );
+		Balls &simd = simdWorld->getBalls();
+
+		const vec2 bounds = simdWorld->getBounds();
+
+		Timer  timer;
+		double scalarSeconds = 0.0;
+		double simdSeconds = 0.0;
+		bool   identical = true;
+		size_t steps = 0;
+
+		// stop at the first difference, so the timings are averaged over the steps that were actually taken
+		for( ; steps < 100 && identical; ++steps ) {
+			timer.start();
+			scalar.update( bounds );
+			timer.stop();
+			scalarSeconds += timer.getSeconds();
+
+			timer.start();
+			simd.update( bounds );
+			timer.stop();
+			simdSeconds += timer.getSeconds();
+
+			scalar.performCollisions( bounds );
+			simd.performCollisions( bounds );
+
+			identical = simd.isIdentical( scalar );
+		}
+
+		console() << count << "\t" << 1000.0 * scalarSeconds / steps << "\t" << 1000.0 * simdSeconds / steps << "\t" << ( identical ? "yes" : "NO" ) << std::endl;
+	}
 }
 
 CINDER_APP( BouncingBallsApp, RendererGl )
\ No newline at end of file
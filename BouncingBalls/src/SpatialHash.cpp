@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SpatialHash.h"
+
+SpatialHash::SpatialHash()
+    : mInvCellSize( 1.0f )
+    , mMask( 0 )
+{
+}
+
+void SpatialHash::build( const float *x, const float *y, size_t count, float cellSize )
+{
+	mInvCellSize = 1.0f / cellSize;
+
+	// use at least as many buckets as there are items, rounded up to a power of two
+	uint32_t numBuckets = 64;
+	while( numBuckets < count )
+		numBuckets <<= 1;
+	mMask = numBuckets - 1;
+
+	mStart.assign( numBuckets + 1, 0 );
+	mItems.resize( count );
+	mBuckets.resize( count );
+
+	// count the number of items per bucket
+	for( size_t i = 0; i < count; ++i ) {
+		const uint32_t bucket = getBucket( getCell( x[i] ), getCell( y[i] ) );
+		mBuckets[i] = bucket;
+		mStart[bucket + 1]++;
+	}
+
+	// convert counts to offsets
+	for( uint32_t i = 0; i < numBuckets; ++i )
+		mStart[i + 1] += mStart[i];
+
+	// distribute the items, in ascending order within each bucket
+	std::vector<uint32_t> &next = mScratch;
+	next.assign( mStart.begin(), mStart.end() - 1 );
+
+	for( size_t i = 0; i < count; ++i )
+		mItems[next[mBuckets[i]]++] = uint32_t( i );
+}
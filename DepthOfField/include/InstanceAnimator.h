@@ -0,0 +1,45 @@
+#pragma once
+
+#include "cinder/Matrix.h"
+
+#include <cstdint>
+#include <vector>
+
+//! Animates a grid of instances that each spin around their own random axis. The random parameters are generated once
+//! in setup(), after which the transform of every instance only depends on time. Transforms are evaluated four at a
+//! time using SSE2 where available, optionally spread over the TaskScheduler's worker threads.
+class InstanceAnimator {
+  public:
+	InstanceAnimator();
+
+	//! creates \a size x \a size x \a size instances, \a spacing units apart, using \a seed for the random parameters
+	void setup( int size = 9, float spacing = 5.0f, uint32_t seed = 12345 );
+
+	size_t getCount() const { return mAngle.size(); }
+
+	//! writes the model matrix of every instance at \a time (in seconds) to \a dst, which must have room for getCount() matrices
+	void evaluate( double time, ci::mat4 *dst ) const;
+
+	//! if disabled, evaluates all instances on the calling thread
+	void setMultithreaded( bool enabled = true ) { mMultithreaded = enabled; }
+	bool isMultithreaded() const { return mMultithreaded; }
+
+	//! if disabled, evaluates one instance at a time, which is useful for comparison
+	void setSimd( bool enabled = true ) { mSimd = enabled; }
+	bool isSimd() const { return mSimd; }
+
+  private:
+	//! writes the model matrices of instances [\a begin, \a end)
+	void evaluateRange( size_t begin, size_t end, float time, ci::mat4 *dst ) const;
+
+  private:
+	bool mMultithreaded;
+	bool mSimd;
+
+	//! center of each instance
+	std::vector<float> mPositionX, mPositionY, mPositionZ;
+	//! normalized axis of rotation of each instance
+	std::vector<float> mAxisX, mAxisY, mAxisZ;
+	//! rotation at time zero and rotation speed of each instance, in radians and radians per second
+	std::vector<float> mAngle, mSpeed;
+};
@@ -1,12 +1,16 @@
 #include "cinder/Camera.h"
 #include "cinder/CameraUi.h"
-#include "cinder/Rand.h"
 #include "cinder/Sphere.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
 #include "cinder/params/Params.h"
 
+#include "BoundingVolumeHierarchy.h"
+#include "FrustumCuller.h"
+#include "InstanceAnimator.h"
+#include "TaskScheduler.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -29,6 +33,8 @@ class DepthOfFieldApp : public App {
 	    , mShiftDown( false )
 	    , mShowBounds( false )
 	    , mEnableDemo( false )
+	    , mCulling( true )
+	    , mNumVisible( 0 )
 	{
 	}
 
@@ -48,21 +54,35 @@ class DepthOfFieldApp : public App {
 
 	void resize() override;
 
+	void cleanup() override;
+
 	void reload();
 
   private:
-	CameraPersp            mCamera;                         // Our main camera.
-	CameraPersp            mCameraUser;                     // Our user camera. We'll smoothly interpolate the main camera using the user camera as reference.
-	CameraUi               mCameraUi;                       // Allows us to control the user camera.
-	Sphere                 mBounds;                         // Bounding sphere of a single teapot, allows us to easily find the object under the cursor.
-	gl::VboRef             mInstances;                      // Buffer containing the model matrix for each teapot.
-	gl::BatchRef           mTeapots, mBackground, mSpheres; // Batches to draw our objects.
-	gl::TextureRef         mTexGold, mTexClay;              // Textures.
-	gl::FboRef             mFboSource;                      // We render the scene to this Fbo, which is then used as input to the Depth-of-Field pass.
-	gl::FboRef             mFboBlur[2];                     // Downsampled and blurred versions of our scene.
-	gl::GlslProgRef        mGlslBlur[2];                    // Horizontal and vertical blur shaders.
-	gl::GlslProgRef        mGlslComposite;                  // Composite shader.
-	params::InterfaceGlRef mParams;                         // Debug parameters.
+	void uploadInstances(); // Copies the model matrices of the teapots inside the view frustum to the instance buffer.
+
+	// Tests the ray against the bounding box of a teapot. Returns TRUE and updates the distance if it is hit closer than that.
+	bool intersectTeapot( const Ray &ray, uint32_t index, float &distance ) const;
+
+  private:
+	CameraPersp                 mCamera;                         // Our main camera.
+	CameraPersp                 mCameraUser;                     // Our user camera. We'll smoothly interpolate the main camera using the user camera as reference.
+	CameraUi                    mCameraUi;                       // Allows us to control the user camera.
+	Sphere                      mBounds;                         // Bounding sphere of a single teapot, drawn to visualize the bounds.
+	gl::VboRef                  mInstances;                      // Buffer containing the model matrix for each visible teapot.
+	std::vector<mat4>           mMatrices;                       // Model matrix for each teapot.
+	InstanceAnimator            mAnimator;                       // Calculates the model matrices from time.
+	AxisAlignedBox              mTeapotBounds;                   // Bounding box of a single teapot, used for frustum culling and picking.
+	ph::BoundingBoxes           mInstanceBounds;                 // Bounding box of each teapot in world space.
+	ph::BoundingVolumeHierarchy mHierarchy;                      // Allows us to quickly find the teapot under the cursor.
+	std::vector<uint32_t>       mVisible;                        // Indices of the teapots inside the view frustum.
+	gl::BatchRef                mTeapots, mBackground, mSpheres; // Batches to draw our objects.
+	gl::TextureRef              mTexGold, mTexClay;              // Textures.
+	gl::FboRef                  mFboSource;                      // We render the scene to this Fbo, which is then used as input to the Depth-of-Field pass.
+	gl::FboRef                  mFboBlur[2];                     // Downsampled and blurred versions of our scene.
+	gl::GlslProgRef             mGlslBlur[2];                    // Horizontal and vertical blur shaders.
+	gl::GlslProgRef             mGlslComposite;                  // Composite shader.
+	params::InterfaceGlRef      mParams;                         // Debug parameters.
 
 	float mAperture;           // Calculated from F-Stop and Focal Length.
 	int   mFocalStop;          // For more information on these values, see: http://improvephotography.com/photography-basics/aperture-shutter-speed-and-iso/
@@ -83,6 +103,9 @@ class DepthOfFieldApp : public App {
 	bool mShiftDown;
 	bool mShowBounds;
 	bool mEnableDemo;
+	bool mCulling;
+
+	int mNumVisible;
 
 	vec2 mMousePos;
 };
@@ -104,27 +127,16 @@ void DepthOfFieldApp::setup()
 	mTexGold = gl::Texture2d::create( loadImage( loadAsset( "gold.png" ) ) );
 	mTexClay = gl::Texture2d::create( loadImage( loadAsset( "clay.png" ) ) );
 
-	// Initialize model matrices (one for each instance).
-	std::vector<mat4> matrices;
-	for( int z = -4; z <= 4; z++ ) {
-		for( int y = -4; y <= 4; y++ ) {
-			for( int x = -4; x <= 4; x++ ) {
-				vec3  axis = Rand::randVec3();
-				float angle = Rand::randFloat( -180.0f, 180.0f );
-
-				mat4 transform = glm::translate( vec3( x, y, z ) * 5.0f );
-				transform *= glm::rotate( glm::radians( angle ), axis );
-
-				matrices.emplace_back( transform );
-			}
-		}
-	}
+	// Generate the animation parameters of each teapot, then initialize model matrices (one for each instance).
+	mAnimator.setup( 9, 5.0f, 12345 );
+	mMatrices.resize( mAnimator.getCount() );
+	mAnimator.evaluate( mTime, mMatrices.data() );
 
 	// Setup per-instance data buffer.
 	geom::BufferLayout layout;
 	layout.append( geom::Attrib::CUSTOM_0, sizeof( mat4 ) / sizeof( float ) /* dims */, sizeof( mat4 ) /* stride */, 0, 1 /* per instance */ );
 
-	mInstances = gl::Vbo::create( GL_ARRAY_BUFFER, matrices.size() * sizeof( mat4 ), matrices.data(), GL_STREAM_DRAW );
+	mInstances = gl::Vbo::create( GL_ARRAY_BUFFER, mMatrices.size() * sizeof( mat4 ), mMatrices.data(), GL_STREAM_DRAW );
 
 	// Create mesh and append per-instance data.
 	AxisAlignedBox bounds;
@@ -132,6 +144,8 @@ void DepthOfFieldApp::setup()
 	auto mesh = gl::VboMesh::create( geom::Teapot().subdivisions( 9 ) >> geom::Translate( 0, -0.5f, 0 ) >> geom::Bounds( &bounds ) );
 	mesh->appendVbo( layout, mInstances );
 
+	mTeapotBounds = bounds;
+
 	mBounds.setCenter( bounds.getCenter() );
 	mBounds.setRadius( 0.5f * glm::length( bounds.getExtents() ) ); // Scale down for a better fit.
 
@@ -159,6 +173,7 @@ void DepthOfFieldApp::setup()
 	mParams->setOptions( "", "valueswidth=120" );
 	mParams->setOptions( "", "refresh=0.05" );
 	mParams->addParam( "FPS", &mFPS, false ).step( 0.1f );
+	mParams->addParam( "Visible", &mNumVisible, true );
 	mParams->addSeparator();
 	mParams->addParam( "Focal Distance", &mFocus, false ).min( 0.1f ).max( 100.0f ).step( 0.1f );
 	mParams->addParam( "F-stop", { "0.7", "0.8", "1.0", "1.2", "1.4", "1.7", "2.0", "2.4", "2.8", "3.3", "4.0", "4.8", "5.6", "6.7", "8.0", "9.5", "11.0", "16.0", "22.0" }, &mFocalStop, false );
@@ -173,6 +188,7 @@ void DepthOfFieldApp::setup()
 	mParams->addSeparator();
 	mParams->addButton( "Pause", [&]() { mPaused = !mPaused; } );
 	mParams->addButton( "Demo", [&]() { mEnableDemo = !mEnableDemo; } );
+	mParams->addButton( "Culling", [&]() { mCulling = !mCulling; } );
 	mParams->addText( "Hold SHIFT to auto-focus." );
 
 	// Note: the Fbo's will be created in the update() function after the window has been resized.
@@ -239,6 +255,45 @@ void DepthOfFieldApp::update()
 
 		accumulator -= timestep;
 	}
+
+	// Animate teapots. Their model matrices only depend on time, so they only need to be calculated once per frame.
+	mAnimator.evaluate( mTime, mMatrices.data() );
+
+	// Update the bounding box of each teapot, used for culling and picking.
+	mInstanceBounds.clear();
+	mInstanceBounds.reserve( mMatrices.size() );
+	for( const auto &transform : mMatrices )
+		mInstanceBounds.push_back( transform, mTeapotBounds );
+
+	// Auto-focus on the teapot under the cursor.
+	if( mShiftDown ) {
+		// The teapots only rotate in place, so the hierarchy is built once and then refitted to their new bounds.
+		if( mHierarchy.empty() )
+			mHierarchy.build( mInstanceBounds );
+		else
+			mHierarchy.refit( mInstanceBounds );
+
+		auto  ray = mCamera.generateRay( mMousePos, getWindowSize() );
+		float distance;
+
+		if( mHierarchy.raycast( ray, [&]( uint32_t index, float &nearest ) { return intersectTeapot( ray, index, nearest ); }, &distance ) >= 0 )
+			mFocus = distance;
+	}
+}
+
+bool DepthOfFieldApp::intersectTeapot( const Ray &ray, uint32_t index, float &distance ) const
+{
+	// Transform the ray to object space. The model matrices only rotate and translate, so distances along the ray remain the same.
+	const mat4 inverse = glm::inverse( mMatrices[index] );
+	const Ray  local( vec3( inverse * vec4( ray.getOrigin(), 1 ) ), vec3( inverse * vec4( ray.getDirection(), 0 ) ) );
+
+	float min, max;
+	if( mTeapotBounds.intersect( local, &min, &max ) > 0 && min < distance ) {
+		distance = min;
+		return true;
+	}
+
+	return false;
 }
 
 void DepthOfFieldApp::update( double timestep )
@@ -290,51 +345,35 @@ void DepthOfFieldApp::update( double timestep )
 
 	static const float fstops[] = { 0.7f, 0.8f, 1.0f, 1.2f, 1.4f, 1.7f, 2.0f, 2.4f, 2.8f, 3.3f, 4.0f, 4.8f, 5.6f, 6.7f, 8.0f, 9.5f, 11.0f, 16.0f, 22.0f };
 	mAperture = mFocalLength / fstops[mFocalStop];
+}
 
-	// Initialize ray-casting.
-	auto  ray = mCamera.generateRay( mMousePos, getWindowSize() );
-	float min, max, dist = FLT_MAX;
-
-	// Reset random number generator.
-	Rand::randSeed( 12345 );
+void DepthOfFieldApp::uploadInstances()
+{
+	if( mCulling ) {
+		ph::FrustumCuller culler( mCamera );
+		culler.cull( mInstanceBounds, mVisible );
+	}
+	else {
+		mVisible.resize( mMatrices.size() );
+		for( size_t i = 0; i < mVisible.size(); ++i )
+			mVisible[i] = uint32_t( i );
+	}
 
-	// Animate teapots and perform ray casting at the same time.
 	auto ptr = (mat4 *)mInstances->mapReplace();
-	for( int z = -4; z <= 4; z++ ) {
-		for( int y = -4; y <= 4; y++ ) {
-			for( int x = -4; x <= 4; x++ ) {
-				vec3  position = vec3( x, y, z ) * 5.0f + Rand::randVec3();
-				vec3  axis = Rand::randVec3();
-				float angle = Rand::randFloat( -180.0f, 180.0f ) + Rand::randFloat( 1.0f, 90.0f ) * float( mTime );
-
-				mat4 transform = glm::translate( position );
-				transform *= glm::rotate( glm::radians( angle ), axis );
-
-				( *ptr++ ) = transform;
-
-				// Ray-casting.
-				if( mShiftDown ) {
-					auto bounds = mBounds.transformed( transform );
-					if( bounds.intersect( ray, &min, &max ) > 0 ) {
-						if( min < dist )
-							dist = min;
-					}
-				}
-			}
-		}
-	}
+	for( uint32_t index : mVisible )
+		( *ptr++ ) = mMatrices[index];
 	mInstances->unmap();
 
-	// Auto-focus.
-	if( mShiftDown && dist < FLT_MAX ) {
-		mFocus = dist;
-	}
+	mNumVisible = int( mVisible.size() );
 }
 
 void DepthOfFieldApp::draw()
 {
 	gl::clear();
 
+	// Only the teapots inside the view frustum will be drawn.
+	uploadInstances();
+
 	// Render RGB and normalized CoC (in alpha channel) to Fbo.
 	if( true ) {
 		gl::ScopedFramebuffer scpFbo( mFboSource );
@@ -360,7 +399,7 @@ void DepthOfFieldApp::draw()
 			mTeapots->getGlslProg()->uniform( "uFocalLength", mFocalLength );
 			mTeapots->getGlslProg()->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
 
-			mTeapots->drawInstanced( 9 * 9 * 9 );
+			mTeapots->drawInstanced( mNumVisible );
 		}
 
 		if( true ) {
@@ -388,7 +427,7 @@ void DepthOfFieldApp::draw()
 			mSpheres->getGlslProg()->uniform( "uFocalDistance", mFocalPlane );
 			mSpheres->getGlslProg()->uniform( "uFocalLength", mFocalLength );
 			mSpheres->getGlslProg()->uniform( "uMaxCoCRadiusPixels", mMaxCoCRadiusPixels );
-			mSpheres->drawInstanced( 9 * 9 * 9 );
+			mSpheres->drawInstanced( mNumVisible );
 		}
 	}
 
@@ -493,6 +532,9 @@ void DepthOfFieldApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_b:
 		mShowBounds = !mShowBounds;
 		break;
+	case KeyEvent::KEY_c:
+		mCulling = !mCulling;
+		break;
 	case KeyEvent::KEY_d:
 		mEnableDemo = !mEnableDemo;
 		break;
@@ -510,6 +552,12 @@ void DepthOfFieldApp::keyDown( KeyEvent event )
 	}
 }
 
+void DepthOfFieldApp::cleanup()
+{
+	// Stop the threads used to animate the teapots.
+	ph::TaskScheduler::getInstance().shutdown();
+}
+
 void DepthOfFieldApp::resize()
 {
 	mCamera.setAspectRatio( getWindowAspectRatio() );
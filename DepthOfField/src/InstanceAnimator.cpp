@@ -0,0 +1,217 @@
+#include "InstanceAnimator.h"
+#include "TaskScheduler.h"
+
+#include "cinder/Rand.h"
+
+#include <cmath>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define INSTANCE_ANIMATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace ci;
+
+namespace {
+
+// Cody-Waite reduction by pi/2, so that sin and cos only need to be approximated on [-pi/4, pi/4]
+const float kTwoOverPi = 0.636619772367581f;
+const float kHalfPi1 = 1.5703125f;
+const float kHalfPi2 = 4.837512969970703125e-4f;
+const float kHalfPi3 = 7.54978995489188216e-8f;
+
+// Minimax polynomials, accurate to about one ulp on [-pi/4, pi/4]
+const float kSin1 = -1.6666654611e-1f;
+const float kSin2 = 8.3321608736e-3f;
+const float kSin3 = -1.9515295891e-4f;
+const float kCos1 = 4.166664568298827e-2f;
+const float kCos2 = -1.388731625493765e-3f;
+const float kCos3 = 2.443315711809948e-5f;
+
+void sincos( float x, float &s, float &c )
+{
+	const float q = std::nearbyint( x * kTwoOverPi );
+	const float r = ( ( x - q * kHalfPi1 ) - q * kHalfPi2 ) - q * kHalfPi3;
+	const float r2 = r * r;
+
+	const float ps = r + r * r2 * ( kSin1 + r2 * ( kSin2 + r2 * kSin3 ) );
+	const float pc = 1.0f - 0.5f * r2 + r2 * r2 * ( kCos1 + r2 * ( kCos2 + r2 * kCos3 ) );
+
+	// pick the right polynomial and sign for the quadrant
+	const int quadrant = int( q ) & 3;
+	s = ( quadrant & 1 ) ? pc : ps;
+	c = ( quadrant & 1 ) ? ps : pc;
+	if( quadrant == 1 || quadrant == 2 )
+		c = -c;
+	if( quadrant & 2 )
+		s = -s;
+}
+
+#if defined( INSTANCE_ANIMATOR_SSE2 )
+
+void sincos( __m128 x, __m128 &s, __m128 &c )
+{
+	const __m128i qi = _mm_cvtps_epi32( _mm_mul_ps( x, _mm_set1_ps( kTwoOverPi ) ) );
+	const __m128  q = _mm_cvtepi32_ps( qi );
+
+	__m128 r = _mm_sub_ps( x, _mm_mul_ps( q, _mm_set1_ps( kHalfPi1 ) ) );
+	r = _mm_sub_ps( r, _mm_mul_ps( q, _mm_set1_ps( kHalfPi2 ) ) );
+	r = _mm_sub_ps( r, _mm_mul_ps( q, _mm_set1_ps( kHalfPi3 ) ) );
+	const __m128 r2 = _mm_mul_ps( r, r );
+
+	__m128 ps = _mm_add_ps( _mm_set1_ps( kSin2 ), _mm_mul_ps( r2, _mm_set1_ps( kSin3 ) ) );
+	ps = _mm_add_ps( _mm_set1_ps( kSin1 ), _mm_mul_ps( r2, ps ) );
+	ps = _mm_add_ps( r, _mm_mul_ps( _mm_mul_ps( r, r2 ), ps ) );
+
+	__m128 pc = _mm_add_ps( _mm_set1_ps( kCos2 ), _mm_mul_ps( r2, _mm_set1_ps( kCos3 ) ) );
+	pc = _mm_add_ps( _mm_set1_ps( kCos1 ), _mm_mul_ps( r2, pc ) );
+	pc = _mm_add_ps( _mm_sub_ps( _mm_set1_ps( 1.0f ), _mm_mul_ps( _mm_set1_ps( 0.5f ), r2 ) ), _mm_mul_ps( _mm_mul_ps( r2, r2 ), pc ) );
+
+	// odd quadrants swap sin and cos, quadrants 2 and 3 negate sin, quadrants 1 and 2 negate cos
+	const __m128i one = _mm_set1_epi32( 1 );
+	const __m128  swap = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( qi, one ), one ) );
+	const __m128  signS = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( qi, _mm_set1_epi32( 2 ) ), 30 ) );
+	const __m128  signC = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( _mm_add_epi32( qi, one ), _mm_set1_epi32( 2 ) ), 30 ) );
+
+	s = _mm_xor_ps( _mm_or_ps( _mm_and_ps( swap, pc ), _mm_andnot_ps( swap, ps ) ), signS );
+	c = _mm_xor_ps( _mm_or_ps( _mm_and_ps( swap, ps ), _mm_andnot_ps( swap, pc ) ), signC );
+}
+
+#endif
+
+} // namespace
+
+InstanceAnimator::InstanceAnimator()
+    : mMultithreaded( true )
+    , mSimd( true )
+{
+}
+
+void InstanceAnimator::setup( int size, float spacing, uint32_t seed )
+{
+	const size_t count = size_t( size ) * size * size;
+	for( auto *v : { &mPositionX, &mPositionY, &mPositionZ, &mAxisX, &mAxisY, &mAxisZ, &mAngle, &mSpeed } ) {
+		v->clear();
+		v->reserve( count );
+	}
+
+	// Draw the random numbers in the same order as the sample always has, so the animation looks the same.
+	Rand rnd( seed );
+
+	const int half = size / 2;
+	for( int z = -half; z < size - half; z++ ) {
+		for( int y = -half; y < size - half; y++ ) {
+			for( int x = -half; x < size - half; x++ ) {
+				const vec3  position = vec3( x, y, z ) * spacing + rnd.nextVec3();
+				const vec3  axis = glm::normalize( rnd.nextVec3() );
+				const float angle = rnd.nextFloat( -180.0f, 180.0f );
+				const float speed = rnd.nextFloat( 1.0f, 90.0f );
+
+				mPositionX.push_back( position.x );
+				mPositionY.push_back( position.y );
+				mPositionZ.push_back( position.z );
+				mAxisX.push_back( axis.x );
+				mAxisY.push_back( axis.y );
+				mAxisZ.push_back( axis.z );
+				mAngle.push_back( glm::radians( angle ) );
+				mSpeed.push_back( glm::radians( speed ) );
+			}
+		}
+	}
+}
+
+void InstanceAnimator::evaluate( double time, ci::mat4 *dst ) const
+{
+	const size_t count = getCount();
+
+	// every instance can be evaluated independently, so split them into one range per thread
+	if( !mMultithreaded || count < 4096 ) {
+		evaluateRange( 0, count, float( time ), dst );
+	}
+	else {
+		// ranges are a multiple of 4 instances, so they can be fully vectorized
+		ph::TaskScheduler::getInstance().parallelFor( 0, count, [this, time, dst]( size_t begin, size_t end ) { evaluateRange( begin, end, float( time ), dst ); }, 4 );
+	}
+}
+
+void InstanceAnimator::evaluateRange( size_t begin, size_t end, float time, ci::mat4 *dst ) const
+{
+	// Same as glm::translate( position ) * glm::rotate( angle + speed * time, axis ).
+	size_t i = begin;
+
+#if defined( INSTANCE_ANIMATOR_SSE2 )
+	if( mSimd ) {
+		const __m128 t = _mm_set1_ps( time );
+		const __m128 one = _mm_set1_ps( 1.0f );
+		const __m128 zero = _mm_setzero_ps();
+
+		for( ; i + 4 <= end; i += 4 ) {
+			const __m128 ax = _mm_loadu_ps( &mAxisX[i] );
+			const __m128 ay = _mm_loadu_ps( &mAxisY[i] );
+			const __m128 az = _mm_loadu_ps( &mAxisZ[i] );
+
+			__m128 s, c;
+			sincos( _mm_add_ps( _mm_loadu_ps( &mAngle[i] ), _mm_mul_ps( _mm_loadu_ps( &mSpeed[i] ), t ) ), s, c );
+
+			const __m128 k = _mm_sub_ps( one, c );
+			const __m128 kx = _mm_mul_ps( k, ax );
+			const __m128 ky = _mm_mul_ps( k, ay );
+			const __m128 kz = _mm_mul_ps( k, az );
+			const __m128 sx = _mm_mul_ps( s, ax );
+			const __m128 sy = _mm_mul_ps( s, ay );
+			const __m128 sz = _mm_mul_ps( s, az );
+
+			// each register holds one element for four instances, transpose them into columns
+			__m128 c0x = _mm_add_ps( c, _mm_mul_ps( kx, ax ) );
+			__m128 c0y = _mm_add_ps( _mm_mul_ps( kx, ay ), sz );
+			__m128 c0z = _mm_sub_ps( _mm_mul_ps( kx, az ), sy );
+			__m128 c0w = zero;
+			_MM_TRANSPOSE4_PS( c0x, c0y, c0z, c0w );
+
+			__m128 c1x = _mm_sub_ps( _mm_mul_ps( ky, ax ), sz );
+			__m128 c1y = _mm_add_ps( c, _mm_mul_ps( ky, ay ) );
+			__m128 c1z = _mm_add_ps( _mm_mul_ps( ky, az ), sx );
+			__m128 c1w = zero;
+			_MM_TRANSPOSE4_PS( c1x, c1y, c1z, c1w );
+
+			__m128 c2x = _mm_add_ps( _mm_mul_ps( kz, ax ), sy );
+			__m128 c2y = _mm_sub_ps( _mm_mul_ps( kz, ay ), sx );
+			__m128 c2z = _mm_add_ps( c, _mm_mul_ps( kz, az ) );
+			__m128 c2w = zero;
+			_MM_TRANSPOSE4_PS( c2x, c2y, c2z, c2w );
+
+			__m128 c3x = _mm_loadu_ps( &mPositionX[i] );
+			__m128 c3y = _mm_loadu_ps( &mPositionY[i] );
+			__m128 c3z = _mm_loadu_ps( &mPositionZ[i] );
+			__m128 c3w = one;
+			_MM_TRANSPOSE4_PS( c3x, c3y, c3z, c3w );
+
+			const __m128 columns[4][4] = { { c0x, c1x, c2x, c3x }, { c0y, c1y, c2y, c3y }, { c0z, c1z, c2z, c3z }, { c0w, c1w, c2w, c3w } };
+			for( int n = 0; n < 4; ++n ) {
+				float *m = &dst[i + n][0][0];
+				for( int col = 0; col < 4; ++col )
+					_mm_storeu_ps( m + 4 * col, columns[n][col] );
+			}
+		}
+	}
+#endif
+
+	for( ; i < end; ++i ) {
+		const float ax = mAxisX[i];
+		const float ay = mAxisY[i];
+		const float az = mAxisZ[i];
+
+		float s, c;
+		sincos( mAngle[i] + mSpeed[i] * time, s, c );
+
+		const float kx = ( 1.0f - c ) * ax;
+		const float ky = ( 1.0f - c ) * ay;
+		const float kz = ( 1.0f - c ) * az;
+
+		mat4 &m = dst[i];
+		m[0] = vec4( c + kx * ax, kx * ay + s * az, kx * az - s * ay, 0.0f );
+		m[1] = vec4( ky * ax - s * az, c + ky * ay, ky * az + s * ax, 0.0f );
+		m[2] = vec4( kz * ax + s * ay, kz * ay - s * ax, c + kz * az, 0.0f );
+		m[3] = vec4( mPositionX[i], mPositionY[i], mPositionZ[i], 1.0f );
+	}
+}
@@ -0,0 +1,355 @@
+// Animates the DepthOfField teapots without a window and reports the timings as JSON, so that
+// the different ways of calculating the model matrices can be compared. It also measures how long
+// it takes to find the teapot under the cursor, with and without a bounding volume hierarchy. Usage:
+//
+//   InstanceBenchmark [--sizes 9,22,46] [--frames 600] [--rays 1000] [--out results.json]
+//
+// A size of 9 animates 9 x 9 x 9 = 729 teapots, like the sample does.
+
+#include "BoundingVolumeHierarchy.h"
+#include "InstanceAnimator.h"
+#include "TaskScheduler.h"
+
+#include "cinder/AxisAlignedBox.h"
+#include "cinder/CinderMath.h"
+#include "cinder/Rand.h"
+#include "cinder/Ray.h"
+
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+enum Method { REFERENCE, SCALAR, SIMD, MULTITHREADED, NUM_METHODS };
+
+const char *kMethodNames[NUM_METHODS] = { "reference", "scalar", "simd", "multithreaded" };
+
+struct Run {
+	int    size;
+	size_t count;
+	Method method;
+	double seconds;
+	double minFrameSeconds;
+	double maxFrameSeconds;
+	float  maxError;
+};
+
+struct PickingRun {
+	int    size;
+	size_t count;
+	size_t numNodes;
+	size_t numRays;
+	double buildSeconds;
+	double refitSeconds;
+	double linearSeconds;
+	double hierarchySeconds;
+	size_t hits;
+	size_t mismatches;
+};
+
+//! Roughly the bounding box of the teapot in the sample.
+const AxisAlignedBox kTeapotBounds( vec3( -1.5f, -0.5f, -1.0f ), vec3( 1.7f, 1.1f, 1.0f ) );
+
+vector<int> parseSizes( const string &str )
+{
+	vector<int> sizes;
+
+	stringstream ss( str );
+	string       item;
+	while( getline( ss, item, ',' ) ) {
+		if( !item.empty() )
+			sizes.push_back( atoi( item.c_str() ) );
+	}
+
+	return sizes;
+}
+
+//! The way the sample used to animate its teapots: regenerate all random parameters every frame.
+void animateReference( int size, double time, mat4 *dst )
+{
+	Rand::randSeed( 12345 );
+
+	const int half = size / 2;
+	for( int z = -half; z < size - half; z++ ) {
+		for( int y = -half; y < size - half; y++ ) {
+			for( int x = -half; x < size - half; x++ ) {
+				vec3  position = vec3( x, y, z ) * 5.0f + Rand::randVec3();
+				vec3  axis = Rand::randVec3();
+				float angle = Rand::randFloat( -180.0f, 180.0f ) + Rand::randFloat( 1.0f, 90.0f ) * float( time );
+
+				mat4 transform = glm::translate( position );
+				transform *= glm::rotate( glm::radians( angle ), axis );
+
+				( *dst++ ) = transform;
+			}
+		}
+	}
+}
+
+Run runMethod( int size, Method method, size_t frames )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	InstanceAnimator animator;
+	animator.setup( size, 5.0f, 12345 );
+	animator.setSimd( method != SCALAR );
+	animator.setMultithreaded( method == MULTITHREADED );
+
+	vector<mat4> matrices( animator.getCount() );
+	vector<mat4> expected( animator.getCount() );
+
+	Run run;
+	run.size = size;
+	run.count = animator.getCount();
+	run.method = method;
+	run.seconds = 0.0;
+	run.minFrameSeconds = 1.0e30;
+	run.maxFrameSeconds = 0.0;
+	run.maxError = 0.0f;
+
+	for( size_t i = 0; i < frames; ++i ) {
+		const double time = i / 60.0;
+
+		const auto start = Clock::now();
+		if( method == REFERENCE )
+			animateReference( size, time, matrices.data() );
+		else
+			animator.evaluate( time, matrices.data() );
+		const double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+		run.seconds += seconds;
+		run.minFrameSeconds = math<double>::min( run.minFrameSeconds, seconds );
+		run.maxFrameSeconds = math<double>::max( run.maxFrameSeconds, seconds );
+
+		// compare a few frames against the reference
+		if( method != REFERENCE && i % 60 == 0 ) {
+			animateReference( size, time, expected.data() );
+			for( size_t j = 0; j < matrices.size(); ++j ) {
+				for( int col = 0; col < 4; ++col )
+					for( int row = 0; row < 4; ++row )
+						run.maxError = math<float>::max( run.maxError, math<float>::abs( matrices[j][col][row] - expected[j][col][row] ) );
+			}
+		}
+	}
+
+	return run;
+}
+
+//! Same test as DepthOfFieldApp::intersectTeapot().
+bool intersectTeapot( const Ray &ray, const mat4 &transform, float &distance )
+{
+	const mat4 inverse = glm::inverse( transform );
+	const Ray  local( vec3( inverse * vec4( ray.getOrigin(), 1 ) ), vec3( inverse * vec4( ray.getDirection(), 0 ) ) );
+
+	float min, max;
+	if( kTeapotBounds.intersect( local, &min, &max ) > 0 && min < distance ) {
+		distance = min;
+		return true;
+	}
+
+	return false;
+}
+
+//! Animates the teapots to the given \a time and calculates their bounding boxes.
+void animateBounds( const InstanceAnimator &animator, double time, vector<mat4> &matrices, ph::BoundingBoxes &boxes )
+{
+	animator.evaluate( time, matrices.data() );
+
+	boxes.clear();
+	boxes.reserve( matrices.size() );
+	for( const auto &transform : matrices )
+		boxes.push_back( transform, kTeapotBounds );
+}
+
+PickingRun runPicking( int size, size_t numRays )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	InstanceAnimator animator;
+	animator.setup( size, 5.0f, 12345 );
+
+	vector<mat4> matrices( animator.getCount() );
+
+	ph::BoundingBoxes boxes;
+
+	PickingRun run;
+	run.size = size;
+	run.count = animator.getCount();
+	run.numRays = numRays;
+	run.hits = 0;
+	run.mismatches = 0;
+
+	// build the hierarchy once, then refit it to the bounds at a later time, like the sample does
+	animateBounds( animator, 0.0, matrices, boxes );
+
+	ph::BoundingVolumeHierarchy hierarchy;
+
+	auto start = Clock::now();
+	hierarchy.build( boxes );
+	run.buildSeconds = std::chrono::duration<double>( Clock::now() - start ).count();
+	run.numNodes = hierarchy.getNumNodes();
+
+	animateBounds( animator, 10.0, matrices, boxes );
+
+	start = Clock::now();
+	hierarchy.refit( boxes );
+	run.refitSeconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+	// cast rays from random points around the grid towards random points inside it
+	const float extent = 2.5f * size;
+
+	vector<Ray> rays;
+	Rand        rnd( 54321 );
+	for( size_t i = 0; i < numRays; ++i ) {
+		const vec3 origin = 2.0f * extent * rnd.nextVec3();
+		const vec3 target = vec3( rnd.nextFloat( -extent, extent ), rnd.nextFloat( -extent, extent ), rnd.nextFloat( -extent, extent ) );
+		rays.push_back( Ray( origin, glm::normalize( target - origin ) ) );
+	}
+
+	vector<int>   linearHits( numRays, -1 );
+	vector<float> linearDistances( numRays, 0.0f );
+
+	start = Clock::now();
+	for( size_t i = 0; i < numRays; ++i ) {
+		float distance = FLT_MAX;
+		for( size_t j = 0; j < matrices.size(); ++j ) {
+			if( intersectTeapot( rays[i], matrices[j], distance ) )
+				linearHits[i] = int( j );
+		}
+		linearDistances[i] = distance;
+	}
+	run.linearSeconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+	vector<int>   hierarchyHits( numRays, -1 );
+	vector<float> hierarchyDistances( numRays, 0.0f );
+
+	start = Clock::now();
+	for( size_t i = 0; i < numRays; ++i ) {
+		hierarchyHits[i] = hierarchy.raycast( rays[i], [&]( uint32_t index, float &nearest ) { return intersectTeapot( rays[i], matrices[index], nearest ); }, &hierarchyDistances[i] );
+	}
+	run.hierarchySeconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+	// both should find the same teapots at the same distances
+	for( size_t i = 0; i < numRays; ++i ) {
+		if( linearHits[i] >= 0 )
+			run.hits++;
+		if( linearHits[i] != hierarchyHits[i] || ( linearHits[i] >= 0 && linearDistances[i] != hierarchyDistances[i] ) )
+			run.mismatches++;
+	}
+
+	return run;
+}
+
+void writeJson( ostream &out, size_t frames, const vector<Run> &runs, const vector<PickingRun> &pickingRuns )
+{
+	out << "{" << endl;
+	out << "  \"frames\": " << frames << "," << endl;
+	out << "  \"runs\": [" << endl;
+
+	for( size_t i = 0; i < runs.size(); ++i ) {
+		const Run &run = runs[i];
+
+		out << "    {" << endl;
+		out << "      \"size\": " << run.size << "," << endl;
+		out << "      \"instances\": " << run.count << "," << endl;
+		out << "      \"method\": \"" << kMethodNames[run.method] << "\"," << endl;
+		out << "      \"seconds\": " << run.seconds << "," << endl;
+		out << "      \"msPerFrame\": { \"mean\": " << 1000.0 * run.seconds / frames << ", \"min\": " << 1000.0 * run.minFrameSeconds
+		    << ", \"max\": " << 1000.0 * run.maxFrameSeconds << " }," << endl;
+		out << "      \"maxError\": " << run.maxError << endl;
+		out << "    }" << ( i + 1 < runs.size() ? "," : "" ) << endl;
+	}
+
+	out << "  ]," << endl;
+	out << "  \"picking\": [" << endl;
+
+	for( size_t i = 0; i < pickingRuns.size(); ++i ) {
+		const PickingRun &run = pickingRuns[i];
+
+		out << "    {" << endl;
+		out << "      \"size\": " << run.size << "," << endl;
+		out << "      \"instances\": " << run.count << "," << endl;
+		out << "      \"nodes\": " << run.numNodes << "," << endl;
+		out << "      \"rays\": " << run.numRays << "," << endl;
+		out << "      \"buildMs\": " << 1000.0 * run.buildSeconds << "," << endl;
+		out << "      \"refitMs\": " << 1000.0 * run.refitSeconds << "," << endl;
+		out << "      \"usPerRay\": { \"linear\": " << 1.0e6 * run.linearSeconds / run.numRays << ", \"hierarchy\": " << 1.0e6 * run.hierarchySeconds / run.numRays << " }," << endl;
+		out << "      \"hits\": " << run.hits << "," << endl;
+		out << "      \"mismatches\": " << run.mismatches << endl;
+		out << "    }" << ( i + 1 < pickingRuns.size() ? "," : "" ) << endl;
+	}
+
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
+
+} // namespace
+
+int main( int argc, char *argv[] )
+{
+	vector<int> sizes = { 9, 22, 46 };
+	size_t      frames = 600;
+	size_t      rays = 1000;
+	string      path;
+
+	for( int i = 1; i + 1 < argc; i += 2 ) {
+		const string arg( argv[i] );
+		const string value( argv[i + 1] );
+
+		if( arg == "--sizes" )
+			sizes = parseSizes( value );
+		else if( arg == "--frames" )
+			frames = size_t( strtoull( value.c_str(), nullptr, 10 ) );
+		else if( arg == "--rays" )
+			rays = size_t( strtoull( value.c_str(), nullptr, 10 ) );
+		else if( arg == "--out" )
+			path = value;
+		else {
+			cerr << "Unknown argument: " << arg << endl;
+			return 1;
+		}
+	}
+
+	if( sizes.empty() || frames == 0 || rays == 0 ) {
+		cerr << "Usage: " << argv[0] << " [--sizes 9,22,46] [--frames 600] [--rays 1000] [--out results.json]" << endl;
+		return 1;
+	}
+
+	vector<Run>        runs;
+	vector<PickingRun> pickingRuns;
+	for( int size : sizes ) {
+		for( int method = 0; method < NUM_METHODS; ++method )
+			runs.push_back( runMethod( size, Method( method ), frames ) );
+
+		pickingRuns.push_back( runPicking( size, rays ) );
+
+		cerr << "Finished " << size * size * size << " instances." << endl;
+	}
+
+	// stop the worker threads used by the animator
+	ph::TaskScheduler::getInstance().shutdown();
+
+	if( path.empty() ) {
+		writeJson( cout, frames, runs, pickingRuns );
+	}
+	else {
+		ofstream file( path.c_str() );
+		if( !file ) {
+			cerr << "Could not write to " << path << endl;
+			return 1;
+		}
+
+		writeJson( file, frames, runs, pickingRuns );
+	}
+
+	return 0;
+}
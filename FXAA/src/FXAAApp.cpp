@@ -179,6 +179,16 @@ void FXAAApp::keyDown( KeyEvent event )
 		else
 			gl::enableVerticalSync( true );
 		break;
+	case KeyEvent::KEY_g:
+		mPistons.cycleGridSize();
+		console() << "Pistons: " << mPistons.getCount() << std::endl;
+		break;
+	case KeyEvent::KEY_s:
+		mPistons.toggleSortMode();
+		break;
+	case KeyEvent::KEY_t:
+		mPistons.printTimings();
+		break;
 	}
 }
 
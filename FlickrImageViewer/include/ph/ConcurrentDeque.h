@@ -25,7 +25,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <mutex>
 
 namespace ph {
 
@@ -115,7 +119,7 @@ class ConcurrentDeque {
 			return false;
 		}
 
-		popped_value = mDeque.front();
+		popped_value = std::move( mDeque.front() );
 		mDeque.pop_front();
 		return true;
 	}
@@ -129,7 +133,7 @@ class ConcurrentDeque {
 		if( mInvalidated )
 			return false;
 
-		popped_value = mDeque.front();
+		popped_value = std::move( mDeque.front() );
 		mDeque.pop_front();
 
 		return true;
@@ -137,7 +141,12 @@ class ConcurrentDeque {
 
 	void invalidate()
 	{
-		mInvalidated = true;
+		{
+			// set the flag while holding the lock, so a thread that is about to wait can't miss it
+			std::lock_guard<std::mutex> lock( mMutex );
+			mInvalidated = true;
+		}
+
 		mCondition.notify_all();
 	}
 
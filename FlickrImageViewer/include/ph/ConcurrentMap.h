@@ -18,115 +18,351 @@
  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  POSSIBILITY OF SUCH DAMAGE.
-
- Based on the excellent article by Anthony Williams:
- http://www.justsoftwaresolutions.co.uk/threading/implementing-a-thread-safe-queue-using-condition-variables.html
 */
 
 #pragma once
 
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace ph {
 
-template <typename Key, typename Data>
+//! Thread-safe hash map, split into a number of shards that each have their own lock. Threads that access
+//! different keys rarely block each other. Values can be moved out of the map, and threads can wait for a
+//! specific key to be inserted: only the threads waiting for that key are woken up.
+template <typename Key, typename Data, typename Hash = std::hash<Key>>
 class ConcurrentMap {
   public:
-	ConcurrentMap( void )
-	    : mInvalidated( false ){};
+	struct Stats {
+		Stats( void )
+		    : locks( 0 )
+		    , contended( 0 ){};
+
+		//! number of times a shard was locked
+		size_t locks;
+		//! number of times a thread had to wait for a shard that was locked by another thread
+		size_t contended;
+	};
+
+	//! creates a map with at least \a numShards shards. The number is rounded up to a power of two.
+	explicit ConcurrentMap( size_t numShards = 16 )
+	    : mInvalidated( false )
+	{
+		size_t size = 1;
+		while( size < numShards )
+			size <<= 1;
+
+		mMask = size - 1;
+		mShards.reset( new Shard[size] );
+	}
+
 	~ConcurrentMap( void ){};
 
+	ConcurrentMap( const ConcurrentMap & ) = delete;
+	ConcurrentMap &operator=( const ConcurrentMap & ) = delete;
+
 	void clear()
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
-		mQueue.clear();
+		for( size_t i = 0; i <= mMask; ++i ) {
+			Lock lock = acquire( mShards[i] );
+			mShards[i].map.clear();
+		}
 	}
 
-	bool contains( Key const &key )
+	bool contains( Key const &key ) const
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
-
-		typename std::map<Key, Data>::iterator itr = mQueue.find( key );
-		return ( itr != mQueue.end() );
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
+		return shard.map.find( key ) != shard.map.end();
 	}
 
 	bool erase( Key const &key )
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
+		return shard.map.erase( key ) > 0;
+	}
+
+	//! removes the value for \a key if \a predicate( value ) returns TRUE
+	template <typename Predicate>
+	bool erase_if( Key const &key, Predicate predicate )
+	{
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
 
-		size_t n = mQueue.erase( key );
+		auto itr = shard.map.find( key );
+		if( itr == shard.map.end() || !predicate( itr->second ) )
+			return false;
 
-		return ( n > 0 );
+		shard.map.erase( itr );
+		return true;
 	}
 
-	void push( Key const &key, Data const &data )
+	//! inserts or replaces the value for \a key, and wakes up the threads waiting for it
+	void push( Key const &key, Data data )
 	{
-		std::unique_lock<std::mutex> lock( mMutex );
-		mQueue[key] = data;
-		lock.unlock();
-		mCondition.notify_one();
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
+
+		shard.map[key] = std::move( data );
+		notify( shard, key, lock );
 	}
 
-	bool empty() const
+	//! inserts the value for \a key, unless the key is already present. Returns TRUE if the value was inserted.
+	bool try_push( Key const &key, Data data )
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
-		return mQueue.empty();
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
+
+		if( !shard.map.emplace( key, std::move( data ) ).second )
+			return false;
+
+		notify( shard, key, lock );
+		return true;
 	}
 
-	bool get( Key const &key, Data &popped_value )
+	bool empty() const { return size() == 0; }
+
+	//! returns the number of values. Only an estimate if other threads are modifying the map.
+	size_t size() const
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
+		size_t result = 0;
+		for( size_t i = 0; i <= mMask; ++i ) {
+			Lock lock = acquire( mShards[i] );
+			result += mShards[i].map.size();
+		}
 
-		typename std::map<Key, Data>::iterator itr = mQueue.find( key );
-		if( itr == mQueue.end() )
-			return false;
+		return result;
+	}
+
+	//! copies the value for \a key
+	bool get( Key const &key, Data &value ) const
+	{
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
 
-		popped_value = mQueue[key];
+		auto itr = shard.map.find( key );
+		if( itr == shard.map.end() )
+			return false;
 
+		value = itr->second;
 		return true;
 	}
 
-	bool try_pop( Key const &key, Data &popped_value )
+	//! calls \a visitor( value ) for the value for \a key while its shard is locked, which avoids copying it.
+	//! Returns FALSE if the key was not found.
+	template <typename Visitor>
+	bool visit( Key const &key, Visitor visitor )
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
 
-		typename std::map<Key, Data>::iterator itr = mQueue.find( key );
-		if( itr == mQueue.end() || mInvalidated )
+		auto itr = shard.map.find( key );
+		if( itr == shard.map.end() )
 			return false;
 
-		popped_value = mQueue[key];
-		mQueue.erase( key );
-
+		visitor( itr->second );
 		return true;
 	}
 
-	bool wait_and_pop( Key const &key, Data &popped_value )
+	//! moves the value for \a key out of the map. Returns FALSE if not found or if the map has been invalidated.
+	bool try_take( Key const &key, Data &value )
+	{
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
+
+		return !mInvalidated && take( shard, key, value );
+	}
+
+	//! waits until a value for \a key is available and moves it out of the map. Returns FALSE if the map has been invalidated.
+	bool wait_take( Key const &key, Data &value )
 	{
-		std::lock_guard<std::mutex>            lock( mMutex );
-		typename std::map<Key, Data>::iterator itr;
-		while( mQueue.find( key ) == mQueue.end() && !mInvalidated ) {
-			mCondition.wait( lock );
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
+
+		bool      taken = false;
+		WaiterRef waiter;
+		while( !mInvalidated && !( taken = take( shard, key, value ) ) ) {
+			if( !waiter )
+				waiter = addWaiter( shard, key );
+
+			waiter->condition.wait( lock );
 		}
-		if( mInvalidated )
-			return false;
 
-		popped_value = mQueue[key];
-		mQueue.erase( key );
+		if( waiter )
+			removeWaiter( shard, key );
 
-		return true;
+		return taken;
 	}
 
+	//! waits at most \a timeout until a value for \a key is available and moves it out of the map.
+	//! Returns FALSE if the value is not available or if the map has been invalidated.
+	template <typename Rep, typename Period>
+	bool wait_take( Key const &key, Data &value, const std::chrono::duration<Rep, Period> &timeout )
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+		Shard &shard = getShard( key );
+		Lock   lock = acquire( shard );
+
+		bool      taken = false;
+		WaiterRef waiter;
+		while( !mInvalidated && !( taken = take( shard, key, value ) ) ) {
+			if( !waiter )
+				waiter = addWaiter( shard, key );
+
+			if( waiter->condition.wait_until( lock, deadline ) == std::cv_status::timeout ) {
+				taken = !mInvalidated && take( shard, key, value );
+				break;
+			}
+		}
+
+		if( waiter )
+			removeWaiter( shard, key );
+
+		return taken;
+	}
+
+	//! wakes up all waiting threads and makes all take functions return FALSE, so worker threads can terminate
 	void invalidate()
 	{
 		mInvalidated = true;
-		mCondition.notify_all();
+
+		for( size_t i = 0; i <= mMask; ++i ) {
+			Lock lock = acquire( mShards[i] );
+			for( auto &waiter : mShards[i].waiters )
+				waiter.second->condition.notify_all();
+		}
+	}
+
+	//! returns the number of lock acquisitions and how many of them were contended, summed over all shards
+	Stats getStats() const
+	{
+		Stats stats;
+		for( size_t i = 0; i <= mMask; ++i ) {
+			stats.locks += mShards[i].locks.load( std::memory_order_relaxed );
+			stats.contended += mShards[i].contended.load( std::memory_order_relaxed );
+		}
+
+		return stats;
+	}
+
+	void resetStats()
+	{
+		for( size_t i = 0; i <= mMask; ++i ) {
+			mShards[i].locks = 0;
+			mShards[i].contended = 0;
+		}
+	}
+
+  private:
+	typedef std::unique_lock<std::mutex> Lock;
+
+	//! threads waiting for the same key share a condition variable
+	struct Waiter {
+		Waiter( void )
+		    : count( 0 ){};
+
+		std::condition_variable condition;
+		size_t                  count;
+	};
+	typedef std::shared_ptr<Waiter> WaiterRef;
+
+	struct Shard {
+		Shard( void )
+		    : locks( 0 )
+		    , contended( 0 ){};
+
+		std::mutex                               mutex;
+		std::unordered_map<Key, Data, Hash>      map;
+		std::unordered_map<Key, WaiterRef, Hash> waiters;
+		std::atomic<size_t>                      locks;
+		std::atomic<size_t>                      contended;
+
+		// keep shards on separate cache lines, so threads using different shards don't slow each other down
+		char padding[64];
+	};
+
+	Shard &getShard( Key const &key ) const
+	{
+		// mix the bits, because std::hash is the identity function for integers on some platforms
+		size_t hash = Hash()( key );
+		hash ^= hash >> 16;
+		hash *= 0x45d9f3b;
+		hash ^= hash >> 16;
+
+		return mShards[hash & mMask];
+	}
+
+	//! locks the shard, keeping track of contention
+	static Lock acquire( Shard &shard )
+	{
+		Lock lock( shard.mutex, std::try_to_lock );
+		if( !lock.owns_lock() ) {
+			shard.contended.fetch_add( 1, std::memory_order_relaxed );
+			lock.lock();
+		}
+
+		shard.locks.fetch_add( 1, std::memory_order_relaxed );
+		return lock;
+	}
+
+	//! moves the value out of the map with a single lookup. Must be called with the shard locked.
+	static bool take( Shard &shard, Key const &key, Data &value )
+	{
+		auto itr = shard.map.find( key );
+		if( itr == shard.map.end() )
+			return false;
+
+		value = std::move( itr->second );
+		shard.map.erase( itr );
+
+		return true;
+	}
+
+	//! wakes up the threads waiting for \a key, after unlocking the shard. Must be called with the shard locked.
+	static void notify( Shard &shard, Key const &key, Lock &lock )
+	{
+		auto itr = shard.waiters.find( key );
+		if( itr == shard.waiters.end() )
+			return;
+
+		WaiterRef waiter = itr->second;
+		lock.unlock();
+
+		waiter->condition.notify_all();
+	}
+
+	//! must be called with the shard locked
+	static WaiterRef addWaiter( Shard &shard, Key const &key )
+	{
+		WaiterRef &waiter = shard.waiters[key];
+		if( !waiter )
+			waiter = std::make_shared<Waiter>();
+
+		waiter->count++;
+		return waiter;
+	}
+
+	//! must be called with the shard locked
+	static void removeWaiter( Shard &shard, Key const &key )
+	{
+		auto itr = shard.waiters.find( key );
+		if( itr != shard.waiters.end() && --itr->second->count == 0 )
+			shard.waiters.erase( itr );
 	}
 
   private:
-	std::map<Key, Data>     mQueue;
-	mutable std::mutex      mMutex;
-	std::condition_variable mCondition;
-	std::atomic<bool>       mInvalidated;
+	std::unique_ptr<Shard[]> mShards;
+	size_t                   mMask;
+	std::atomic<bool>        mInvalidated;
 };
 
 } // namespace ph
@@ -0,0 +1,240 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+ Based on the excellent article by Anthony Williams:
+ http://www.justsoftwaresolutions.co.uk/threading/implementing-a-thread-safe-queue-using-condition-variables.html
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace ph {
+
+//! Thread-safe priority queue of unique keys. Keys with a higher priority are popped first, keys with equal priority
+//! in the order they were pushed. Pushing a key that is already queued changes its priority instead of adding it twice.
+//! Lookups, reprioritization and removal are O(1) on average: the heap may contain outdated entries, which are skipped
+//! when popped and purged when they start to outnumber the valid ones.
+template <typename Key, typename Priority = float, typename Hash = std::hash<Key>>
+class ConcurrentPriorityQueue {
+  public:
+	ConcurrentPriorityQueue( void )
+	    : mSequence( 0 )
+	    , mInvalidated( false ){};
+	~ConcurrentPriorityQueue( void ){};
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mEntries.clear();
+		mHeap = Heap();
+	}
+
+	bool contains( Key const &key ) const
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		return mEntries.find( key ) != mEntries.end();
+	}
+
+	//! adds the key to the queue and returns TRUE, or changes its priority and returns FALSE if it was already queued
+	bool push( Key const &key, Priority priority = Priority() )
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		auto itr = mEntries.find( key );
+		if( itr != mEntries.end() ) {
+			if( itr->second.priority != priority ) {
+				itr->second.priority = priority;
+				itr->second.sequence = mSequence++;
+				mHeap.push( Item( priority, itr->second.sequence, key ) );
+				compact();
+			}
+
+			return false;
+		}
+
+		const Entry entry = { priority, mSequence++ };
+		mEntries[key] = entry;
+		mHeap.push( Item( priority, entry.sequence, key ) );
+
+		lock.unlock();
+		mCondition.notify_one();
+
+		return true;
+	}
+
+	//! changes the priority of a queued key, returns FALSE if the key is not queued
+	bool reprioritize( Key const &key, Priority priority )
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+
+		auto itr = mEntries.find( key );
+		if( itr == mEntries.end() )
+			return false;
+
+		if( itr->second.priority != priority ) {
+			itr->second.priority = priority;
+			itr->second.sequence = mSequence++;
+			mHeap.push( Item( priority, itr->second.sequence, key ) );
+			compact();
+		}
+
+		return true;
+	}
+
+	//! removes the key from the queue, returns TRUE if it was queued
+	bool erase( Key const &key )
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+
+		if( mEntries.erase( key ) == 0 )
+			return false;
+
+		compact();
+		return true;
+	}
+
+	bool empty() const
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		return mEntries.empty();
+	}
+
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		return mEntries.size();
+	}
+
+	bool try_pop( Key &popped_value )
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( mInvalidated )
+			return false;
+
+		return pop( popped_value );
+	}
+
+	bool wait_and_pop( Key &popped_value )
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		while( mEntries.empty() && !mInvalidated ) {
+			mCondition.wait( lock );
+		}
+		if( mInvalidated )
+			return false;
+
+		return pop( popped_value );
+	}
+
+	void invalidate()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mInvalidated = true;
+		}
+		mCondition.notify_all();
+	}
+
+  private:
+	struct Entry {
+		Priority priority;
+		size_t   sequence;
+	};
+
+	struct Item {
+		Item( Priority priority, size_t sequence, Key const &key )
+		    : priority( priority )
+		    , sequence( sequence )
+		    , key( key ){};
+
+		//! std::priority_queue pops the largest item: highest priority first, then lowest sequence
+		bool operator<( const Item &rhs ) const
+		{
+			if( priority != rhs.priority )
+				return priority < rhs.priority;
+			return sequence > rhs.sequence;
+		}
+
+		Priority priority;
+		size_t   sequence;
+		Key      key;
+	};
+
+	typedef std::priority_queue<Item> Heap;
+
+	//! an item is outdated if its key has been removed or reprioritized since it was pushed
+	bool isValid( const Item &item ) const
+	{
+		auto itr = mEntries.find( item.key );
+		return itr != mEntries.end() && itr->second.sequence == item.sequence;
+	}
+
+	bool pop( Key &popped_value )
+	{
+		while( !mHeap.empty() ) {
+			const Item &item = mHeap.top();
+			if( isValid( item ) ) {
+				popped_value = item.key;
+				mEntries.erase( item.key );
+				mHeap.pop();
+				return true;
+			}
+
+			mHeap.pop();
+		}
+
+		return false;
+	}
+
+	//! rebuilds the heap once outdated items outnumber the valid ones, so it can't grow indefinitely
+	void compact()
+	{
+		if( mHeap.size() < 64 || mHeap.size() < 2 * mEntries.size() )
+			return;
+
+		std::vector<Item> items;
+		items.reserve( mEntries.size() );
+		while( !mHeap.empty() ) {
+			if( isValid( mHeap.top() ) )
+				items.push_back( mHeap.top() );
+			mHeap.pop();
+		}
+
+		mHeap = Heap( std::less<Item>(), std::move( items ) );
+	}
+
+  private:
+	std::unordered_map<Key, Entry, Hash> mEntries;
+	Heap                                 mHeap;
+	size_t                               mSequence;
+
+	mutable std::mutex      mMutex;
+	std::condition_variable mCondition;
+	bool                    mInvalidated;
+};
+
+} // namespace ph
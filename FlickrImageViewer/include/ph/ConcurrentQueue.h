@@ -25,10 +25,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <queue>
 
 namespace ph {
 
+//! Unbounded, mutex-based thread-safe queue. For bounded queues with many producers and consumers, use ConcurrentRing.
 template <typename Data>
 class ConcurrentQueue {
   public:
@@ -38,12 +42,20 @@ class ConcurrentQueue {
 
 	void push( Data const &data )
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
+		std::unique_lock<std::mutex> lock( mMutex );
 		mQueue.push( data );
 		lock.unlock();
 		mCondition.notify_one();
 	}
 
+	void push( Data &&data )
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		mQueue.push( std::move( data ) );
+		lock.unlock();
+		mCondition.notify_one();
+	}
+
 	bool empty() const
 	{
 		std::lock_guard<std::mutex> lock( mMutex );
@@ -57,21 +69,21 @@ class ConcurrentQueue {
 			return false;
 		}
 
-		popped_value = mQueue.front();
+		popped_value = std::move( mQueue.front() );
 		mQueue.pop();
 		return true;
 	}
 
 	bool wait_and_pop( Data &popped_value )
 	{
-		std::lock_guard<std::mutex> lock( mMutex );
+		std::unique_lock<std::mutex> lock( mMutex );
 		while( mQueue.empty() && !mInvalidated ) {
 			mCondition.wait( lock );
 		}
 		if( mInvalidated )
 			return false;
 
-		popped_value = mQueue.front();
+		popped_value = std::move( mQueue.front() );
 		mQueue.pop();
 
 		return true;
@@ -79,8 +91,13 @@ class ConcurrentQueue {
 
 	void invalidate()
 	{
-		mInvalidated = true;
-		mCondition.notify();
+		{
+			// set the flag while holding the lock, so a thread that is about to wait can't miss it
+			std::lock_guard<std::mutex> lock( mMutex );
+			mInvalidated = true;
+		}
+
+		mCondition.notify_all();
 	}
 
   private:
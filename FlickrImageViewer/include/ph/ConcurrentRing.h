@@ -0,0 +1,330 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+    the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+    the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+ Based on the bounded MPMC queue by Dmitry Vyukov:
+ http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ph {
+
+//! Bounded, lock-free multi-producer multi-consumer queue. Items are moved in and out of a ring buffer of
+//! preallocated cells, so pushing and popping never allocate. Each cell carries a sequence number that tells
+//! producers and consumers whether it is free or filled, so they only contend on their own position counter.
+//! The non-blocking functions are lock-free. The blocking ones spin for a while and then sleep on a condition
+//! variable, which is only touched if a thread is actually waiting.
+//! Data must be default constructible and move assignable.
+template <typename Data>
+class ConcurrentRing {
+  public:
+	//! creates a queue that can hold at least \a capacity items. The capacity is rounded up to a power of two.
+	explicit ConcurrentRing( size_t capacity = 1024 )
+	    : mEnqueuePos( 0 )
+	    , mDequeuePos( 0 )
+	    , mInvalidated( false )
+	    , mWaitingConsumers( 0 )
+	    , mWaitingProducers( 0 )
+	{
+		size_t size = 2;
+		while( size < capacity )
+			size <<= 1;
+
+		mMask = size - 1;
+		mCells.reset( new Cell[size] );
+		for( size_t i = 0; i < size; ++i )
+			mCells[i].sequence.store( i, std::memory_order_relaxed );
+	}
+
+	~ConcurrentRing( void ){};
+
+	ConcurrentRing( const ConcurrentRing & ) = delete;
+	ConcurrentRing &operator=( const ConcurrentRing & ) = delete;
+
+	//! adds an item, returns FALSE if the queue is full. In that case, \a data is left untouched.
+	bool try_push( Data &&data )
+	{
+		if( !enqueue( data ) )
+			return false;
+
+		notify( mWaitingConsumers, mNotEmpty );
+		return true;
+	}
+
+	//! removes the oldest item, returns FALSE if the queue is empty or has been invalidated
+	bool try_pop( Data &popped_value )
+	{
+		if( mInvalidated || !dequeue( popped_value ) )
+			return false;
+
+		notify( mWaitingProducers, mNotFull );
+		return true;
+	}
+
+	//! adds an item, waits while the queue is full. Returns FALSE if the queue has been invalidated.
+	bool push( Data &&data )
+	{
+		for( int i = 0; i < kSpinCount; ++i ) {
+			if( mInvalidated )
+				return false;
+			if( try_push( std::move( data ) ) )
+				return true;
+			std::this_thread::yield();
+		}
+
+		mWaitingProducers++;
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		bool pushed = false;
+
+		std::unique_lock<std::mutex> lock( mMutex );
+		while( !mInvalidated && !( pushed = enqueue( data ) ) )
+			mNotFull.wait( lock );
+		lock.unlock();
+
+		mWaitingProducers--;
+
+		if( !pushed )
+			return false;
+
+		notify( mWaitingConsumers, mNotEmpty );
+		return true;
+	}
+
+	//! removes the oldest item, waits while the queue is empty. Returns FALSE if the queue has been invalidated.
+	bool wait_and_pop( Data &popped_value )
+	{
+		for( int i = 0; i < kSpinCount; ++i ) {
+			if( try_pop( popped_value ) )
+				return true;
+			if( mInvalidated )
+				return false;
+			std::this_thread::yield();
+		}
+
+		mWaitingConsumers++;
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		bool popped = false;
+
+		std::unique_lock<std::mutex> lock( mMutex );
+		while( !mInvalidated && !( popped = dequeue( popped_value ) ) )
+			mNotEmpty.wait( lock );
+		lock.unlock();
+
+		mWaitingConsumers--;
+
+		if( !popped )
+			return false;
+
+		notify( mWaitingProducers, mNotFull );
+		return true;
+	}
+
+	//! removes the oldest item, waits at most \a timeout while the queue is empty. Returns FALSE if the queue is still empty or has been invalidated.
+	template <typename Rep, typename Period>
+	bool wait_and_pop( Data &popped_value, const std::chrono::duration<Rep, Period> &timeout )
+	{
+		if( try_pop( popped_value ) )
+			return true;
+
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+		mWaitingConsumers++;
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		bool popped = false;
+
+		std::unique_lock<std::mutex> lock( mMutex );
+		while( !mInvalidated && !( popped = dequeue( popped_value ) ) ) {
+			if( mNotEmpty.wait_until( lock, deadline ) == std::cv_status::timeout ) {
+				popped = !mInvalidated && dequeue( popped_value );
+				break;
+			}
+		}
+		lock.unlock();
+
+		mWaitingConsumers--;
+
+		if( !popped )
+			return false;
+
+		notify( mWaitingProducers, mNotFull );
+		return true;
+	}
+
+	//! removes the oldest item, busy-waits while the queue is empty. Use this only if items are expected very soon,
+	//! e.g. in a pipeline with one thread per core. Returns FALSE if the queue has been invalidated.
+	bool spin_and_pop( Data &popped_value )
+	{
+		while( !try_pop( popped_value ) ) {
+			if( mInvalidated )
+				return false;
+			std::this_thread::yield();
+		}
+
+		return true;
+	}
+
+	//! wakes up all waiting threads and makes all pop functions return FALSE, so worker threads can terminate
+	void invalidate()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mInvalidated = true;
+		}
+
+		mNotEmpty.notify_all();
+		mNotFull.notify_all();
+	}
+
+	bool isInvalidated() const { return mInvalidated; }
+
+	//! returns the number of items in the queue. Only an estimate if other threads are pushing or popping.
+	size_t size() const
+	{
+		const size_t enqueued = mEnqueuePos.load( std::memory_order_acquire );
+		const size_t dequeued = mDequeuePos.load( std::memory_order_acquire );
+		return enqueued > dequeued ? enqueued - dequeued : 0;
+	}
+
+	bool   empty() const { return size() == 0; }
+	size_t capacity() const { return mMask + 1; }
+
+  private:
+	//! claims the next free cell and moves the item into it
+	bool enqueue( Data &data )
+	{
+		Cell * cell;
+		size_t pos = mEnqueuePos.load( std::memory_order_relaxed );
+
+		for( ;; ) {
+			cell = &mCells[pos & mMask];
+
+			const size_t   sequence = cell->sequence.load( std::memory_order_acquire );
+			const intptr_t diff = intptr_t( sequence ) - intptr_t( pos );
+
+			if( diff == 0 ) {
+				// the cell is free, try to claim it
+				if( mEnqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+					break;
+			}
+			else if( diff < 0 ) {
+				// the cell has not been popped yet, so the queue is full
+				return false;
+			}
+			else {
+				// another producer claimed the cell
+				pos = mEnqueuePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		cell->data = std::move( data );
+		cell->sequence.store( pos + 1, std::memory_order_release );
+
+		return true;
+	}
+
+	//! claims the oldest filled cell and moves the item out of it
+	bool dequeue( Data &data )
+	{
+		Cell * cell;
+		size_t pos = mDequeuePos.load( std::memory_order_relaxed );
+
+		for( ;; ) {
+			cell = &mCells[pos & mMask];
+
+			const size_t   sequence = cell->sequence.load( std::memory_order_acquire );
+			const intptr_t diff = intptr_t( sequence ) - intptr_t( pos + 1 );
+
+			if( diff == 0 ) {
+				// the cell is filled, try to claim it
+				if( mDequeuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+					break;
+			}
+			else if( diff < 0 ) {
+				// the cell has not been pushed yet, so the queue is empty
+				return false;
+			}
+			else {
+				// another consumer claimed the cell
+				pos = mDequeuePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		data = std::move( cell->data );
+		cell->sequence.store( pos + mMask + 1, std::memory_order_release );
+
+		return true;
+	}
+
+	//! wakes up a thread waiting on \a condition. Only takes the lock if a thread is actually waiting,
+	//! which keeps the common case lock-free. The fence pairs with the one in the waiting functions.
+	void notify( std::atomic<int> &waiting, std::condition_variable &condition )
+	{
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if( waiting.load( std::memory_order_relaxed ) > 0 ) {
+			{
+				std::lock_guard<std::mutex> lock( mMutex );
+			}
+			condition.notify_one();
+		}
+	}
+
+  private:
+	static const int    kSpinCount = 64;
+	static const size_t kCacheLineSize = 64;
+
+	typedef char Padding[kCacheLineSize];
+
+	struct Cell {
+		std::atomic<size_t> sequence;
+		Data                data;
+	};
+
+	// keep the position counters on separate cache lines, so producers and consumers don't slow each other down
+	Padding             mPadding0;
+	std::atomic<size_t> mEnqueuePos;
+	Padding             mPadding1;
+	std::atomic<size_t> mDequeuePos;
+	Padding             mPadding2;
+
+	std::unique_ptr<Cell[]> mCells;
+	size_t                  mMask;
+
+	std::atomic<bool>       mInvalidated;
+	std::atomic<int>        mWaitingConsumers;
+	std::atomic<int>        mWaitingProducers;
+	std::mutex              mMutex;
+	std::condition_variable mNotEmpty;
+	std::condition_variable mNotFull;
+};
+
+} // namespace ph
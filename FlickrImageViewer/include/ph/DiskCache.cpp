@@ -0,0 +1,319 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cinder/Log.h"
+
+#include "ph/DiskCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace ph {
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const uint32_t kMagic = 0x43444850; // 'PHDC'
+const uint32_t kVersion = 1;
+
+//! each file starts with this header, followed by the key and the surfaces
+struct FileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t keyLength;
+	uint32_t count;
+};
+
+//! each surface starts with this header, followed by its rows of pixels (without padding)
+struct SurfaceHeader {
+	int32_t width;
+	int32_t height;
+	int32_t channelOrder;
+	int32_t hasAlpha;
+};
+
+//! 64-bit FNV-1a hash, which is stable across runs and platforms (unlike std::hash)
+uint64_t hash( const string &str )
+{
+	uint64_t result = 14695981039346656037ULL;
+	for( unsigned char c : str ) {
+		result ^= c;
+		result *= 1099511628211ULL;
+	}
+
+	return result;
+}
+
+//! converts a file time to an integer, regardless of which filesystem library is used
+template <typename T>
+long long toInteger( const T &time )
+{
+	return static_cast<long long>( time );
+}
+
+template <typename Clock, typename Duration>
+long long toInteger( const std::chrono::time_point<Clock, Duration> &time )
+{
+	return static_cast<long long>( time.time_since_epoch().count() );
+}
+
+} // namespace
+
+DiskCache::DiskCache( const fs::path &directory, size_t maxBytes )
+    : mDirectory( directory )
+    , mMaxBytes( maxBytes )
+    , mEntries( maxBytes )
+{
+	try {
+		if( !fs::exists( mDirectory ) )
+			fs::create_directories( mDirectory );
+
+		// add existing files, oldest first, so the most recently written ones are the last to be evicted
+		typedef decltype( fs::last_write_time( mDirectory ) ) FileTime;
+		vector<pair<FileTime, fs::path>> files;
+
+		for( fs::directory_iterator itr( mDirectory ), end; itr != end; ++itr ) {
+			const fs::path path = itr->path();
+			if( fs::is_regular_file( path ) && path.extension() == ".bin" )
+				files.push_back( make_pair( fs::last_write_time( path ), path ) );
+		}
+
+		sort( files.begin(), files.end(), []( const pair<FileTime, fs::path> &a, const pair<FileTime, fs::path> &b ) { return a.first < b.first; } );
+
+		for( auto &file : files )
+			mEntries.insert( file.second.filename().string(), true, size_t( fs::file_size( file.second ) ) );
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "Failed to open disk cache at " << mDirectory << ": " << exc.what() );
+	}
+
+	vector<string> evicted = trim();
+	remove( evicted );
+}
+
+bool DiskCache::load( const string &key, vector<Surface> &surfaces )
+{
+	const string filename = getFilename( key );
+
+	{
+		lock_guard<mutex> lock( mMutex );
+		if( !mEntries.get( filename ) )
+			return false;
+	}
+
+	ifstream file( ( mDirectory / filename ).string().c_str(), ios::in | ios::binary );
+	if( !file.is_open() )
+		return false;
+
+	FileHeader header;
+	file.read( reinterpret_cast<char *>( &header ), sizeof( header ) );
+	if( !file || header.magic != kMagic || header.version != kVersion || header.keyLength != key.size() ) {
+		erase( key );
+		return false;
+	}
+
+	// the file may belong to a different key with the same hash
+	string stored( header.keyLength, '\0' );
+	file.read( &stored[0], header.keyLength );
+	if( !file || stored != key )
+		return false;
+
+	vector<Surface> result;
+	for( uint32_t i = 0; i < header.count; ++i ) {
+		SurfaceHeader info;
+		file.read( reinterpret_cast<char *>( &info ), sizeof( info ) );
+		if( !file || info.width <= 0 || info.height <= 0 )
+			break;
+
+		Surface surface( info.width, info.height, info.hasAlpha != 0, SurfaceChannelOrder( info.channelOrder ) );
+
+		const size_t rowBytes = size_t( info.width ) * surface.getPixelInc();
+		for( int32_t y = 0; y < info.height && file; ++y )
+			file.read( reinterpret_cast<char *>( surface.getData() + y * surface.getRowBytes() ), rowBytes );
+
+		if( !file )
+			break;
+
+		result.push_back( surface );
+	}
+
+	if( result.size() != header.count ) {
+		CI_LOG_W( "Disk cache file " << filename << " is corrupt." );
+		erase( key );
+		return false;
+	}
+
+	surfaces.swap( result );
+	return true;
+}
+
+bool DiskCache::store( const string &key, const vector<Surface> &surfaces )
+{
+	if( surfaces.empty() )
+		return false;
+
+	const string filename = getFilename( key );
+	const fs::path path = mDirectory / filename;
+
+	// write to a temporary file first, so other threads never read a partially written file
+	ostringstream temp;
+	temp << filename << "." << this_thread::get_id() << ".tmp";
+	const fs::path tempPath = mDirectory / temp.str();
+
+	size_t bytes = 0;
+
+	{
+		ofstream file( tempPath.string().c_str(), ios::out | ios::binary | ios::trunc );
+		if( !file.is_open() )
+			return false;
+
+		FileHeader header = { kMagic, kVersion, uint32_t( key.size() ), uint32_t( surfaces.size() ) };
+		file.write( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+		file.write( key.data(), key.size() );
+		bytes += sizeof( header ) + key.size();
+
+		for( auto &surface : surfaces ) {
+			SurfaceHeader info = { surface.getWidth(), surface.getHeight(), surface.getChannelOrder().getCode(), surface.hasAlpha() ? 1 : 0 };
+			file.write( reinterpret_cast<const char *>( &info ), sizeof( info ) );
+			bytes += sizeof( info );
+
+			const size_t rowBytes = size_t( surface.getWidth() ) * surface.getPixelInc();
+			for( int32_t y = 0; y < surface.getHeight(); ++y )
+				file.write( reinterpret_cast<const char *>( surface.getData() + y * surface.getRowBytes() ), rowBytes );
+			bytes += rowBytes * surface.getHeight();
+		}
+
+		if( !file ) {
+			file.close();
+			remove( vector<string>( 1, temp.str() ) );
+			return false;
+		}
+	}
+
+	vector<string> evicted;
+
+	{
+		lock_guard<mutex> lock( mMutex );
+
+		try {
+			if( fs::exists( path ) )
+				fs::remove( path );
+			fs::rename( tempPath, path );
+		}
+		catch( const std::exception &exc ) {
+			CI_LOG_W( "Failed to store " << filename << " in disk cache: " << exc.what() );
+			evicted.push_back( temp.str() );
+		}
+
+		if( evicted.empty() ) {
+			mEntries.insert( filename, true, bytes );
+			evicted = trim();
+		}
+	}
+
+	remove( evicted );
+	return true;
+}
+
+void DiskCache::erase( const string &key )
+{
+	const string filename = getFilename( key );
+
+	{
+		lock_guard<mutex> lock( mMutex );
+		if( !mEntries.erase( filename ) )
+			return;
+	}
+
+	remove( vector<string>( 1, filename ) );
+}
+
+void DiskCache::clear()
+{
+	vector<string> evicted;
+
+	{
+		lock_guard<mutex> lock( mMutex );
+		mEntries.trim( 0, [&]( const string &filename, bool & ) { evicted.push_back( filename ); } );
+	}
+
+	remove( evicted );
+}
+
+size_t DiskCache::getSize()
+{
+	lock_guard<mutex> lock( mMutex );
+	return mEntries.bytes();
+}
+
+string DiskCache::getKey( const string &url )
+{
+	// for local files, include size and modification time, so the entry is replaced when the file changes
+	try {
+		const fs::path path( url );
+		if( fs::is_regular_file( path ) ) {
+			ostringstream key;
+			key << url << "|" << fs::file_size( path ) << "|" << toInteger( fs::last_write_time( path ) );
+			return key.str();
+		}
+	}
+	catch( ... ) {
+	}
+
+	// remote images are assumed not to change, as is the case for Flickr
+	return url;
+}
+
+string DiskCache::getFilename( const string &key )
+{
+	ostringstream filename;
+	filename << hex << hash( key ) << ".bin";
+	return filename.str();
+}
+
+vector<string> DiskCache::trim()
+{
+	vector<string> evicted;
+	mEntries.trim( mMaxBytes, [&]( const string &filename, bool & ) { evicted.push_back( filename ); } );
+
+	return evicted;
+}
+
+void DiskCache::remove( const vector<string> &filenames )
+{
+	for( auto &filename : filenames ) {
+		try {
+			fs::remove( mDirectory / filename );
+		}
+		catch( ... ) {
+			// the file may still be open on another thread, it will be removed the next time the cache is created
+		}
+	}
+}
+
+} // namespace ph
@@ -0,0 +1,84 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "cinder/Surface.h"
+
+#include "ph/LruCache.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ph {
+
+typedef std::shared_ptr<class DiskCache> DiskCacheRef;
+
+//! Persistent cache of decoded images. Each entry is stored as a single file containing the raw pixel data of
+//! one or more surfaces (e.g. a mip chain), so it can be read back without decoding. The total size of the cache
+//! is limited: the least recently used files are deleted first. All functions are thread-safe.
+class DiskCache {
+  public:
+	//! creates a cache in \a directory, which will be created if needed, using at most \a maxBytes of disk space
+	static DiskCacheRef create( const ci::fs::path &directory, size_t maxBytes ) { return DiskCacheRef( new DiskCache( directory, maxBytes ) ); }
+
+	~DiskCache( void ){};
+
+	//! reads the surfaces stored under \a key. Returns FALSE if not found or if the file is invalid.
+	bool load( const std::string &key, std::vector<ci::Surface> &surfaces );
+	//! stores the surfaces under \a key, replacing any previous entry, and deletes old entries if the cache is full.
+	bool store( const std::string &key, const std::vector<ci::Surface> &surfaces );
+	//! deletes the entry for \a key
+	void erase( const std::string &key );
+	//! deletes all entries
+	void clear();
+
+	//! returns the number of bytes currently used on disk
+	size_t getSize();
+	size_t getMaxSize() const { return mMaxBytes; }
+
+	//! returns a key for \a url that changes when the file it points to changes. For remote urls, returns the url itself.
+	static std::string getKey( const std::string &url );
+
+  private:
+	DiskCache( const ci::fs::path &directory, size_t maxBytes );
+
+	//! returns the file name for a key
+	static std::string getFilename( const std::string &key );
+
+	//! removes least recently used entries until the cache fits, returns the files that should be deleted. Must be called with the mutex locked.
+	std::vector<std::string> trim();
+	//! deletes files, should be called without the mutex locked
+	void remove( const std::vector<std::string> &filenames );
+
+  private:
+	ci::fs::path mDirectory;
+	size_t       mMaxBytes;
+
+	//! file sizes by file name, files are added in the order they were last written when the cache is created
+	LruCache<std::string, bool> mEntries;
+	std::mutex                  mMutex;
+};
+
+} // namespace ph
@@ -0,0 +1,254 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace ph {
+
+//! Least-recently-used cache with a budget in bytes. Each entry is inserted with its size, so the cache can hold
+//! anything from Surfaces to Textures. Pinned entries are never evicted. Not thread-safe: protect it with a mutex
+//! if it is shared between threads.
+template <typename Key, typename Data, typename Hash = std::hash<Key>>
+class LruCache {
+  public:
+	struct Stats {
+		Stats( void )
+		    : evictions( 0 )
+		    , bytes( 0 )
+		    , count( 0 ){};
+
+		size_t evictions;
+		size_t bytes;
+		size_t count;
+	};
+
+	//! creates a cache that will hold at most \a budget bytes of unpinned entries
+	LruCache( size_t budget )
+	    : mBudget( budget )
+	    , mPinnedBytes( 0 ){};
+	~LruCache( void ){};
+
+	void   setBudget( size_t bytes ) { mBudget = bytes; }
+	size_t getBudget() const { return mBudget; }
+
+	//! returns the statistics of this cache
+	Stats getStats() const
+	{
+		Stats stats = mStats;
+		stats.count = mIndex.size();
+		return stats;
+	}
+	//! resets the eviction counter
+	void resetStats() { mStats.evictions = 0; }
+
+	bool contains( Key const &key ) const { return mIndex.find( key ) != mIndex.end(); }
+	bool empty() const { return mIndex.empty(); }
+	//! returns the total size in bytes of all entries, including pinned ones
+	size_t bytes() const { return mStats.bytes; }
+
+	//! returns a pointer to the data, or nullptr if not found. Marks the entry as most recently used.
+	Data *get( Key const &key )
+	{
+		auto itr = mIndex.find( key );
+		if( itr == mIndex.end() )
+			return nullptr;
+
+		touch( itr->second );
+
+		return &itr->second->data;
+	}
+
+	//! adds or replaces an entry and marks it as most recently used. Does not evict, call trim() for that.
+	void insert( Key const &key, Data data, size_t bytes )
+	{
+		auto itr = mIndex.find( key );
+		if( itr != mIndex.end() ) {
+			mStats.bytes -= itr->second->bytes;
+			mStats.bytes += bytes;
+
+			// a pinned entry keeps its pin, so its new size must not count towards the budget either
+			if( itr->second->pinned ) {
+				mPinnedBytes -= itr->second->bytes;
+				mPinnedBytes += bytes;
+			}
+
+			itr->second->data = std::move( data );
+			itr->second->bytes = bytes;
+			touch( itr->second );
+			return;
+		}
+
+		mEntries.push_front( Entry( key, std::move( data ), bytes ) );
+		mIndex[key] = mEntries.begin();
+		mStats.bytes += bytes;
+	}
+
+	//! moves the data out of the cache and removes the entry
+	bool take( Key const &key, Data &data )
+	{
+		auto itr = mIndex.find( key );
+		if( itr == mIndex.end() )
+			return false;
+
+		data = std::move( itr->second->data );
+		remove( itr );
+
+		return true;
+	}
+
+	//! removes an entry, returns TRUE if it was found
+	bool erase( Key const &key )
+	{
+		auto itr = mIndex.find( key );
+		if( itr == mIndex.end() )
+			return false;
+
+		remove( itr );
+		return true;
+	}
+
+	//! pinned entries are never evicted and do not count towards the budget
+	bool pin( Key const &key, bool pinned = true )
+	{
+		auto itr = mIndex.find( key );
+		if( itr == mIndex.end() )
+			return false;
+
+		auto &entry = itr->second;
+		if( entry->pinned != pinned ) {
+			entry->pinned = pinned;
+
+			if( pinned ) {
+				mPinnedBytes += entry->bytes;
+				mPinned.splice( mPinned.begin(), mEntries, entry );
+			}
+			else {
+				mPinnedBytes -= entry->bytes;
+				mEntries.splice( mEntries.begin(), mPinned, entry );
+			}
+		}
+
+		return true;
+	}
+
+	bool isPinned( Key const &key ) const
+	{
+		auto itr = mIndex.find( key );
+		return itr != mIndex.end() && itr->second->pinned;
+	}
+
+	//! evicts least recently used entries until the cache fits its budget. Evicted data is moved to \a evicted,
+	//! so the caller can decide when and where to destroy it (e.g. after releasing a lock). Returns the number of evicted entries.
+	size_t trim( std::vector<Data> *evicted = nullptr )
+	{
+		return trim( mBudget, [evicted]( Key const &key, Data &data ) {
+			if( evicted )
+				evicted->push_back( std::move( data ) );
+		} );
+	}
+
+	//! evicts least recently used entries until the cache fits \a budget bytes, calling \a evict( key, data ) for each of them.
+	template <typename Callback>
+	size_t trim( size_t budget, Callback evict )
+	{
+		size_t count = 0;
+
+		while( !mEntries.empty() && mStats.bytes - mPinnedBytes > budget ) {
+			auto itr = mIndex.find( mEntries.back().key );
+			evict( itr->first, itr->second->data );
+
+			remove( itr );
+			mStats.evictions++;
+			count++;
+		}
+
+		return count;
+	}
+
+	//! removes all entries, including pinned ones
+	void clear()
+	{
+		mIndex.clear();
+		mEntries.clear();
+		mPinned.clear();
+		mStats.bytes = 0;
+		mPinnedBytes = 0;
+	}
+
+  private:
+	struct Entry {
+		Entry( Key const &key, Data &&data, size_t bytes )
+		    : key( key )
+		    , data( std::move( data ) )
+		    , bytes( bytes )
+		    , pinned( false ){};
+
+		Key    key;
+		Data   data;
+		size_t bytes;
+		bool   pinned;
+	};
+
+	typedef std::list<Entry>                                          EntryList;
+	typedef std::unordered_map<Key, typename EntryList::iterator, Hash> EntryIndex;
+
+	void touch( typename EntryList::iterator entry )
+	{
+		if( !entry->pinned )
+			mEntries.splice( mEntries.begin(), mEntries, entry );
+	}
+
+	void remove( typename EntryIndex::iterator itr )
+	{
+		auto entry = itr->second;
+
+		mStats.bytes -= entry->bytes;
+		if( entry->pinned ) {
+			mPinnedBytes -= entry->bytes;
+			mPinned.erase( entry );
+		}
+		else {
+			mEntries.erase( entry );
+		}
+
+		mIndex.erase( itr );
+	}
+
+  private:
+	//! unpinned entries, most recently used first
+	EntryList mEntries;
+	//! pinned entries, in no particular order
+	EntryList  mPinned;
+	EntryIndex mIndex;
+
+	size_t mBudget;
+	size_t mPinnedBytes;
+	Stats  mStats;
+};
+
+} // namespace ph
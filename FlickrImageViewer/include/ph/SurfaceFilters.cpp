@@ -0,0 +1,150 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cinder/ip/Resize.h"
+
+#include "ph/SurfaceFilters.h"
+
+#include <algorithm>
+
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __SSE2__ )
+#include <emmintrin.h>
+#define PH_USE_SSE2 1
+#endif
+
+namespace ph {
+
+using namespace ci;
+
+namespace {
+
+//! averages 2x2 blocks of 4-byte pixels from two source rows, 4 output pixels per iteration. Returns the number of pixels written.
+int halveRow4( const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int width )
+{
+	int x = 0;
+
+#if PH_USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16( 2 );
+
+	for( ; x + 4 <= width; x += 4 ) {
+		const __m128i a0 = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row0 + x * 8 ) );
+		const __m128i a1 = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row0 + x * 8 + 16 ) );
+		const __m128i b0 = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row1 + x * 8 ) );
+		const __m128i b1 = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row1 + x * 8 + 16 ) );
+
+		// widen to 16 bits and add vertically, each 64-bit half now holds the sums of one column
+		const __m128i v0 = _mm_add_epi16( _mm_unpacklo_epi8( a0, zero ), _mm_unpacklo_epi8( b0, zero ) );
+		const __m128i v1 = _mm_add_epi16( _mm_unpackhi_epi8( a0, zero ), _mm_unpackhi_epi8( b0, zero ) );
+		const __m128i v2 = _mm_add_epi16( _mm_unpacklo_epi8( a1, zero ), _mm_unpacklo_epi8( b1, zero ) );
+		const __m128i v3 = _mm_add_epi16( _mm_unpackhi_epi8( a1, zero ), _mm_unpackhi_epi8( b1, zero ) );
+
+		// add even and odd columns, then round the same way as the scalar code: ( sum + 2 ) >> 2
+		__m128i lo = _mm_add_epi16( _mm_unpacklo_epi64( v0, v1 ), _mm_unpackhi_epi64( v0, v1 ) );
+		__m128i hi = _mm_add_epi16( _mm_unpacklo_epi64( v2, v3 ), _mm_unpackhi_epi64( v2, v3 ) );
+		lo = _mm_srli_epi16( _mm_add_epi16( lo, two ), 2 );
+		hi = _mm_srli_epi16( _mm_add_epi16( hi, two ), 2 );
+
+		_mm_storeu_si128( reinterpret_cast<__m128i *>( dst + x * 4 ), _mm_packus_epi16( lo, hi ) );
+	}
+#endif
+
+	return x;
+}
+
+} // namespace
+
+Surface halveSurface( const Surface &surface )
+{
+	const int srcWidth = surface.getWidth();
+	const int srcHeight = surface.getHeight();
+	const int width = std::max( 1, srcWidth / 2 );
+	const int height = std::max( 1, srcHeight / 2 );
+
+	Surface result( width, height, surface.hasAlpha(), surface.getChannelOrder() );
+
+	const int      inc = surface.getPixelInc();
+	const uint8_t *src = surface.getData();
+	uint8_t *      dst = result.getData();
+
+	const ptrdiff_t srcRowBytes = surface.getRowBytes();
+	const ptrdiff_t dstRowBytes = result.getRowBytes();
+
+	// surfaces with a single row or column are averaged along the other axis only
+	const int dx = srcWidth > 1 ? 1 : 0;
+	const int dy = srcHeight > 1 ? 1 : 0;
+
+	for( int y = 0; y < height; ++y ) {
+		const uint8_t *row0 = src + ( 2 * y ) * srcRowBytes;
+		const uint8_t *row1 = src + ( 2 * y + dy ) * srcRowBytes;
+		uint8_t *      out = dst + y * dstRowBytes;
+
+		int x = ( inc == 4 && dx ) ? halveRow4( row0, row1, out, width ) : 0;
+
+		// remaining pixels, or all of them for 3-byte pixels
+		for( ; x < width; ++x ) {
+			const uint8_t *p0 = row0 + ( 2 * x ) * inc;
+			const uint8_t *p1 = row0 + ( 2 * x + dx ) * inc;
+			const uint8_t *p2 = row1 + ( 2 * x ) * inc;
+			const uint8_t *p3 = row1 + ( 2 * x + dx ) * inc;
+
+			for( int c = 0; c < inc; ++c )
+				out[x * inc + c] = uint8_t( ( p0[c] + p1[c] + p2[c] + p3[c] + 2 ) >> 2 );
+		}
+	}
+
+	return result;
+}
+
+Surface downsampleSurface( const Surface &surface, const ivec2 &size )
+{
+	const Area source = surface.getBounds();
+	const Area fit = Area::proportionalFit( source, Area( ivec2( 0 ), size ), false, false );
+
+	if( fit.getWidth() >= source.getWidth() || fit.getHeight() >= source.getHeight() )
+		return surface;
+
+	// halving is cheap and doesn't alias, so do that while we are at least twice as large
+	Surface result = surface;
+	while( result.getWidth() >= 2 * fit.getWidth() && result.getHeight() >= 2 * fit.getHeight() )
+		result = halveSurface( result );
+
+	if( result.getSize() != fit.getSize() )
+		result = ip::resizeCopy( result, result.getBounds(), fit.getSize() );
+
+	return result;
+}
+
+std::vector<Surface> createMipChain( const Surface &surface )
+{
+	std::vector<Surface> chain;
+	chain.push_back( surface );
+
+	while( chain.back().getWidth() > 1 || chain.back().getHeight() > 1 ) {
+		Surface next = halveSurface( chain.back() );
+		chain.push_back( next );
+	}
+
+	return chain;
+}
+
+} // namespace ph
@@ -25,33 +25,45 @@
 #pragma warning( disable : 4244 )
 
 #include "cinder/Log.h"
+#include "cinder/Timer.h"
 #include "cinder/app/App.h"
-#include "cinder/ip/Resize.h"
 //#include "cinder/DataSource.h"
 //#include "cinder/ImageIo.h"
 //#include "cinder/Thread.h"
 //#include "cinder/Utilities.h"
 
+#include "ph/SurfaceFilters.h"
 #include "ph/TextureStore.h"
 
+#include <sstream>
+
 namespace ph {
 
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
+// default budgets, can be changed using setTextureBudget() and setSurfaceBudget()
+static const size_t kTextureBudget = 256 * 1024 * 1024;
+static const size_t kSurfaceBudget = 128 * 1024 * 1024;
+
 TextureStore::TextureStore( void )
-    : mShouldQuit( false )
+    : mTextureCache( kTextureBudget )
+    , mSurfaces( kSurfaceBudget )
+    , mHits( 0 )
+    , mMisses( 0 )
+    , mCreated( 0 )
+    , mCreateSeconds( 0 )
+    , mWorkerMipmapping( true )
+    , mDiskHits( 0 )
+    , mDiskMisses( 0 )
+    , mActiveTasks( 0 )
+    , mShouldQuit( false )
 {
 	// initialize buffers
 	mTextures.clear();
+	mTextureCache.clear();
 	mSurfaces.clear();
-	mThreads.clear();
-
-	// create worker thread for each CPU
-	unsigned int numThreads = std::thread::hardware_concurrency();
-	for( unsigned int i = 0; i < numThreads; ++i )
-		mThreads.emplace_back( std::unique_ptr<std::thread>( new std::thread( &TextureStore::threadLoad, this ) ) );
 }
 
 TextureStore::~TextureStore( void )
@@ -62,29 +74,26 @@ TextureStore::~TextureStore( void )
 gl::TextureRef TextureStore::load( const string &url, gl::Texture2d::Format fmt )
 {
 	// if texture already exists, return it immediately
-	auto itr = mTextures.find( url );
-	if( itr != mTextures.end() ) {
-		if( !itr->second.expired() )
-			return itr->second.lock();
-	}
+	gl::TextureRef existing = findTexture( url );
+	if( existing )
+		return existing;
 
 	// otherwise, check if the image has loaded and create a texture for it
-	Surface surface;
-	if( mSurfaces.try_pop( url, surface ) ) {
+	MipChain chain;
+	if( takeSurface( url, chain ) ) {
 		// done loading
-		mLoadingQueue.erase( url );
+		endLoading( url );
 
 		CI_LOG_V( "Creating texture for '" << url << "'." );
-		fmt.deleter( CustomDeleter() );
-		gl::TextureRef tex = gl::Texture2d::create( surface, fmt );
-		return storeTexture( url, tex );
+		return storeTexture( url, createTexture( url, chain, fmt ) );
 	}
 
 	// load texture and add to TextureList
 	CI_LOG_V( "Loading Texture2d '" << url << "'." );
+	mMisses++;
 	try {
 		ImageSourceRef img = loadImage( url );
-		fmt.deleter( CustomDeleter() );
+		fmt.deleter( CustomDeleter( url ) );
 		gl::TextureRef tex = gl::Texture2d::create( img, fmt );
 		return storeTexture( url, tex );
 	}
@@ -93,7 +102,7 @@ gl::TextureRef TextureStore::load( const string &url, gl::Texture2d::Format fmt
 
 	try {
 		ImageSourceRef img = loadImage( loadUrl( Url( url ) ) );
-		fmt.deleter( CustomDeleter() );
+		fmt.deleter( CustomDeleter( url ) );
 		gl::TextureRef tex = gl::Texture2d::create( img, fmt );
 		return storeTexture( url, tex );
 	}
@@ -105,62 +114,85 @@ gl::TextureRef TextureStore::load( const string &url, gl::Texture2d::Format fmt
 	return empty();
 }
 
-gl::TextureRef TextureStore::fetch( const string &url, gl::Texture2d::Format fmt )
+gl::TextureRef TextureStore::fetch( const string &url, gl::Texture2d::Format fmt, float priority, const ivec2 &size )
 {
 	// if texture already exists, return it immediately
-	auto itr = mTextures.find( url );
-	if( itr != mTextures.end() ) {
-		if( !itr->second.expired() )
-			return itr->second.lock();
-	}
+	gl::TextureRef existing = findTexture( url );
+	if( existing )
+		return existing;
 
 	// otherwise, check if the image has loaded and create a texture for it
-	Surface surface;
-	if( mSurfaces.try_pop( url, surface ) ) {
+	MipChain chain;
+	if( takeSurface( url, chain ) ) {
 		// done loading
-		mLoadingQueue.erase( url );
+		endLoading( url );
 
 		CI_LOG_V( "Creating Texture2d for '" << url << "'." );
-		fmt.deleter( CustomDeleter() );
-		gl::TextureRef tex = gl::Texture2d::create( surface, fmt );
-		return storeTexture( url, tex );
+		return storeTexture( url, createTexture( url, chain, fmt ) );
 	}
 
 	// add to list of currently loading/scheduled files
-	if( mLoadingQueue.push_back( url, true ) ) {
-		// hand over to threaded loader
-		if( mQueue.push_back( url, true ) ) {
+	if( beginLoading( url, size, fmt.hasMipmapping() ) ) {
+		mMisses++;
+
+		// hand over to the task scheduler. Each task loads the image with the highest priority at that time.
+		if( mQueue.push( url, priority ) ) {
 			CI_LOG_V( "Queueing Texture2d '" << url << "' for loading." );
+
+			mActiveTasks++;
+			TaskScheduler::getInstance().submit( [this]() {
+				loadNext();
+				mActiveTasks--;
+			} );
 		}
 	}
+	else {
+		// if still queued, update its priority
+		mQueue.reprioritize( url, priority );
+	}
 
 	return empty();
 }
 
+bool TextureStore::prioritize( const string &url, float priority )
+{
+	return mQueue.reprioritize( url, priority );
+}
+
 bool TextureStore::abort( const string &url )
 {
-	mLoadingQueue.erase_all( url );
-	return mQueue.erase_all( url );
+	bool aborted = mQueue.erase( url );
+
+	// signal the worker thread, in case it is already loading the image
+	RequestRef request;
+	if( mLoading.try_take( url, request ) ) {
+		request->mCancelled = true;
+		aborted = true;
+	}
+
+	return aborted;
 }
 
 void TextureStore::cleanup()
 {
-	// stop loader threads and wait for them to finish
+	// stop loading and wait for running tasks to finish. Queued tasks return immediately.
 	mShouldQuit = true;
 
 	mQueue.invalidate();
-	mLoadingQueue.invalidate();
-	mSurfaces.invalidate();
 
-	for( auto &thread : mThreads ) {
-		if( thread->joinable() )
-			thread->join();
-	}
+	while( mActiveTasks > 0 && TaskScheduler::getInstance().isRunning() )
+		std::this_thread::yield();
 
 	// clear buffers
-	mThreads.clear();
+	mQueue.clear();
+	mLoading.clear();
 	mSurfaces.clear();
+	mPinned.clear();
+	disableDiskCache();
+
+	// clear mTextures first, because releasing the cached textures will call our CustomDeleter
 	mTextures.clear();
+	mTextureCache.clear();
 }
 
 vector<string> TextureStore::getLoadExtensions()
@@ -176,7 +208,7 @@ vector<string> TextureStore::getLoadExtensions()
 
 bool TextureStore::isLoading( const string &url )
 {
-	return mLoadingQueue.contains( url );
+	return mLoading.contains( url );
 }
 
 bool TextureStore::isLoaded( const string &url )
@@ -184,99 +216,372 @@ bool TextureStore::isLoaded( const string &url )
 	return ( mTextures.find( url ) != mTextures.end() );
 }
 
+void TextureStore::pin( const string &url, bool pinned )
+{
+	{
+		std::lock_guard<std::mutex> lock( mSurfacesMutex );
+		if( pinned )
+			mPinned.insert( url );
+		else
+			mPinned.erase( url );
+
+		mSurfaces.pin( url, pinned );
+	}
+
+	mTextureCache.pin( url, pinned );
+
+	// the texture may have been evicted from the cache while still in use, so add it again
+	if( pinned && !mTextureCache.contains( url ) ) {
+		auto itr = mTextures.find( url );
+		if( itr != mTextures.end() ) {
+			gl::TextureRef texture = itr->second.lock();
+			if( texture ) {
+				mTextureCache.insert( url, texture, getMemorySize( texture ) );
+				mTextureCache.pin( url );
+			}
+		}
+	}
+
+	if( !pinned ) {
+		trimTextures();
+
+		std::vector<MipChain>       evicted;
+		std::lock_guard<std::mutex> lock( mSurfacesMutex );
+		mSurfaces.trim( &evicted );
+	}
+}
+
+bool TextureStore::isPinned( const string &url )
+{
+	std::lock_guard<std::mutex> lock( mSurfacesMutex );
+	return mPinned.count( url ) > 0;
+}
+
+void TextureStore::setTextureBudget( size_t bytes )
+{
+	mTextureCache.setBudget( bytes );
+	trimTextures();
+}
+
+void TextureStore::setSurfaceBudget( size_t bytes )
+{
+	std::vector<MipChain> evicted;
+
+	std::lock_guard<std::mutex> lock( mSurfacesMutex );
+	mSurfaces.setBudget( bytes );
+	mSurfaces.trim( &evicted );
+}
+
+void TextureStore::enableDiskCache( const fs::path &directory, size_t maxBytes )
+{
+	std::atomic_store( &mDiskCache, DiskCache::create( directory, maxBytes ) );
+}
+
+void TextureStore::disableDiskCache()
+{
+	std::atomic_store( &mDiskCache, DiskCacheRef() );
+}
+
+TextureStore::Stats TextureStore::getStats()
+{
+	Stats stats;
+	stats.hits = mHits;
+	stats.misses = mMisses;
+	stats.created = mCreated;
+	stats.createSeconds = mCreateSeconds;
+	stats.diskHits = mDiskHits;
+	stats.diskMisses = mDiskMisses;
+	stats.textures = mTextureCache.getStats();
+	stats.loading = mLoading.getStats();
+
+	std::lock_guard<std::mutex> lock( mSurfacesMutex );
+	stats.surfaces = mSurfaces.getStats();
+
+	return stats;
+}
+
+void TextureStore::resetStats()
+{
+	mHits = 0;
+	mMisses = 0;
+	mCreated = 0;
+	mCreateSeconds = 0;
+	mDiskHits = 0;
+	mDiskMisses = 0;
+	mTextureCache.resetStats();
+	mLoading.resetStats();
+
+	std::lock_guard<std::mutex> lock( mSurfacesMutex );
+	mSurfaces.resetStats();
+}
+
 //
 
-void TextureStore::threadLoad()
+void TextureStore::loadNext()
 {
-	bool           succeeded;
-	Surface        surface;
+	// the queue may have been emptied by abort() or cleanup()
+	string url;
+	if( mShouldQuit || !mQueue.try_pop( url ) )
+		return;
+
+	// the request may have been aborted after it was queued
+	RequestRef request = getRequest( url );
+	if( !request )
+		return;
+
+	const bool mipmap = request->mMipmap && mWorkerMipmapping;
+
+	// try the disk cache first, which skips downloading, decoding and scaling altogether
+	DiskCacheRef diskCache = std::atomic_load( &mDiskCache );
+	string       diskKey;
+	if( diskCache ) {
+		diskKey = getDiskCacheKey( url, request->mSize, mipmap );
+
+		MipChain chain;
+		if( diskCache->load( diskKey, chain ) ) {
+			mDiskHits++;
+
+			if( request->mCancelled )
+				endLoading( url, request );
+			else
+				storeSurface( url, chain );
+
+			return;
+		}
+
+		mDiskMisses++;
+	}
+
+	// try to load image
 	ImageSourceRef image;
-	string         url;
-
-	// CI_LOG_V( "Load thread initialized." );
-
-	// run until interrupted
-	while( !mShouldQuit ) {
-		bool valid = mQueue.wait_and_pop_front( url );
-
-		if( valid ) {
-			// try to load image
-			succeeded = false;
-
-			// try to load from FILE (fastest)
-			if( !succeeded )
-				try {
-					image = loadImage( loadFile( url ) );
-					succeeded = true;
-				}
-				catch( ... ) {
-				}
-
-			// try to load from ASSET (fast)
-			if( !succeeded )
-				try {
-					image = loadImage( loadAsset( url ) );
-					succeeded = true;
-				}
-				catch( ... ) {
-				}
-
-			// try to load from URL (slow)
-			if( !succeeded )
-				try {
-					image = loadImage( loadUrl( Url( url ) ) );
-					succeeded = true;
-				}
-				catch( ... ) {
-				}
-
-			// do NOT continue if not succeeded (yeah, it's confusing, I know)
-			if( !succeeded )
-				continue;
-
-			// create Surface from the image
-			surface = Surface( image );
-
-			// resize image if larger than 4096 px
-			Area source = surface.getBounds();
-			Area dest( 0, 0, 4096, 4096 );
-			Area fit = Area::proportionalFit( source, dest, false, false );
-
-			if( source.getSize() != fit.getSize() )
-				surface = ip::resizeCopy( surface, source, fit.getSize() );
-
-			// copy to main thread
-			mSurfaces.push( url, surface );
+	bool           succeeded = false;
+
+	// try to load from FILE (fastest)
+	if( !succeeded )
+		try {
+			image = loadImage( loadFile( url ) );
+			succeeded = true;
+		}
+		catch( ... ) {
+		}
+
+	// try to load from ASSET (fast)
+	if( !succeeded )
+		try {
+			image = loadImage( loadAsset( url ) );
+			succeeded = true;
+		}
+		catch( ... ) {
+		}
+
+	// try to load from URL (slow)
+	if( !succeeded && !request->mCancelled )
+		try {
+			image = loadImage( loadUrl( Url( url ) ) );
+			succeeded = true;
 		}
-		else {
-			assert( mShouldQuit == true );
-			// CI_LOG_V( "Queue invalidated: terminating loader thread." );
+		catch( ... ) {
 		}
+
+	// do NOT continue if not succeeded (yeah, it's confusing, I know)
+	if( !succeeded || request->mCancelled ) {
+		endLoading( url, request );
+		return;
 	}
 
-	// CI_LOG_V( "Loader thread terminated." );
+	// create Surface from the image. Decoding can't be interrupted, so check again afterwards.
+	// Note: Cinder's image codecs always decode at full resolution, so we scale down right after.
+	Surface surface( image );
+	image.reset();
+
+	if( request->mCancelled ) {
+		endLoading( url, request );
+		return;
+	}
+
+	// scale down to the requested size, but never larger than 4096 px
+	ivec2 size( 4096 );
+	if( request->mSize.x > 0 && request->mSize.y > 0 )
+		size = glm::min( size, request->mSize );
+
+	surface = downsampleSurface( surface, size );
+
+	// create the mip chain here, so the main thread only has to upload it
+	MipChain chain;
+	if( mipmap )
+		chain = createMipChain( surface );
+	else
+		chain.push_back( surface );
+
+	surface = Surface();
+
+	// store the result, even if the request was aborted, because it will probably be requested again
+	if( diskCache )
+		diskCache->store( diskKey, chain );
+
+	// hand over to main thread, unless the request was aborted in the meantime
+	if( request->mCancelled )
+		endLoading( url, request );
+	else
+		storeSurface( url, chain );
+}
+
+bool TextureStore::beginLoading( const std::string &url, const ivec2 &size, bool mipmap )
+{
+	return mLoading.try_push( url, std::make_shared<Request>( size, mipmap ) );
+}
+
+void TextureStore::endLoading( const std::string &url, const RequestRef &request )
+{
+	mLoading.erase_if( url, [&]( const RequestRef &current ) { return !request || current == request; } );
+}
+
+TextureStore::RequestRef TextureStore::getRequest( const std::string &url )
+{
+	RequestRef request;
+	mLoading.get( url, request );
+
+	return request;
 }
 
 gl::TextureRef TextureStore::storeTexture( const std::string &url, const gl::TextureRef &src )
 {
 	mTextures[url] = std::weak_ptr<gl::Texture2d>( src );
 
-	CI_LOG_V( "Texture2d stored! " << mTextures.size() << " textures in total." );
+	mTextureCache.insert( url, src, getMemorySize( src ) );
+	if( isPinned( url ) )
+		mTextureCache.pin( url );
+
+	trimTextures();
+
+	CI_LOG_V( "Texture2d stored! " << mTextures.size() << " textures in total, " << mTextureCache.bytes() << " bytes cached." );
 
 	return src;
 }
 
+gl::TextureRef TextureStore::findTexture( const std::string &url )
+{
+	gl::TextureRef *cached = mTextureCache.get( url );
+	if( cached ) {
+		mHits++;
+		return *cached;
+	}
+
+	// the texture may have been evicted from the cache while still in use, in which case we add it again
+	auto itr = mTextures.find( url );
+	if( itr != mTextures.end() ) {
+		gl::TextureRef texture = itr->second.lock();
+		if( texture ) {
+			mHits++;
+			mTextureCache.insert( url, texture, getMemorySize( texture ) );
+			trimTextures();
+			return texture;
+		}
+	}
+
+	return gl::TextureRef();
+}
+
+bool TextureStore::takeSurface( const std::string &url, MipChain &chain )
+{
+	std::lock_guard<std::mutex> lock( mSurfacesMutex );
+	return mSurfaces.take( url, chain );
+}
+
+void TextureStore::storeSurface( const std::string &url, MipChain &chain )
+{
+	// evicted surfaces are destroyed after the lock has been released
+	std::vector<MipChain> evicted;
+	std::vector<string>   urls;
+
+	{
+		std::lock_guard<std::mutex> lock( mSurfacesMutex );
+
+		const size_t bytes = getMemorySize( chain );
+		mSurfaces.insert( url, std::move( chain ), bytes );
+		if( mPinned.count( url ) > 0 )
+			mSurfaces.pin( url );
+
+		mSurfaces.trim( mSurfaces.getBudget(), [&]( const string &key, MipChain &data ) {
+			urls.push_back( key );
+			evicted.push_back( std::move( data ) );
+		} );
+	}
+
+	// evicted images are no longer loading, so they will be queued again when fetched
+	for( auto &evictedUrl : urls ) {
+		endLoading( evictedUrl );
+		CI_LOG_V( "Evicted decoded image '" << evictedUrl << "'." );
+	}
+}
+
+gl::TextureRef TextureStore::createTexture( const std::string &url, const MipChain &chain, gl::Texture2d::Format fmt )
+{
+	Timer timer( true );
+
+	fmt.deleter( CustomDeleter( url ) );
+
+	gl::TextureRef tex;
+	if( chain.size() > 1 ) {
+		// upload the mip chain created by the worker thread, instead of having the driver generate it
+		tex = gl::Texture2d::create( chain.front().getWidth(), chain.front().getHeight(), fmt );
+		for( size_t level = 0; level < chain.size(); ++level )
+			tex->update( chain[level], int( level ) );
+	}
+	else {
+		tex = gl::Texture2d::create( chain.front(), fmt );
+	}
+
+	mCreated++;
+	mCreateSeconds += timer.getSeconds();
+
+	return tex;
+}
+
+void TextureStore::trimTextures()
+{
+	// evicted textures are destroyed when this function returns, which calls our CustomDeleter
+	std::vector<gl::TextureRef> evicted;
+	mTextureCache.trim( &evicted );
+}
+
+std::string TextureStore::getDiskCacheKey( const std::string &url, const ivec2 &size, bool mipmap )
+{
+	std::ostringstream key;
+	key << DiskCache::getKey( url ) << "|" << size.x << "x" << size.y;
+	if( mipmap )
+		key << "|mipmap";
+
+	return key.str();
+}
+
+size_t TextureStore::getMemorySize( const gl::TextureRef &texture )
+{
+	// assume 4 bytes per pixel, plus a third for the mip chain
+	size_t bytes = size_t( texture->getWidth() ) * size_t( texture->getHeight() ) * 4;
+	if( texture->hasMipmapping() )
+		bytes += bytes / 3;
+
+	return bytes;
+}
+
+size_t TextureStore::getMemorySize( const MipChain &chain )
+{
+	size_t bytes = 0;
+	for( auto &surface : chain )
+		bytes += size_t( surface.getRowBytes() ) * size_t( surface.getHeight() );
+
+	return bytes;
+}
+
 void TextureStore::CustomDeleter::operator()( gl::TextureBase *ptr )
 {
-	// We know one of our textures has just been deleted. Find it in the map and remove it.
+	// We know one of our textures has just been deleted. Remove it from the map, unless it has been replaced already.
 	if( ptr ) {
 		auto &map = TextureStore::getInstance().mTextures;
-		for( auto itr = map.begin(); itr != map.end(); ++itr ) {
-			if( itr->second.expired() ) {
-				map.erase( itr );
-				break;
-			}
-		}
+		auto  itr = map.find( mUrl );
+		if( itr != map.end() && itr->second.expired() )
+			map.erase( itr );
 
 		CI_LOG_V( "Texture2d Deleted! " << map.size() << " textures remaining." );
 
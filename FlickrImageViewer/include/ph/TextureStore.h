@@ -25,23 +25,37 @@
 #include "cinder/Cinder.h"
 #include "cinder/gl/Texture.h"
 
-#include "ph/ConcurrentDeque.h"
 #include "ph/ConcurrentMap.h"
+#include "ph/ConcurrentPriorityQueue.h"
+#include "ph/DiskCache.h"
+#include "ph/LruCache.h"
 
-namespace ph {
+#include "TaskScheduler.h"
+
+#include <unordered_map>
+#include <unordered_set>
 
-typedef std::vector<std::unique_ptr<std::thread>> TextureStoreThreadPool;
+namespace ph {
 
 class TextureStore {
   private:
 	TextureStore( void );
 	virtual ~TextureStore( void );
 
+	//! Removes the texture from the store when it is destroyed. Knows its url, so it doesn't have to search for it.
 	struct CustomDeleter {
+		CustomDeleter( const std::string &url )
+		    : mUrl( url ){};
+
 		void operator()( ci::gl::TextureBase *tex );
+
+		std::string mUrl;
 	};
 
   public:
+	//! a decoded image, optionally followed by its mip levels
+	typedef std::vector<ci::Surface> MipChain;
+
 	// singleton implementation
 	static TextureStore &getInstance()
 	{
@@ -51,9 +65,14 @@ class TextureStore {
 
 	//! synchronously loads an image into a texture, stores it and returns it
 	ci::gl::Texture2dRef load( const std::string &url, ci::gl::Texture2d::Format fmt = ci::gl::Texture2d::Format() );
-	//! asynchronously loads an image into a texture, returns immediately
-	ci::gl::Texture2dRef fetch( const std::string &url, ci::gl::Texture2d::Format fmt = ci::gl::Texture2d::Format() );
-	//! remove url from the queue. Has no effect if image has already been loaded
+	//! asynchronously loads an image into a texture, returns immediately. Images with a higher priority are loaded first.
+	//! Fetching an image that is still queued changes its priority. If \a size is specified, the image is scaled down
+	//! to fit within it by the worker thread. If \a fmt enables mipmapping, the worker threads also create the mip chain
+	//! (see setWorkerMipmapping).
+	ci::gl::Texture2dRef fetch( const std::string &url, ci::gl::Texture2d::Format fmt = ci::gl::Texture2d::Format(), float priority = 0.0f, const ci::ivec2 &size = ci::ivec2( 0 ) );
+	//! changes the priority of a queued image. Returns FALSE if the image is not queued (anymore).
+	bool prioritize( const std::string &url, float priority );
+	//! remove url from the queue, or cancel loading if a worker thread is already loading it. Has no effect if image has already been loaded
 	bool abort( const std::string &url );
 	//! terminates all running threads and clears the cache. Call before terminating the application.
 	void cleanup();
@@ -69,29 +88,137 @@ class TextureStore {
 	//! returns an empty texture. Override it to supply something else in case a texture was not available.
 	virtual ci::gl::Texture2dRef empty() { return ci::gl::Texture2dRef(); };
 
+	//! keeps the texture for this url resident, even if it is not in use and the budget is exceeded. Can be called before the texture is loaded.
+	void pin( const std::string &url, bool pinned = true );
+	//! returns TRUE if the texture for this url has been pinned
+	bool isPinned( const std::string &url );
+
+	//! sets the maximum number of bytes used by unpinned textures that are not in use by the application
+	void setTextureBudget( size_t bytes );
+	//! sets the maximum number of bytes used by decoded images that have not been turned into textures yet
+	void setSurfaceBudget( size_t bytes );
+
+	//! if enabled (default), mip chains of asynchronously loaded textures are created by the worker threads, so the main thread only uploads them.
+	//! Otherwise, the driver generates them on the main thread when the texture is created.
+	void setWorkerMipmapping( bool enabled = true ) { mWorkerMipmapping = enabled; }
+	bool isWorkerMipmapping() const { return mWorkerMipmapping; }
+
+	//! stores decoded (and scaled down) images in \a directory, so they don't have to be downloaded and decoded again
+	//! in the next session. Uses at most \a maxBytes of disk space.
+	void enableDiskCache( const ci::fs::path &directory, size_t maxBytes = 1024 * 1024 * 1024 );
+	void disableDiskCache();
+	//! returns the disk cache, or an empty reference if it is disabled
+	DiskCacheRef getDiskCache() const { return std::atomic_load( &mDiskCache ); }
+
+  protected:
+	struct Request;
+	typedef std::shared_ptr<Request> RequestRef;
+
+  public:
+	struct Stats {
+		//! number of requests for which the texture was available
+		size_t hits;
+		//! number of requests for which the image had to be loaded
+		size_t misses;
+		//! number of textures created from asynchronously loaded images, and the time the main thread spent creating them
+		size_t created;
+		double createSeconds;
+		//! number of images loaded from and missing in the disk cache
+		size_t diskHits;
+		size_t diskMisses;
+
+		LruCache<std::string, ci::gl::Texture2dRef>::Stats textures;
+		LruCache<std::string, MipChain>::Stats             surfaces;
+
+		//! lock contention on the list of loading images, which is shared by all loader threads
+		ConcurrentMap<std::string, RequestRef>::Stats loading;
+	};
+
+	//! returns hit and miss counters, as well as the evictions and memory in use of both caches
+	Stats getStats();
+	//! resets the hit, miss and eviction counters
+	void resetStats();
+
   protected:
 	volatile bool isInterrupted;
 
-	//! list of created Textures
-	std::map<std::string, std::weak_ptr<ci::gl::Texture2d>> mTextures;
+	//! list of created Textures, including the ones that have been evicted from the cache but are still in use
+	std::unordered_map<std::string, std::weak_ptr<ci::gl::Texture2d>> mTextures;
+	//! keeps recently used Textures alive, up to a budget
+	LruCache<std::string, ci::gl::Texture2dRef> mTextureCache;
+
+	//! queue of textures to load asynchronously, highest priority first
+	ConcurrentPriorityQueue<std::string> mQueue;
+
+	//! describes how an image should be loaded, and allows the main thread to cancel it
+	struct Request {
+		Request( const ci::ivec2 &size, bool mipmap )
+		    : mCancelled( false )
+		    , mSize( size )
+		    , mMipmap( mipmap ){};
+
+		std::atomic<bool> mCancelled;
+		ci::ivec2         mSize;
+		bool              mMipmap;
+	};
+
+	//! images that are queued, being loaded or waiting to be turned into a Texture2d
+	ConcurrentMap<std::string, RequestRef> mLoading;
+
+	//!	container for the asynchronously loaded surfaces, up to a budget
+	LruCache<std::string, MipChain> mSurfaces;
+	std::mutex                      mSurfacesMutex;
 
-	//! queue of textures to load asynchronously
-	ConcurrentDeque<std::string> mQueue;
-	ConcurrentDeque<std::string> mLoadingQueue;
+	//! urls of the textures that should stay resident, protected by mSurfacesMutex
+	std::unordered_set<std::string> mPinned;
 
-	//!	container for the asynchronously loaded surfaces
-	ConcurrentMap<std::string, ci::Surface> mSurfaces;
+	size_t mHits;
+	size_t mMisses;
+	size_t mCreated;
+	double mCreateSeconds;
 
-	//! one or more worker threads
-	TextureStoreThreadPool mThreads;
-	std::atomic<bool>      mShouldQuit;
+	std::atomic<bool> mWorkerMipmapping;
+
+	//! optional cache of decoded images, accessed atomically because the worker threads use it
+	DiskCacheRef        mDiskCache;
+	std::atomic<size_t> mDiskHits;
+	std::atomic<size_t> mDiskMisses;
+
+	//! number of loading tasks submitted to the TaskScheduler that have not finished yet
+	std::atomic<int>  mActiveTasks;
+	std::atomic<bool> mShouldQuit;
 
   private:
-	//! loads files in a separate thread and creates Surfaces. These are then passed to the main thread and turned into Textures.
-	void threadLoad();
+	//! loads the queued image with the highest priority and creates Surfaces. Runs as a TaskScheduler task.
+	//! The Surfaces are then passed to the main thread and turned into Textures.
+	void loadNext();
+
+	//! Marks the image as loading, returns FALSE if it already was.
+	bool beginLoading( const std::string &url, const ci::ivec2 &size, bool mipmap );
+	//! Marks the image as no longer loading. If \a request is given, only does so if it is still the current request.
+	void endLoading( const std::string &url, const RequestRef &request = RequestRef() );
+	//! Returns the request for this image, or an empty request if the image is not loading (anymore).
+	RequestRef getRequest( const std::string &url );
 
 	//! Creates the actual texture and defines a custom deleter for it.
 	ci::gl::Texture2dRef storeTexture( const std::string &url, const ci::gl::Texture2dRef &src );
+	//! Returns the texture if it is still in the cache or in use, otherwise returns an empty texture.
+	ci::gl::Texture2dRef findTexture( const std::string &url );
+	//! Moves the decoded surface out of the cache, if available.
+	bool takeSurface( const std::string &url, MipChain &chain );
+	//! Stores a decoded surface and evicts surfaces if the budget is exceeded.
+	void storeSurface( const std::string &url, MipChain &chain );
+	//! Uploads a decoded surface and its mip levels, if any.
+	ci::gl::Texture2dRef createTexture( const std::string &url, const MipChain &chain, ci::gl::Texture2d::Format fmt );
+	//! Evicts textures if the budget is exceeded.
+	void trimTextures();
+
+	//! Returns the disk cache key for an image, which depends on how it was processed.
+	static std::string getDiskCacheKey( const std::string &url, const ci::ivec2 &size, bool mipmap );
+
+	//! Returns the (estimated) amount of memory used by a texture or surface.
+	static size_t getMemorySize( const ci::gl::Texture2dRef &texture );
+	static size_t getMemorySize( const MipChain &chain );
 };
 
 // helper functions for easier access
@@ -103,9 +230,9 @@ inline ci::gl::Texture2dRef loadTexture( const std::string &url, ci::gl::Texture
 };
 
 //! asynchronously loads an image into a texture, returns immediately
-inline ci::gl::Texture2dRef fetchTexture( const std::string &url, ci::gl::Texture2d::Format fmt = ci::gl::Texture2d::Format() )
+inline ci::gl::Texture2dRef fetchTexture( const std::string &url, ci::gl::Texture2d::Format fmt = ci::gl::Texture2d::Format(), float priority = 0.0f, const ci::ivec2 &size = ci::ivec2( 0 ) )
 {
-	return TextureStore::getInstance().fetch( url, fmt );
+	return TextureStore::getInstance().fetch( url, fmt, priority, size );
 };
 
 } // namespace ph
\ No newline at end of file
@@ -21,18 +21,82 @@
  */
 
 #include "cinder/CinderMath.h"
+#include "cinder/Timer.h"
 #include "cinder/Xml.h"
+#include "cinder/Utilities.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/Texture.h"
 #include "cinder/gl/gl.h"
 
+#include "ph/ConcurrentDeque.h"
+#include "ph/ConcurrentQueue.h"
+#include "ph/ConcurrentRing.h"
 #include "ph/TextureStore.h"
 
+#include <algorithm>
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
+namespace {
+
+//! Measures the throughput of a queue, in millions of items per second. Half of the threads push \a count items
+//! in total, the other half pops them. With a single thread, it alternately pushes and pops.
+template <typename Push, typename Pop>
+double benchmarkQueue( int numThreads, size_t count, Push push, Pop pop )
+{
+	Timer timer( true );
+
+	if( numThreads < 2 ) {
+		size_t value;
+		for( size_t i = 0; i < count; ++i ) {
+			while( !push( i ) )
+				std::this_thread::yield();
+			while( !pop( value ) )
+				std::this_thread::yield();
+		}
+	}
+	else {
+		const int producers = numThreads / 2;
+		const int consumers = numThreads - producers;
+
+		std::atomic<size_t> popped( 0 );
+		vector<std::thread> threads;
+
+		for( int i = 0; i < producers; ++i ) {
+			threads.emplace_back( [&, i]() {
+				const size_t first = count * i / producers;
+				const size_t last = count * ( i + 1 ) / producers;
+				for( size_t value = first; value < last; ++value ) {
+					while( !push( value ) )
+						std::this_thread::yield();
+				}
+			} );
+		}
+
+		for( int i = 0; i < consumers; ++i ) {
+			threads.emplace_back( [&]() {
+				size_t value;
+				while( popped < count ) {
+					if( pop( value ) )
+						popped++;
+					else
+						std::this_thread::yield();
+				}
+			} );
+		}
+
+		for( auto &thread : threads )
+			thread.join();
+	}
+
+	return count / timer.getSeconds() * 1.0e-6;
+}
+
+} // namespace
+
 class FlickrImageViewerApp : public App {
   public:
 	static void prepare( Settings *settings );
@@ -48,14 +112,29 @@ class FlickrImageViewerApp : public App {
 
 	void keyDown( KeyEvent event );
 
+	//! compares the lock-free ConcurrentRing with the mutex-based queues, using 1 to 32 threads
+	void benchmarkQueues();
+
+	//! requests the upcoming images, and aborts loading the ones that are no longer coming up
+	void prefetch();
+	//! images are loaded in the order they will be shown, the next one (\a offset 0) first
+	float getPriority( size_t offset ) const { return float( kNumPrefetched - offset ); }
+
   protected:
+	//! number of upcoming images to load in the background, including the next one
+	static const size_t kNumPrefetched = 4;
+
 	vector<string> mUrls;
+	//! urls of the upcoming images that have been requested by prefetch()
+	vector<string> mPrefetched;
 
 	gl::TextureRef mFront;
 	gl::TextureRef mBack;
 
 	size_t mIndex;
 
+	gl::Texture2d::Format mFormat;
+
 	double mTimeSwapped;
 	double mTimeView;
 	double mTimeFade;
@@ -91,6 +170,13 @@ void FlickrImageViewerApp::setup()
 
 	// toggle this using the 'A' key to see the advantage of asynchronous loading
 	mAsynchronous = true;
+
+	// use mipmapping, because the images are zoomed. Press 'M' to toggle whether the loader
+	// threads or the driver creates the mip chain, and 'S' to compare the time spent on the main thread.
+	mFormat = gl::Texture2d::Format().mipmap().minFilter( GL_LINEAR_MIPMAP_LINEAR );
+
+	// keep decoded images on disk, so they load a lot faster the next time the application is run
+	ph::TextureStore::getInstance().enableDiskCache( getTemporaryDirectory() / "FlickrImageViewer", 512 * 1024 * 1024 );
 }
 
 void FlickrImageViewerApp::cleanup()
@@ -99,6 +185,7 @@ void FlickrImageViewerApp::cleanup()
 	// an issue in Visual Studio that forces us to manually terminate it before application shutdown.
 	// See: http://stackoverflow.com/questions/10915233/stdthreadjoin-hangs-if-called-after-main-exits-when-using-vs2012-rc
 	ph::TextureStore::getInstance().cleanup();
+	ph::TaskScheduler::getInstance().shutdown();
 }
 
 void FlickrImageViewerApp::update()
@@ -123,6 +210,8 @@ void FlickrImageViewerApp::update()
 		// make sure we actually have something to show
 		if( mUrls.empty() )
 			return;
+
+		prefetch();
 	}
 
 	// calculate elapsed time in seconds (since last swap)
@@ -133,13 +222,13 @@ void FlickrImageViewerApp::update()
 		if( mAsynchronous ) {
 			// load the texture asynchronously using the TextureManager. The call
 			// will return an empty texture if not ready yet.
-			mFront = ph::fetchTexture( mUrls[mIndex] );
+			mFront = ph::fetchTexture( mUrls[mIndex], mFormat, getPriority( 0 ) );
 		}
 		else {
 			// load the texture synchronously using the TextureManager. The call
 			// will load and return the texture, but your application will have
 			// to wait for it to finish. Returns empty texture if load did not succeed.
-			mFront = ph::loadTexture( mUrls[mIndex] );
+			mFront = ph::loadTexture( mUrls[mIndex], mFormat );
 		}
 
 		// if texture was loaded...
@@ -148,6 +237,7 @@ void FlickrImageViewerApp::update()
 			mTimeSwapped = getElapsedSeconds();
 			// proceed to next texture
 			mIndex = ( mIndex + 1 ) % mUrls.size();
+			prefetch();
 		}
 	}
 	else if( elapsed > mTimeFade ) {
@@ -155,13 +245,13 @@ void FlickrImageViewerApp::update()
 			// as soon as the front image has been faded in,
 			// start loading the back image asynchronously using the TextureManager.
 			// The call will return an empty texture while not ready yet.
-			mBack = ph::fetchTexture( mUrls[mIndex] );
+			mBack = ph::fetchTexture( mUrls[mIndex], mFormat, getPriority( 0 ) );
 		}
 		else {
 			// load the texture synchronously using the TextureManager. The call
 			// will load and return the texture, but your application will have
 			// to wait for it to finish. Returns empty texture if load did not succeed.
-			mBack = ph::loadTexture( mUrls[mIndex] );
+			mBack = ph::loadTexture( mUrls[mIndex], mFormat );
 		}
 
 		// if texture has been loaded and enough time has passed...
@@ -177,6 +267,7 @@ void FlickrImageViewerApp::update()
 			mTimeSwapped = getElapsedSeconds();
 			// proceed to next texture
 			mIndex = ( mIndex + 1 ) % mUrls.size();
+			prefetch();
 		}
 	}
 }
@@ -244,13 +335,95 @@ void FlickrImageViewerApp::keyDown( KeyEvent event )
 		else
 			console() << "Asynchronous loading DISABLED." << std::endl;
 		break;
+	case KeyEvent::KEY_m: {
+		// toggle creation of the mip chain by the loader threads
+		auto &store = ph::TextureStore::getInstance();
+		store.setWorkerMipmapping( !store.isWorkerMipmapping() );
+		store.resetStats();
+		console() << "Mip chains created by " << ( store.isWorkerMipmapping() ? "loader threads." : "the driver." ) << std::endl;
+	} break;
 	case KeyEvent::KEY_f:
 		// toggle full screen
 		setFullScreen( !isFullScreen() );
 		break;
+	case KeyEvent::KEY_q:
+		benchmarkQueues();
+		break;
+	case KeyEvent::KEY_RIGHT:
+		// skip the next image, which aborts loading it if it was still queued
+		if( !mUrls.empty() ) {
+			mIndex = ( mIndex + 1 ) % mUrls.size();
+			prefetch();
+		}
+		break;
+	case KeyEvent::KEY_LEFT:
+		// go back one image, which gives it the highest priority
+		if( !mUrls.empty() ) {
+			mIndex = ( mIndex + mUrls.size() - 1 ) % mUrls.size();
+			prefetch();
+		}
+		break;
 	case KeyEvent::KEY_v:
 		gl::enableVerticalSync( !gl::isVerticalSyncEnabled() );
 		break;
+	case KeyEvent::KEY_s: {
+		// print cache statistics
+		const auto stats = ph::TextureStore::getInstance().getStats();
+		console() << "Hits: " << stats.hits << ", misses: " << stats.misses << std::endl;
+		if( stats.created > 0 )
+			console() << "Created " << stats.created << " textures, " << ( stats.createSeconds * 1000.0 / stats.created ) << " ms per texture on the main thread." << std::endl;
+		console() << "Textures: " << stats.textures.count << " (" << stats.textures.bytes << " bytes), " << stats.textures.evictions << " evicted." << std::endl;
+		console() << "Surfaces: " << stats.surfaces.count << " (" << stats.surfaces.bytes << " bytes), " << stats.surfaces.evictions << " evicted." << std::endl;
+		console() << "Loading list: " << stats.loading.locks << " locks, " << stats.loading.contended << " contended." << std::endl;
+		if( auto diskCache = ph::TextureStore::getInstance().getDiskCache() )
+			console() << "Disk cache: " << stats.diskHits << " hits, " << stats.diskMisses << " misses (" << diskCache->getSize() << " bytes)." << std::endl;
+	} break;
+	}
+}
+
+void FlickrImageViewerApp::prefetch()
+{
+	if( !mAsynchronous || mUrls.empty() )
+		return;
+
+	auto &store = ph::TextureStore::getInstance();
+
+	vector<string> upcoming;
+	for( size_t i = 0; i < std::min( size_t( kNumPrefetched ), mUrls.size() ); ++i )
+		upcoming.push_back( mUrls[( mIndex + i ) % mUrls.size()] );
+
+	// images that we skipped don't have to be loaded anymore. This has no effect on images that have already been loaded.
+	for( auto &url : mPrefetched ) {
+		if( std::find( upcoming.begin(), upcoming.end(), url ) == upcoming.end() )
+			store.abort( url );
+	}
+
+	// images that are still queued move up as they come closer, others are requested
+	for( size_t i = 0; i < upcoming.size(); ++i ) {
+		if( !store.prioritize( upcoming[i], getPriority( i ) ) )
+			store.fetch( upcoming[i], mFormat, getPriority( i ) );
+	}
+
+	mPrefetched.swap( upcoming );
+}
+
+void FlickrImageViewerApp::benchmarkQueues()
+{
+	const size_t count = 1000000;
+
+	console() << "Queue throughput (million items per second):" << std::endl;
+	console() << "threads\tring\tqueue\tdeque" << std::endl;
+
+	for( int numThreads = 1; numThreads <= 32; numThreads *= 2 ) {
+		ph::ConcurrentRing<size_t>  ring( 1024 );
+		ph::ConcurrentQueue<size_t> queue;
+		ph::ConcurrentDeque<size_t> deque;
+
+		const double ringRate = benchmarkQueue( numThreads, count, [&]( size_t value ) { return ring.try_push( std::move( value ) ); }, [&]( size_t &value ) { return ring.try_pop( value ); } );
+		const double queueRate = benchmarkQueue( numThreads, count, [&]( size_t value ) { queue.push( value ); return true; }, [&]( size_t &value ) { return queue.try_pop( value ); } );
+		const double dequeRate = benchmarkQueue( numThreads, count, [&]( size_t value ) { return deque.push_back( value ); }, [&]( size_t &value ) { return deque.pop_front( value ); } );
+
+		console() << numThreads << "\t" << ringRate << "\t" << queueRate << "\t" << dequeRate << std::endl;
 	}
 }
 
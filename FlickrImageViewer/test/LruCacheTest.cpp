@@ -0,0 +1,114 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Checks the byte accounting of ph::LruCache. The cache is header-only, so the test can be built without Cinder:
+//
+//   g++ -std=c++11 -I../include LruCacheTest.cpp -o LruCacheTest
+//
+// Exits with a non-zero status if any of the checks fail.
+
+#include "ph/LruCache.h"
+
+#include <iostream>
+#include <string>
+
+namespace {
+
+int sFailures = 0;
+
+void check( bool condition, const char *description )
+{
+	if( !condition ) {
+		std::cerr << "FAILED: " << description << std::endl;
+		sFailures++;
+	}
+}
+
+typedef ph::LruCache<int, std::string> Cache;
+
+void testEviction()
+{
+	Cache cache( 100 );
+	cache.insert( 1, "a", 40 );
+	cache.insert( 2, "b", 40 );
+	cache.insert( 3, "c", 40 );
+
+	check( cache.trim() == 1, "trim evicts one entry" );
+	check( !cache.contains( 1 ), "trim evicts the least recently used entry" );
+	check( cache.bytes() == 80, "bytes after trim" );
+}
+
+void testPinnedEntriesAreNotEvicted()
+{
+	Cache cache( 100 );
+	cache.insert( 1, "a", 80 );
+	cache.pin( 1 );
+	cache.insert( 2, "b", 80 );
+
+	check( cache.trim() == 0, "pinned bytes do not count towards the budget" );
+
+	cache.pin( 1, false );
+	check( cache.trim() == 1 && cache.contains( 1 ), "unpinned entry counts again and is most recently used" );
+	check( cache.bytes() == 80, "bytes after unpinning and trim" );
+}
+
+void testReplacePinnedEntry()
+{
+	Cache cache( 100 );
+	cache.insert( 1, "a", 10 );
+	cache.pin( 1 );
+
+	// replacing a pinned entry keeps it pinned, so its new size must not count towards the budget
+	cache.insert( 1, "aaaaa", 50 );
+	check( cache.isPinned( 1 ), "replaced entry stays pinned" );
+	check( cache.bytes() == 50, "bytes after replacing a pinned entry" );
+
+	cache.insert( 2, "b", 80 );
+	check( cache.trim() == 0, "trim keeps an unpinned entry that fits the budget" );
+	check( cache.contains( 2 ), "unpinned entry is still cached" );
+
+	check( cache.erase( 1 ), "erase the pinned entry" );
+	check( cache.bytes() == 80, "bytes after erasing the pinned entry" );
+
+	// if the pinned bytes had drifted, they would wrap around here and trim would never evict
+	cache.insert( 3, "c", 40 );
+	check( cache.trim() == 1 && !cache.contains( 2 ), "trim evicts after erasing the pinned entry" );
+	check( cache.bytes() == 40, "bytes after final trim" );
+}
+
+} // namespace
+
+int main()
+{
+	testEviction();
+	testPinnedEntriesAreNotEvicted();
+	testReplacePinnedEntry();
+
+	if( sFailures > 0 ) {
+		std::cerr << sFailures << " check(s) failed." << std::endl;
+		return 1;
+	}
+
+	std::cout << "All checks passed." << std::endl;
+	return 0;
+}
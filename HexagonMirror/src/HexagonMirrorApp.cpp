@@ -35,6 +35,8 @@
 #include "cinder/gl/Vbo.h"
 #include "cinder/gl/gl.h"
 
+#include "FrustumCuller.h"
+
 using namespace ci;
 using namespace ci::app;
 using namespace std;
@@ -71,6 +73,8 @@ class HexagonMirrorApp : public App {
 	void loadMesh();
 	// creates a Vertex Array Object containing a transform matrix for each instance
 	void initializeBuffer();
+	// copies the transform matrices of the hexagons inside the view frustum to the instance buffer
+	void uploadVisibleInstances();
 
   private:
 	// our controlable camera
@@ -84,9 +88,20 @@ class HexagonMirrorApp : public App {
 	// Batch that combines the mesh and shader
 	gl::BatchRef mBatch;
 
-	// a VBO containing a list of matrices, one for every instance
+	// a VBO containing a list of matrices, one for every visible instance
 	gl::VboRef mInstanceDataVbo;
 
+	// the transform matrix and world space bounding box of every instance
+	std::vector<mat4> mMatrices;
+	ph::BoundingBoxes mBounds;
+	// bounding box of a single hexagon
+	AxisAlignedBox mHexagonBounds;
+
+	// indices of the instances inside the view frustum, and of the ones currently in the VBO
+	std::vector<uint32_t> mVisible;
+	std::vector<uint32_t> mUploaded;
+	bool                  mCulling;
+
 	CaptureRef       mCapture;
 	gl::Texture2dRef mCaptureTexture;
 
@@ -107,6 +122,8 @@ void HexagonMirrorApp::setup()
 	mCamera.lookAt( vec3( 90, 69, 380 ), vec3( 90, 69, 0 ) );
 	mCameraUi.setCamera( &mCamera );
 
+	mCulling = true;
+
 	// load shader
 	try {
 		mShader = gl::GlslProg::create( loadAsset( "phong.vert" ), loadAsset( "phong.frag" ) );
@@ -168,9 +185,12 @@ void HexagonMirrorApp::draw()
 		mShader->uniform( "uTexture", 0 );
 		mShader->uniform( "uScale", vec2( 1.0f / ( 3.0f * INSTANCES_PER_ROW ), 1.0f / ( 2.25f * INSTANCES_PER_ROW ) ) );
 
+		// only upload the instances inside the view frustum
+		uploadVisibleInstances();
+
 		// we do all positioning in the shader, and therefor we only need
 		// a single draw call to render all instances.
-		mBatch->drawInstanced( NUM_INSTANCES );
+		mBatch->drawInstanced( GLsizei( mUploaded.size() ) );
 	}
 
 	// restore 2D drawing
@@ -184,6 +204,14 @@ void HexagonMirrorApp::loadMesh()
 	try {
 		TriMeshRef mesh = TriMesh::create( loader );
 		mVboMesh = gl::VboMesh::create( *mesh );
+
+		// The shader rotates each hexagon around its x-axis, so enlarge the bounds
+		// to contain the hexagon at any angle.
+		AxisAlignedBox bounds = mesh->calcBoundingBox();
+		vec3           lo = bounds.getMin();
+		vec3           hi = bounds.getMax();
+		float          radius = glm::length( glm::max( glm::abs( vec2( lo.y, lo.z ) ), glm::abs( vec2( hi.y, hi.z ) ) ) );
+		mHexagonBounds = AxisAlignedBox( vec3( lo.x, -radius, -radius ), vec3( hi.x, radius, radius ) );
 	}
 	catch( const std::exception &e ) {
 		console() << e.what() << std::endl;
@@ -205,9 +233,12 @@ void HexagonMirrorApp::initializeBuffer()
 	//
 	// See for more information: http://ogldev.atspace.co.uk/www/tutorial33/tutorial33.html
 
-	// initialize transforms for every instance
-	std::vector<mat4> matrices;
-	matrices.reserve( NUM_INSTANCES );
+	// initialize transforms and bounds for every instance
+	mMatrices.clear();
+	mMatrices.reserve( NUM_INSTANCES );
+
+	mBounds.clear();
+	mBounds.reserve( NUM_INSTANCES );
 
 	for( size_t i = 0; i < NUM_INSTANCES; ++i ) {
 		// determine position for this hexagon
@@ -216,11 +247,16 @@ void HexagonMirrorApp::initializeBuffer()
 
 		// create transform matrix, then rotate and translate it
 		mat4 model = glm::translate( vec3( 3.0f * x + 1.5f * math<float>::fmod( y, 2.0f ), 0.866025f * y, 0.0f ) );
-		matrices.push_back( model );
+		mMatrices.push_back( model );
+		mBounds.push_back( model, mHexagonBounds );
 	}
 
-	// create array buffer to store model matrices
-	mInstanceDataVbo = gl::Vbo::create( GL_ARRAY_BUFFER, matrices.size() * sizeof( mat4 ), matrices.data(), GL_STATIC_DRAW );
+	// create array buffer to store model matrices. The contents will change when the camera moves.
+	mInstanceDataVbo = gl::Vbo::create( GL_ARRAY_BUFFER, mMatrices.size() * sizeof( mat4 ), mMatrices.data(), GL_DYNAMIC_DRAW );
+
+	mUploaded.resize( mMatrices.size() );
+	for( size_t i = 0; i < mUploaded.size(); ++i )
+		mUploaded[i] = uint32_t( i );
 
 	// setup the buffer to contain space for all matrices. Each matrix needs 16 floats.
 	geom::BufferLayout instanceDataLayout;
@@ -231,6 +267,30 @@ void HexagonMirrorApp::initializeBuffer()
 	mBatch = gl::Batch::create( mVboMesh, mShader, { { geom::CUSTOM_0, "iModelMatrix" } } );
 }
 
+void HexagonMirrorApp::uploadVisibleInstances()
+{
+	if( mCulling ) {
+		ph::FrustumCuller culler( mCamera );
+		culler.cull( mBounds, mVisible );
+	}
+	else {
+		mVisible.resize( mMatrices.size() );
+		for( size_t i = 0; i < mVisible.size(); ++i )
+			mVisible[i] = uint32_t( i );
+	}
+
+	// the hexagons don't move, so we only have to upload when the camera has changed what is visible
+	if( mVisible == mUploaded )
+		return;
+
+	mat4 *ptr = static_cast<mat4 *>( mInstanceDataVbo->mapReplace() );
+	for( uint32_t index : mVisible )
+		*ptr++ = mMatrices[index];
+	mInstanceDataVbo->unmap();
+
+	mUploaded.swap( mVisible );
+}
+
 void HexagonMirrorApp::resize()
 {
 	// adjust the camera aspect ratio
@@ -258,6 +318,10 @@ void HexagonMirrorApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_ESCAPE:
 		quit();
 		break;
+	case KeyEvent::KEY_c:
+		// toggle frustum culling
+		mCulling = !mCulling;
+		break;
 	case KeyEvent::KEY_f:
 		// toggle full screen
 		setFullScreen( !isFullScreen() );
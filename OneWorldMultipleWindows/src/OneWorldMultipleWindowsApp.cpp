@@ -23,6 +23,7 @@
 #include "cinder/Camera.h"
 #include "cinder/Log.h"
 #include "cinder/Rand.h"
+#include "cinder/Timer.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/GlslProg.h"
@@ -45,15 +46,28 @@ class OneWorldMultipleWindowsApp : public App {
 
 	void resize();
 
+  private:
+	//! Adjusts the \a camera, so that it shows the part of the display covered by a window.
+	void setupCamera( CameraPersp &camera, const vec2 &windowPos, const vec2 &windowSize, const vec2 &displaySize ) const;
+	//! Measures the CPU time spent on the pistons each frame for an increasing number of windows.
+	void benchmark();
+
   private:
 	CameraPersp mCamera;
 	double      mTime;
+
+	Pistons mPistons;
+	bool    mCulling;
 };
 
 void OneWorldMultipleWindowsApp::setup()
 {
 	mCamera.setPerspective( 30.0f, 1.0f, 0.1f, 10000.0f );
 	mCamera.lookAt( vec3( 0, 0, 5000 ), vec3( 0, 0, 0 ) );
+
+	// All windows show the same world, so we only need to simulate it once
+	mPistons.setup();
+	mCulling = true;
 }
 
 void OneWorldMultipleWindowsApp::update()
@@ -74,13 +88,8 @@ void OneWorldMultipleWindowsApp::update()
 
 	mCamera.lookAt( vec3( x, y, z ), vec3( 1, 50, 0 ) );
 
-	// Animate our pistons
-	for( size_t i = 0; i < getNumWindows(); ++i ) {
-		auto window = app::getWindowIndex( i );
-		auto pistons = window->getUserData<Pistons>();
-		if( pistons )
-			pistons->update( mCamera, (float)mTime );
-	}
+	// Animate and sort our pistons. Each window will upload the result in draw().
+	mPistons.simulate( mCamera, (float)mTime );
 }
 
 void OneWorldMultipleWindowsApp::draw()
@@ -89,33 +98,90 @@ void OneWorldMultipleWindowsApp::draw()
 	gl::ScopedViewport scpViewport( ivec2( 0 ), getWindowSize() );
 
 	// We are going to use the whole display to render our scene.
-	vec2 displaySize( getDisplay()->getSize() );
+	setupCamera( mCamera, vec2( getWindowPos() ), vec2( getWindowSize() ), vec2( getDisplay()->getSize() ) );
+
+	// Draw our scene. Each window only uploads and draws the pistons that are
+	// inside its view frustum, so adding windows does not multiply the work.
+
+	gl::clear();
+
+	auto renderer = getWindow()->getUserData<PistonsRenderer>();
+	if( renderer ) {
+		renderer->upload( mPistons, mCamera, mCulling );
+		renderer->draw( mCamera );
+	}
+}
+
+void OneWorldMultipleWindowsApp::setupCamera( CameraPersp &camera, const vec2 &windowPos, const vec2 &windowSize, const vec2 &displaySize ) const
+{
 	vec2 displayCenter = displaySize * 0.5f;
 
 	// Each window will be literally a window into our scene. This is made easy
 	// by the lens shift functions of the camera. We also need to set the correct
 	// vertical field of view and of course the aspect ratio of each window.
-	vec2 windowPos( getWindowPos() );
-	vec2 windowSize( getWindowSize() );
 	vec2 windowCenter = windowPos + windowSize * 0.5f;
 
 	const float fov = glm::radians( 30.0f );
 	float       lensShiftX = 2.0f * ( windowCenter.x - displayCenter.x ) / windowSize.x;
 	float       lensShiftY = 2.0f * ( displayCenter.y - windowCenter.y ) / windowSize.y;
-	mCamera.setAspectRatio( windowSize.x / windowSize.y );
-	mCamera.setFov( 2.0f * glm::degrees( glm::atan( windowSize.y / displaySize.y * glm::tan( 0.5f * fov ) ) ) );
-	mCamera.setLensShift( lensShiftX, lensShiftY );
-
-	// Draw our scene. Note: if possible, try to only draw what is visible in
-	// your window, by properly culling objects against the camera's view frustum.
-	// This is beyond the scope of the sample. See the FrustumCulling sample
-	// for more information.
-
-	gl::clear();
+	camera.setAspectRatio( windowSize.x / windowSize.y );
+	camera.setFov( 2.0f * glm::degrees( glm::atan( windowSize.y / displaySize.y * glm::tan( 0.5f * fov ) ) ) );
+	camera.setLensShift( lensShiftX, lensShiftY );
+}
 
-	auto pistons = getWindow()->getUserData<Pistons>();
-	if( pistons )
-		pistons->draw( mCamera );
+void OneWorldMultipleWindowsApp::benchmark()
+{
+	// Compares updating a separate Pistons instance for every window, like this sample used to do, with simulating
+	// the pistons once and copying the visible ones for each window. Only CPU time is measured, the copy to a
+	// scratch buffer standing in for the upload.
+	static const int kGridSizes[] = { 11, 100, 317 };
+	static const int kFrames = 30;
+
+	const vec2 displaySize( getDisplay()->getSize() );
+	const vec2 windowSize( 640, 480 );
+	const int  columns = math<int>::max( 1, int( displaySize.x / windowSize.x ) );
+	const int  rows = math<int>::max( 1, int( displaySize.y / windowSize.y ) );
+
+	console() << "Benchmarking CPU time per frame:" << std::endl;
+	console() << "pistons	windows	per window (ms)	shared (ms)	visible" << std::endl;
+
+	for( int gridSize : kGridSizes ) {
+		Pistons pistons;
+		pistons.setup( gridSize );
+
+		std::vector<Piston> scratch( pistons.getCount() );
+		PistonsRenderer     culler;
+
+		for( int numWindows = 1; numWindows <= 16; numWindows *= 2 ) {
+			// Tile the windows across the display, like a user would
+			std::vector<CameraPersp> cameras( numWindows, mCamera );
+			for( int i = 0; i < numWindows; ++i ) {
+				const vec2 windowPos( ( i % columns ) * windowSize.x, ( ( i / columns ) % rows ) * windowSize.y );
+				setupCamera( cameras[i], windowPos, windowSize, displaySize );
+			}
+
+			Timer timer( true );
+			for( int frame = 0; frame < kFrames; ++frame ) {
+				const float time = float( mTime + frame / 60.0 );
+				for( const auto &camera : cameras )
+					pistons.simulate( camera, time );
+			}
+			const double separate = timer.getSeconds() / kFrames;
+
+			size_t visible = 0;
+			timer.start();
+			for( int frame = 0; frame < kFrames; ++frame ) {
+				const float time = float( mTime + frame / 60.0 );
+				pistons.simulate( mCamera, time );
+				for( const auto &camera : cameras )
+					visible += culler.copyVisible( pistons, camera, scratch.data() );
+			}
+			const double shared = timer.getSeconds() / kFrames;
+
+			console() << pistons.getCount() << "\t" << numWindows << "\t" << 1000.0 * separate << "\t" << 1000.0 * shared << "\t";
+			console() << visible / ( kFrames * numWindows ) << std::endl;
+		}
+	}
 }
 
 void OneWorldMultipleWindowsApp::keyDown( KeyEvent event )
@@ -124,6 +190,12 @@ void OneWorldMultipleWindowsApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_ESCAPE:
 		quit();
 		break;
+	case KeyEvent::KEY_b:
+		benchmark();
+		break;
+	case KeyEvent::KEY_c:
+		mCulling = !mCulling;
+		break;
 	default:
 		// Create a new window
 		app::WindowRef newWindow = createWindow( Window::Format().size( 640, 480 ) );
@@ -136,15 +208,14 @@ void OneWorldMultipleWindowsApp::resize()
 {
 	// Called after a window is created or resized.
 	// Because each window has its own shared OpenGL context,
-	// and the Pistons require a Batch+VBO that can not be shared,
-	// we need to create a separate Pistons instance for each window.
+	// and the renderer requires a Batch that can not be shared,
+	// we need to create a separate renderer for each window.
 	// They will be stored using a shared_ptr, so we don't have to destroy them.
-	auto pistons = getWindow()->getUserData<Pistons>();
-	if( !pistons ) {
-		pistons = new Pistons();
-		pistons->setup();
+	auto renderer = getWindow()->getUserData<PistonsRenderer>();
+	if( !renderer ) {
+		renderer = new PistonsRenderer();
 
-		getWindow()->setUserData( pistons );
+		getWindow()->setUserData( renderer );
 	}
 }
 
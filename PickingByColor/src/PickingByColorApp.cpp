@@ -29,14 +29,97 @@
 #include "cinder/gl/Batch.h"
 #include "cinder/gl/Fbo.h"
 #include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Pbo.h"
 #include "cinder/gl/Shader.h"
+#include "cinder/gl/Sync.h"
 #include "cinder/gl/draw.h"
 #include "cinder/gl/scoped.h"
 
+#include "nodes/Node.h"
+
+#include <algorithm>
+
 using namespace ci;
 using namespace ci::app;
+using namespace ph::nodes;
 using namespace std;
 
+//! A mesh in our little scene graph. It renders its uuid as picking color, so we can find it again using Node::findNode().
+typedef std::shared_ptr<class MeshNode> MeshNodeRef;
+
+class MeshNode : public Node3D {
+  public:
+	MeshNode( const std::string &name, const gl::BatchRef &mesh, const Color &color )
+	    : mName( name )
+	    , mMesh( mesh )
+	{
+		mColor = color;
+	}
+	virtual ~MeshNode( void ) {}
+
+	void draw() override
+	{
+		if( !mMesh )
+			return;
+
+		mMesh->getGlslProg()->uniform( "pickingColor", getUuidColor() );
+
+		gl::ScopedColor color( mColor );
+		mMesh->draw();
+	}
+
+	const std::string &getName() const { return mName; }
+
+	// stream support
+	std::string toString() const override { return "MeshNode: " + mName; }
+
+  protected:
+	std::string  mName;
+	gl::BatchRef mMesh;
+};
+
+//! Counts how often each color occurs in the picking area. Uses a small open-addressing hash table instead of
+//! a std::map, so counting doesn't allocate. Keeps track of the most frequent color while counting.
+class ColorCount {
+  public:
+	ColorCount()
+	    : mMostFrequent( 0 )
+	    , mMaxCount( 0 )
+	{
+		std::fill( mKeys, mKeys + kCapacity, uint32_t( kEmpty ) );
+		std::fill( mCounts, mCounts + kCapacity, 0 );
+	}
+
+	//! counts one pixel of \a color. Colors only use 24 bits, so they never clash with kEmpty. Add at most
+	//! kCapacity / 2 pixels, which keeps the table at most half full and probing short.
+	void add( uint32_t color )
+	{
+		size_t i = ( color * 2654435761u ) >> ( 32 - kBits );
+		while( mKeys[i] != color && mKeys[i] != kEmpty )
+			i = ( i + 1 ) & ( kCapacity - 1 );
+
+		mKeys[i] = color;
+		if( ++mCounts[i] > mMaxCount ) {
+			mMaxCount = mCounts[i];
+			mMostFrequent = color;
+		}
+	}
+
+	uint32_t getMostFrequent() const { return mMostFrequent; }
+	uint32_t getMaxCount() const { return mMaxCount; }
+
+	static const int    kBits = 8;
+	static const size_t kCapacity = 1 << kBits;
+
+  private:
+	static const uint32_t kEmpty = 0xFFFFFFFF;
+
+	uint32_t mKeys[kCapacity];
+	uint32_t mCounts[kCapacity];
+	uint32_t mMostFrequent;
+	uint32_t mMaxCount;
+};
+
 class PickingByColorApp : public App {
   public:
 	static void prepare( Settings *settings );
@@ -58,8 +141,12 @@ class PickingByColorApp : public App {
 
 	//! renders the scene
 	void render();
-	//! samples the color buffer to determine which object is under the mouse
-	std::string pick( const ivec2 &position );
+	//! copies the color buffer around \a position to the next free pixel buffer, without waiting for the result
+	void pick( const ivec2 &position );
+	//! reads back the pixel buffers the GPU has finished writing, to determine which object is under the mouse
+	void resolvePicks();
+	//! returns the name of the object that covers at least half of the \a count pixels
+	std::string identify( const GLubyte *pixels, size_t count ) const;
 	//! loads an OBJ file, writes it to a much faster binary file and loads the mesh
 	void loadMesh( const std::string &objFile, const std::string &meshFile, gl::BatchRef &mesh );
 	//! loads the shaders
@@ -67,40 +154,30 @@ class PickingByColorApp : public App {
 	//! draws a grid on the floor
 	void drawGrid( float size = 100.0f, float step = 10.0f );
 
-  public:
-	// utility functions to translate colors to and from ints or chars
-	static Color charToColor( unsigned char r, unsigned char g, unsigned char b ) { return Color( r / 255.0f, g / 255.0f, b / 255.0f ); };
-
-	static unsigned int charToInt( unsigned char r, unsigned char g, unsigned char b ) { return b + ( g << 8 ) + ( r << 16 ); };
+  protected:
+	//! size of the picking area in pixels
+	static const int kPickSize = 10;
+	//! number of picks that can be in flight, results arrive one or two frames after they were requested
+	static const size_t kNumPickBuffers = 3;
 
-	static Color intToColor( unsigned int i )
-	{
-		unsigned char r = ( i >> 16 ) & 0xFF;
-		unsigned char g = ( i >> 8 ) & 0xFF;
-		unsigned char b = ( i >> 0 ) & 0xFF;
-		return Color( r / 255.0f, g / 255.0f, b / 255.0f );
-	};
+	static_assert( kPickSize * kPickSize <= ColorCount::kCapacity / 2, "picking area too large for ColorCount" );
 
-	static unsigned int colorToInt( const Color &color )
-	{
-		unsigned char r = (unsigned char)( color.r * 255 );
-		unsigned char g = (unsigned char)( color.g * 255 );
-		unsigned char b = (unsigned char)( color.b * 255 );
-		return b + ( g << 8 ) + ( r << 16 );
+	//! a pending read back of the picking area
+	struct PickRequest {
+		gl::PboRef  pbo;
+		gl::SyncRef sync;
 	};
 
-  protected:
 	//! our camera
 	CameraPersp mCamera;
 	CameraUi    mCameraUi;
 
-	//! mesh and picking color of the pitcher object
-	gl::BatchRef mMeshPitcher;
-	Color        mColorPitcher;
+	//! the root of our scene graph, containing the pitcher and the watering can
+	Node3DRef mScene;
 
-	//! mesh and picking color of the watering can object
+	//! meshes of the pitcher and the watering can
+	gl::BatchRef mMeshPitcher;
 	gl::BatchRef mMeshCan;
-	Color        mColorCan;
 
 	//! our Phong shader, which supports multiple targets
 	gl::GlslProgRef mPhongShader;
@@ -110,6 +187,13 @@ class PickingByColorApp : public App {
 	//! our little picking framebuffer (non-AA)
 	gl::FboRef mPickingFbo;
 
+	//! ring of pixel buffers, picks are written at mPickWrite and read back in order at mPickRead
+	PickRequest mPickRequests[kNumPickBuffers];
+	size_t      mPickWrite;
+	size_t      mPickRead;
+	//! name of the object under the mouse, as determined by the most recent pick
+	std::string mPickResult;
+
 	//! keeping track of our cursor position
 	ivec2 mMousePos;
 
@@ -150,11 +234,19 @@ void PickingByColorApp::setup()
 	loadMesh( "models/pitcher.obj", "models/pitcher.msh", mMeshPitcher );
 	loadMesh( "models/watering_can.obj", "models/watering_can.msh", mMeshCan );
 
-	// each object should have a unique picking color.
-	// To make sure the colors are pickable, you should use
-	// the intToColor() and colorToInt() functions.
-	mColorPitcher = intToColor( 0x0000FF ); // blue
-	mColorCan = intToColor( 0x00FF00 );     // green
+	// create the scene graph. Each node has a unique id, which it renders as its picking color.
+	//  Node::findNode() will find it again after we've read the color back (id 0 is never used).
+	mScene = std::make_shared<Node3D>();
+
+	auto pitcher = std::make_shared<MeshNode>( "Pitcher", mMeshPitcher, Color( 0.45f, 0.45f, 0.5f ) );
+	pitcher->setPosition( 10.0f, 0.0f, 0.0f );
+	mScene->addChild( pitcher );
+
+	auto can = std::make_shared<MeshNode>( "Watering Can", mMeshCan, Color( 0.40f, 0.60f, 0.50f ) );
+	can->setPosition( -10.0f, 0.0f, 0.0f );
+	mScene->addChild( can );
+
+	mPickWrite = mPickRead = 0;
 
 	// load font
 	mFont = Font( loadAsset( "font/b2sq.ttf" ), 32 );
@@ -189,10 +281,13 @@ void PickingByColorApp::draw()
 		gl::draw( mPickingFbo->getColorTexture(), rct );
 	}
 
-	// perform picking and display the results
+	// perform picking and display the results of an earlier pick
 	//  (alternatively you can do it in the 'mouseMove' or 'mouseDown' function)
+	pick( mMousePos );
+	resolvePicks();
+
 	gl::ScopedBlendAlpha blend;
-	gl::drawStringCentered( pick( mMousePos ), vec2( 0.5f * getWindowWidth(), getWindowHeight() - 50.0f ), Color::white(), mFont );
+	gl::drawStringCentered( mPickResult, vec2( 0.5f * getWindowWidth(), getWindowHeight() - 50.0f ), Color::white(), mFont );
 }
 
 void PickingByColorApp::mouseMove( MouseEvent event )
@@ -266,9 +361,12 @@ void PickingByColorApp::resize()
 
 void PickingByColorApp::render()
 {
-	// clear background
+	// clear background, and clear the color coded target to id 0
 	gl::clear( mColorBackground );
 
+	const GLfloat noUuid[] = { 0, 0, 0, 0 };
+	glClearBufferfv( GL_COLOR, 1, noUuid );
+
 	// specify the camera matrices
 	gl::pushMatrices();
 	gl::setMatrices( mCamera );
@@ -282,51 +380,36 @@ void PickingByColorApp::render()
 	// draw meshes:
 	// -bind phong shader, which renders to both our color targets.
 	//  See 'shaders/phong.frag'
+	// -each mesh renders its uuid as picking color, see MeshNode::draw()
 	gl::ScopedGlslProg shader( mPhongShader );
-
-	// -draw pitcher
-	{
-		// -each mesh should have a unique picking color that we can use to
-		//  find out which object is under the cursor.
-		mPhongShader->uniform( "pickingColor", mColorPitcher );
-
-		gl::ScopedColor color( 0.45f, 0.45f, 0.5f );
-		gl::pushModelMatrix();
-		gl::translate( 10.0f, 0.0f, 0.0f );
-		mMeshPitcher->draw();
-		gl::popModelMatrix();
-	}
-
-	// -draw can
-	{
-		mPhongShader->uniform( "pickingColor", mColorCan );
-
-		gl::color( 0.40f, 0.60f, 0.50f );
-		gl::pushModelMatrix();
-		gl::translate( -10.0f, 0.0f, 0.0f );
-		mMeshCan->draw();
-		gl::popModelMatrix();
-	}
+	mScene->treeDraw();
 
 	// restore matrices
 	gl::popMatrices();
 }
 
-std::string PickingByColorApp::pick( const ivec2 &position )
+void PickingByColorApp::pick( const ivec2 &position )
 {
 	// this is the main section of the demo:
 	//  here we sample the second color target to find out
 	//  which color is under the cursor.
 
 	// prevent errors if framebuffer does not exist
-	if( !mFbo )
-		return "Error";
+	if( !mFbo ) {
+		mPickResult = "Error";
+		return;
+	}
+
+	// if all pixel buffers are still waiting for the GPU, skip this frame
+	PickRequest &request = mPickRequests[mPickWrite];
+	if( request.sync )
+		return;
 
 	// first, specify a small region around the current cursor position
 	float scaleX = mFbo->getWidth() / (float)getWindowWidth();
 	float scaleY = mFbo->getHeight() / (float)getWindowHeight();
 	ivec2 pixel( (int)( position.x * scaleX ), (int)( ( getWindowHeight() - position.y ) * scaleY ) );
-	Area  area( pixel.x - 5, pixel.y - 5, pixel.x + 5, pixel.y + 5 );
+	Area  area( pixel.x - kPickSize / 2, pixel.y - kPickSize / 2, pixel.x + kPickSize / 2, pixel.y + kPickSize / 2 );
 
 	// next, we need to copy this region to a non-anti-aliased framebuffer
 	//  because sadly we can not sample colors from an anti-aliased one. However,
@@ -361,53 +444,77 @@ std::string PickingByColorApp::pick( const ivec2 &position )
 	// bind the picking framebuffer, so we can read its pixels
 	mPickingFbo->bindFramebuffer();
 
-	// read pixel value(s) in the area
-	GLubyte buffer[400]; // make sure this is large enough to hold 4 bytes for every pixel!
+	// read pixel value(s) in the area into a pixel buffer. Because a pixel buffer is bound, glReadPixels returns
+	//  immediately instead of waiting for the GPU to finish rendering. The fence tells us when the copy is done.
+	if( !request.pbo )
+		request.pbo = gl::Pbo::create( GL_PIXEL_PACK_BUFFER, kPickSize * kPickSize * 4, nullptr, GL_STREAM_READ );
+
+	{
+		gl::ScopedBuffer scpBuffer( request.pbo );
+
+		glReadBuffer( GL_COLOR_ATTACHMENT0_EXT );
+		glReadPixels( 0, 0, mPickingFbo->getWidth(), mPickingFbo->getHeight(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	}
 
-	glReadBuffer( GL_COLOR_ATTACHMENT0_EXT );
-	glReadPixels( 0, 0, mPickingFbo->getWidth(), mPickingFbo->getHeight(), GL_RGBA, GL_UNSIGNED_BYTE, (void *)buffer );
+	request.sync = gl::Sync::create();
 
 	// unbind the picking framebuffer
 	mPickingFbo->unbindFramebuffer();
 
-	// calculate the total number of pixels
-	unsigned int total = ( mPickingFbo->getWidth() * mPickingFbo->getHeight() );
+	mPickWrite = ( mPickWrite + 1 ) % kNumPickBuffers;
+}
+
+void PickingByColorApp::resolvePicks()
+{
+	// picks are read back in the order they were requested, so stop at the first one that isn't done yet
+	while( mPickRequests[mPickRead].sync ) {
+		PickRequest &request = mPickRequests[mPickRead];
 
-	// now that we have the color information, count each occuring color
-	unsigned int color;
+		const GLenum status = request.sync->clientWaitSync( GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		if( status == GL_TIMEOUT_EXPIRED )
+			break;
 
-	std::map<unsigned int, unsigned int> occurences;
-	for( size_t i = 0; i < total; ++i ) {
-		color = charToInt( buffer[( i * 4 ) + 0], buffer[( i * 4 ) + 1], buffer[( i * 4 ) + 2] );
-		occurences[color]++;
-	}
+		request.sync.reset();
+		mPickRead = ( mPickRead + 1 ) % kNumPickBuffers;
 
-	// find the most occuring color by calling std::max_element using a custom comparator.
-	unsigned int max = 0;
+		if( status == GL_WAIT_FAILED )
+			continue;
 
-	auto itr = std::max_element( occurences.begin(), occurences.end(), []( const std::pair<unsigned int, unsigned int> &a, const std::pair<unsigned int, unsigned int> &b ) { return a.second < b.second; } );
+		gl::ScopedBuffer scpBuffer( request.pbo );
 
-	if( itr != occurences.end() ) {
-		color = itr->first;
-		max = itr->second;
+		const GLsizeiptr size = mPickingFbo->getWidth() * mPickingFbo->getHeight() * 4;
+		const GLubyte *  pixels = static_cast<const GLubyte *>( request.pbo->mapBufferRange( 0, size, GL_MAP_READ_BIT ) );
+		if( pixels ) {
+			mPickResult = identify( pixels, size_t( size / 4 ) );
+			request.pbo->unmap();
+		}
 	}
+}
+
+std::string PickingByColorApp::identify( const GLubyte *pixels, size_t count ) const
+{
+	// count each occuring color, the uuid of the object is encoded in its color
+	ColorCount colors;
+	for( size_t i = 0; i < count; ++i )
+		colors.add( Node::colorToUuid( pixels[( i * 4 ) + 0], pixels[( i * 4 ) + 1], pixels[( i * 4 ) + 2] ) );
 
-	// if this color is present in at least 50% of the pixels,
+	// if the most occuring color is present in at least 50% of the pixels,
 	//  we can safely assume that it is indeed belonging to one object
-	if( max >= ( total / 2 ) ) {
-		if( color == colorToInt( mColorCan ) )
-			return "Watering Can";
-		else if( color == colorToInt( mColorPitcher ) )
-			return "Pitcher";
-		else if( color == colorToInt( mColorBackground ) )
-			return "Background";
-		else
-			return "Nothing";
-	}
-	else {
+	if( colors.getMaxCount() < count / 2 ) {
 		// we can't be sure about the color, we probably are on an object's edge
 		return "Uncertain";
 	}
+
+	const uint32_t uuid = colors.getMostFrequent();
+	if( uuid == 0 )
+		return "Background";
+
+	// look up the node with this uuid in the scene graph
+	MeshNodeRef node = std::dynamic_pointer_cast<MeshNode>( Node::findNode( uuid ) );
+	if( node )
+		return node->getName();
+
+	return "Nothing";
 }
 
 void PickingByColorApp::loadMesh( const std::string &objFile, const std::string &meshFile, gl::BatchRef &mesh )
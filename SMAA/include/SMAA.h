@@ -34,6 +34,8 @@ class SMAA {
 	~SMAA() {}
 
 	void setup();
+	//! rebuilds the shaders that have been modified on disk, returns TRUE if any of them was
+	bool reload();
 	void apply( const ci::gl::FboRef &destination, const ci::gl::FboRef &source );
 
 	const ci::gl::Texture2dRef getAreaTex() const { return mAreaTex; }
@@ -50,9 +52,9 @@ class SMAA {
 	ci::gl::FboRef mFboEdgePass;
 	ci::gl::FboRef mFboBlendPass;
 
-	ci::gl::GlslProgRef mSMAAFirstPass;  // edge detection
-	ci::gl::GlslProgRef mSMAASecondPass; // blending weight calculation
-	ci::gl::GlslProgRef mSMAAThirdPass;  // neighborhood blending
+	ShaderRef mSMAAFirstPass;  // edge detection
+	ShaderRef mSMAASecondPass; // blending weight calculation
+	ShaderRef mSMAAThirdPass;  // neighborhood blending
 
 	ci::gl::Texture2dRef mAreaTex;
 	ci::gl::Texture2dRef mSearchTex;
@@ -25,12 +25,18 @@
 #include "cinder/Filesystem.h"
 #include "cinder/gl/GlslProg.h"
 #include <exception>
+#include <map>
 #include <string>
 
 typedef std::shared_ptr<class Shader> ShaderRef;
 
+//! Loads a vertex, fragment and optional geometry shader by name and resolves their #include directives. Parsed files
+//! are memoized by path and modification time, so variants sharing the same includes only read and scan them once,
+//! and linked programs are shared between shaders whose preprocessed sources are identical.
 class Shader {
   public:
+	typedef decltype( ci::fs::last_write_time( ci::fs::path() ) ) FileTime;
+
 	Shader( void );
 	Shader( const std::string &name );
 	~Shader( void );
@@ -38,14 +44,22 @@ class Shader {
 	static ShaderRef create();
 	static ShaderRef create( const std::string &name );
 
-	ci::gl::GlslProg &prog() { return mGlslProg; }
+	const ci::gl::GlslProgRef &prog() const { return mGlslProg; }
+
+	//! returns TRUE if any of the files this shader was built from, including its includes, has changed on disk
+	bool isModified() const;
+	//! rebuilds the shader if it has been modified and returns TRUE if it did. Keeps the current program if compilation fails.
+	bool reload();
+
+	//! forgets all memoized files, so they will be read again on the next load
+	static void clearCache();
 
   protected:
 	const ci::fs::path &getPath() const;
 
 	void        load();
-	std::string parseShader( const ci::fs::path &path, bool optional = true, int level = 0 );
-	std::string parseVersion( const std::string &code );
+	std::string parseShader( const ci::fs::path &path, bool optional = true );
+	void        parseShader( const ci::fs::path &path, bool optional, int level, std::string &output );
 
   private:
 	std::string mName;
@@ -57,6 +71,9 @@ class Shader {
 
 	mutable ci::fs::path mPath;
 
-	unsigned int     mGlslVersion;
-	ci::gl::GlslProg mGlslProg;
+	//! every file read while loading, with its modification time (FileTime() if the file did not exist)
+	std::map<ci::fs::path, FileTime> mDependencies;
+
+	unsigned int        mGlslVersion;
+	ci::gl::GlslProgRef mGlslProg;
 };
\ No newline at end of file
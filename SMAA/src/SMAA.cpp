@@ -34,9 +34,9 @@ using namespace std;
 void SMAA::setup()
 {
 	// Load and compile our shaders
-	mSMAAFirstPass = gl::GlslProg::create( loadAsset( "smaa1.vert" ), loadAsset( "smaa1.frag" ) );
-	mSMAASecondPass = gl::GlslProg::create( loadAsset( "smaa2.vert" ), loadAsset( "smaa2.frag" ) );
-	mSMAAThirdPass = gl::GlslProg::create( loadAsset( "smaa3.vert" ), loadAsset( "smaa3.frag" ) );
+	mSMAAFirstPass = Shader::create( "smaa1" );
+	mSMAASecondPass = Shader::create( "smaa2" );
+	mSMAAThirdPass = Shader::create( "smaa3" );
 
 	// Create lookup textures
 	gl::Texture2d::Format fmt;
@@ -56,6 +56,17 @@ void SMAA::setup()
 	mAreaTex = gl::Texture2d::create( areaTexBytes, GL_RG, AREATEX_WIDTH, AREATEX_HEIGHT, fmt );
 }
 
+bool SMAA::reload()
+{
+	// Only the passes whose files have changed are rebuilt
+	bool reloaded = false;
+	reloaded |= mSMAAFirstPass->reload();
+	reloaded |= mSMAASecondPass->reload();
+	reloaded |= mSMAAThirdPass->reload();
+
+	return reloaded;
+}
+
 void SMAA::apply( const ci::gl::FboRef &destination, const ci::gl::FboRef &source )
 {
 	// Source and destination should have the same size
@@ -93,10 +104,11 @@ void SMAA::apply( const ci::gl::FboRef &destination, const ci::gl::FboRef &sourc
 	gl::ScopedFramebuffer fbo( destination );
 	gl::ScopedTextureBind tex0( source->getColorTexture(), 0 );
 	gl::ScopedTextureBind tex1( mFboBlendPass->getColorTexture(), 1 );
-	gl::ScopedGlslProg    shader( mSMAAThirdPass );
-	mSMAAThirdPass->uniform( "uColorTex", 0 );
-	mSMAAThirdPass->uniform( "uBlendTex", 1 );
-	mSMAAThirdPass->uniform( "SMAA_RT_METRICS", vec4( 1.0f / w, 1.0f / h, (float)w, (float)h ) );
+	gl::ScopedGlslProg    shader( mSMAAThirdPass->prog() );
+	const auto           &prog = mSMAAThirdPass->prog();
+	prog->uniform( "uColorTex", 0 );
+	prog->uniform( "uBlendTex", 1 );
+	prog->uniform( "SMAA_RT_METRICS", vec4( 1.0f / w, 1.0f / h, (float)w, (float)h ) );
 	{
 		gl::clear();
 		gl::ScopedColor color( Color::white() );
@@ -114,9 +126,10 @@ void SMAA::doEdgePass( const ci::gl::FboRef &source )
 	// Enable frame buffer
 	gl::ScopedFramebuffer fbo( mFboEdgePass );
 	gl::ScopedTextureBind tex0( source->getColorTexture(), 0 );
-	gl::ScopedGlslProg    shader( mSMAAFirstPass );
-	mSMAAFirstPass->uniform( "uColorTex", 0 );
-	mSMAAFirstPass->uniform( "SMAA_RT_METRICS", vec4( 1.0f / w, 1.0f / h, (float)w, (float)h ) );
+	gl::ScopedGlslProg    shader( mSMAAFirstPass->prog() );
+	const auto           &prog = mSMAAFirstPass->prog();
+	prog->uniform( "uColorTex", 0 );
+	prog->uniform( "SMAA_RT_METRICS", vec4( 1.0f / w, 1.0f / h, (float)w, (float)h ) );
 	{
 		gl::clear();
 		gl::clearStencil( 0 );
@@ -148,11 +161,12 @@ void SMAA::doBlendPass()
 	gl::ScopedTextureBind tex1( mAreaTex, 1 );
 	gl::ScopedTextureBind tex2( mSearchTex, 2 );
 
-	gl::ScopedGlslProg shader( mSMAASecondPass );
-	mSMAASecondPass->uniform( "uEdgesTex", 0 );
-	mSMAASecondPass->uniform( "uAreaTex", 1 );
-	mSMAASecondPass->uniform( "uSearchTex", 2 );
-	mSMAASecondPass->uniform( "SMAA_RT_METRICS", vec4( 1.0f / w, 1.0f / h, (float)w, (float)h ) );
+	gl::ScopedGlslProg shader( mSMAASecondPass->prog() );
+	const auto        &prog = mSMAASecondPass->prog();
+	prog->uniform( "uEdgesTex", 0 );
+	prog->uniform( "uAreaTex", 1 );
+	prog->uniform( "uSearchTex", 2 );
+	prog->uniform( "SMAA_RT_METRICS", vec4( 1.0f / w, 1.0f / h, (float)w, (float)h ) );
 	{
 		gl::clear();
 		gl::ScopedColor color( Color::white() );
@@ -66,6 +66,7 @@ class SMAAApp : public App {
 	Timer  mTimer;
 	double mTime;
 	double mTimeOffset;
+	double mReloadTime;
 
 	int  mDividerX;
 	Mode mMode;
@@ -98,6 +99,7 @@ void SMAAApp::setup()
 	mMode = Mode::BLEND_NEIGHBORS;
 
 	mTimeOffset = 0.0;
+	mReloadTime = 0.0;
 	mTimer.start();
 }
 
@@ -106,6 +108,19 @@ void SMAAApp::update()
 	// Keep track of time
 	mTime = mTimer.getSeconds() + mTimeOffset;
 
+	// Check once per second if the shaders have been edited
+	if( getElapsedSeconds() - mReloadTime > 1.0 ) {
+		mReloadTime = getElapsedSeconds();
+
+		try {
+			if( mSMAA.reload() )
+				console() << "Reloaded SMAA shaders." << std::endl;
+		}
+		catch( const std::exception &e ) {
+			console() << e.what() << std::endl;
+		}
+	}
+
 	// Animate our camera
 	const auto t = mTime / 10.0;
 
@@ -205,6 +220,16 @@ void SMAAApp::keyDown( KeyEvent event )
 	case KeyEvent::KEY_v:
 		gl::enableVerticalSync( !gl::isVerticalSyncEnabled() );
 		break;
+	case KeyEvent::KEY_g:
+		mPistons.cycleGridSize();
+		console() << "Pistons: " << mPistons.getCount() << std::endl;
+		break;
+	case KeyEvent::KEY_s:
+		mPistons.toggleSortMode();
+		break;
+	case KeyEvent::KEY_t:
+		mPistons.printTimings();
+		break;
 	}
 }
 
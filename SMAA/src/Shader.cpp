@@ -23,8 +23,13 @@
 #include "Shader.h"
 
 #include "cinder/Utilities.h"
-#include "cinder/app/AppBasic.h"
-#include <regex>
+#include "cinder/app/App.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <tuple>
+#include <vector>
 
 #if defined( CINDER_MSW )
 // As long as we don't care about the return value, this is safe
@@ -33,6 +38,180 @@
 
 using namespace ci;
 
+namespace {
+
+//! A shader file, split at its #include directives. The #version directives have been removed from the source.
+struct ParsedFile {
+	Shader::FileTime         time;
+	unsigned int             version;  // highest #version found in the file, or 0 if there was none
+	std::vector<std::string> sections; // source code before, between and after the includes
+	std::vector<std::string> includes; // file names of the includes, relative to the file
+};
+
+typedef std::shared_ptr<const ParsedFile> ParsedFileRef;
+
+//! parsed files by path, reused for as long as their modification time does not change
+std::map<fs::path, ParsedFileRef> sFiles;
+//! preprocessed vertex, fragment and geometry sources of a program
+typedef std::tuple<std::string, std::string, std::string> ProgramSources;
+//! linked programs by their preprocessed sources
+std::map<ProgramSources, std::weak_ptr<gl::GlslProg>> sPrograms;
+
+Shader::FileTime getFileTime( const fs::path &path )
+{
+	try {
+		if( fs::exists( path ) )
+			return fs::last_write_time( path );
+	}
+	catch( const std::exception & ) {
+	}
+
+	return Shader::FileTime();
+}
+
+bool isSpace( char c )
+{
+	return c == ' ' || c == '\t';
+}
+
+bool isDigit( char c )
+{
+	return c >= '0' && c <= '9';
+}
+
+//! if the line starting at \a begin is the preprocessor directive \a keyword, returns the position right after it
+size_t findDirective( const std::string &text, size_t begin, size_t end, const char *keyword )
+{
+	size_t i = begin;
+	while( i < end && isSpace( text[i] ) )
+		++i;
+	if( i == end || text[i] != '#' )
+		return std::string::npos;
+
+	++i;
+	while( i < end && isSpace( text[i] ) )
+		++i;
+
+	const size_t length = std::strlen( keyword );
+	if( end - i < length || text.compare( i, length, keyword ) != 0 )
+		return std::string::npos;
+
+	return i + length;
+}
+
+//! parses '#include "file"' or '#include <file>', returns FALSE if the line is something else
+bool parseInclude( const std::string &text, size_t begin, size_t end, std::string &file )
+{
+	size_t i = findDirective( text, begin, end, "include" );
+	if( i == std::string::npos )
+		return false;
+
+	while( i < end && isSpace( text[i] ) )
+		++i;
+	if( i == end || ( text[i] != '"' && text[i] != '<' ) )
+		return false;
+
+	const char   close = ( text[i] == '"' ) ? '"' : '>';
+	const size_t first = ++i;
+	while( i < end && text[i] != close )
+		++i;
+	if( i == end )
+		return false;
+
+	file = text.substr( first, i - first );
+	return true;
+}
+
+//! parses '#version 150', returns FALSE if the line is something else
+bool parseVersion( const std::string &text, size_t begin, size_t end, unsigned int &version )
+{
+	size_t i = findDirective( text, begin, end, "version" );
+	if( i == std::string::npos || i == end || !isSpace( text[i] ) )
+		return false;
+
+	while( i < end && isSpace( text[i] ) )
+		++i;
+	if( end - i < 3 || text[i] == '0' || !isDigit( text[i] ) || !isDigit( text[i + 1] ) || !isDigit( text[i + 2] ) )
+		return false;
+
+	version = 100 * ( text[i] - '0' ) + 10 * ( text[i + 1] - '0' ) + ( text[i + 2] - '0' );
+	return true;
+}
+
+//! reads the file and splits it at its includes in a single pass over the text
+ParsedFileRef parseFile( const fs::path &path, Shader::FileTime time )
+{
+	std::ifstream input( path.c_str(), std::ios::in | std::ios::binary );
+	if( !input.is_open() )
+		return ParsedFileRef();
+
+	const std::string text( ( std::istreambuf_iterator<char>( input ) ), std::istreambuf_iterator<char>() );
+
+	auto file = std::make_shared<ParsedFile>();
+	file->time = time;
+	file->version = 0;
+
+	std::string section;
+	section.reserve( text.size() );
+
+	std::string  include;
+	unsigned int version;
+
+	size_t begin = 0;
+	while( begin < text.size() ) {
+		size_t end = text.find( '\n', begin );
+		if( end == std::string::npos )
+			end = text.size();
+
+		size_t length = end - begin;
+		if( length > 0 && text[end - 1] == '\r' )
+			--length;
+
+		if( parseInclude( text, begin, begin + length, include ) ) {
+			file->sections.push_back( section );
+			file->includes.push_back( include );
+
+			// the line of the directive itself
+			section.assign( 1, '\n' );
+		}
+		else if( parseVersion( text, begin, begin + length, version ) ) {
+			file->version = std::max( file->version, version );
+		}
+		else {
+			section.append( text, begin, length );
+			section.append( 1, '\n' );
+		}
+
+		begin = end + 1;
+	}
+
+	file->sections.push_back( section );
+
+	return file;
+}
+
+//! returns the parsed file, only reading it again if it has changed since it was last parsed
+ParsedFileRef getFile( const fs::path &path, Shader::FileTime &time )
+{
+	time = getFileTime( path );
+	if( time == Shader::FileTime() )
+		return ParsedFileRef();
+
+	auto itr = sFiles.find( path );
+	if( itr != sFiles.end() && itr->second->time == time )
+		return itr->second;
+
+	ParsedFileRef file = parseFile( path, time );
+	if( file )
+		sFiles[path] = file;
+	else
+		sFiles.erase( path );
+
+	return file;
+}
+
+} // namespace
+
 Shader::Shader( void )
     : bHasGeometryShader( false )
     , mGlslVersion( 0 )
@@ -62,6 +241,31 @@ ShaderRef Shader::create( const std::string &name )
 	return std::make_shared<Shader>( name );
 }
 
+bool Shader::isModified() const
+{
+	for( auto &dependency : mDependencies ) {
+		if( getFileTime( dependency.first ) != dependency.second )
+			return true;
+	}
+
+	return false;
+}
+
+bool Shader::reload()
+{
+	if( mName.empty() || !isModified() )
+		return false;
+
+	load();
+	return true;
+}
+
+void Shader::clearCache()
+{
+	sFiles.clear();
+	sPrograms.clear();
+}
+
 void Shader::load()
 {
 	// get a reference to our path (and create it in the process)
@@ -79,28 +283,47 @@ void Shader::load()
 		throw std::runtime_error( msg );
 	}
 
-	bHasGeometryShader = fs::exists( path / mGeometryFile );
-	// if(bHasGeometryShader) TODO: check if geometry settings are defined
+	// parse source, keeping track of all files involved (including the geometry shader if it is missing,
+	// so that adding one later will trigger a reload)
+	mDependencies.clear();
 
-	// parse source
-	std::string vertexSource = parseShader( path / mVertexFile );
-	std::string fragmentSource = parseShader( path / mFragmentFile );
+	const std::string vertexSource = parseShader( path / mVertexFile );
+	const std::string fragmentSource = parseShader( path / mFragmentFile );
+	const std::string geometrySource = parseShader( path / mGeometryFile );
 
-	try {
-		if( bHasGeometryShader ) {
-			std::string geometrySource = parseShader( path / mGeometryFile );
+	// reuse the program if another shader has been built from the exact same sources
+	const ProgramSources sources( vertexSource, fragmentSource, geometrySource );
 
-			mGlslProg = gl::GlslProg( vertexSource.c_str(), fragmentSource.c_str(), geometrySource.c_str(), GL_TRIANGLES, GL_TRIANGLE_STRIP, 3 ); // TODO: support other geometry types
-		}
-		else {
-			mGlslProg = gl::GlslProg( vertexSource.c_str(), fragmentSource.c_str() );
+	auto itr = sPrograms.find( sources );
+	if( itr != sPrograms.end() ) {
+		gl::GlslProgRef prog = itr->second.lock();
+		if( prog ) {
+			bHasGeometryShader = !geometrySource.empty();
+			mGlslProg = prog;
+			return;
 		}
 	}
+
+	// compile and link, leaving the current program intact if this fails
+	try {
+		mGlslProg = gl::GlslProg::create( vertexSource, fragmentSource, geometrySource );
+		bHasGeometryShader = !geometrySource.empty();
+	}
 	catch( const std::exception &e ) {
 		char msg[64 * 1024];
 		snprintf( msg, 64 * 1024, "Failed to compile shader '%s':\n%s", mName.c_str(), e.what() );
 		throw std::runtime_error( msg );
 	}
+
+	// forget programs that are no longer in use
+	for( auto itr = sPrograms.begin(); itr != sPrograms.end(); ) {
+		if( itr->second.expired() )
+			itr = sPrograms.erase( itr );
+		else
+			++itr;
+	}
+
+	sPrograms[sources] = mGlslProg;
 }
 
 const fs::path &Shader::getPath() const
@@ -130,85 +353,51 @@ const fs::path &Shader::getPath() const
 	return mPath;
 }
 
-std::string Shader::parseShader( const fs::path &path, bool optional, int level )
+std::string Shader::parseShader( const fs::path &path, bool optional )
 {
-	std::stringstream output;
+	std::string code;
 
-	if( level > 32 ) {
-		throw std::runtime_error( "Reached the maximum inclusion depth." );
-		return std::string();
-	}
-
-	static const std::regex includeRegexp( "^[ ]*#[ ]*include[ ]+[\"<](.*)[\">].*" );
-
-	std::ifstream input( path.c_str() );
-	if( !input.is_open() ) {
-		if( optional )
-			return std::string();
-
-		if( level == 0 ) {
-			char msg[512];
-			snprintf( msg, 512, "Failed to open shader file '%s'.", path.c_str() );
-			throw std::runtime_error( msg );
-		}
-		else {
-			char msg[512];
-			snprintf( msg, 512, "Failed to open shader include file '%s'.", path.c_str() );
-			throw std::runtime_error( msg );
-		}
-
-		return std::string();
-	}
-
-	// go through each line and process includes
-	std::string line;
-	std::smatch matches;
-
-	while( std::getline( input, line ) ) {
-		if( std::regex_search( line, matches, includeRegexp ) )
-			output << parseShader( path.parent_path() / matches[1].str(), false, level + 1 );
-		else
-			output << line;
+	mGlslVersion = 0;
+	parseShader( path, optional, 0, code );
 
-		output << std::endl;
-	}
+	if( code.empty() )
+		return code;
 
-	input.close();
+	// make sure #version is the first line of the shader. Like Cinder, assume GLSL 1.50 if the shader does not specify it.
+	if( mGlslVersion == 0 )
+		mGlslVersion = 150;
 
-	// make sure #version is the first line of the shader
-	if( level == 0 )
-		return parseVersion( output.str() );
-	else
-		return output.str();
+	return "#version " + toString( mGlslVersion ) + "\n" + code;
 }
 
-std::string Shader::parseVersion( const std::string &code )
+void Shader::parseShader( const fs::path &path, bool optional, int level, std::string &output )
 {
-	static const std::regex versionRegexp( "^[ ]*#[ ]*version[ ]+([123456789][0123456789][0123456789]).*$" );
-
-	if( code.empty() )
-		return std::string();
+	if( level > 32 )
+		throw std::runtime_error( "Reached the maximum inclusion depth." );
 
-	mGlslVersion = 120;
+	FileTime      time;
+	ParsedFileRef file = getFile( path, time );
+	mDependencies[path] = time;
 
-	std::stringstream  completeCode( code );
-	std::ostringstream cleanedCode;
+	if( !file ) {
+		if( optional )
+			return;
 
-	std::string line;
-	std::smatch matches;
-	while( std::getline( completeCode, line ) ) {
-		if( std::regex_match( line, matches, versionRegexp ) ) {
-			unsigned int versionNum = ci::fromString<unsigned int>( matches[1] );
-			mGlslVersion = std::max( versionNum, mGlslVersion );
+		char msg[512];
+		if( level == 0 )
+			snprintf( msg, 512, "Failed to open shader file '%s'.", path.string().c_str() );
+		else
+			snprintf( msg, 512, "Failed to open shader include file '%s'.", path.string().c_str() );
+		throw std::runtime_error( msg );
+	}
 
-			continue;
-		}
+	mGlslVersion = std::max( mGlslVersion, file->version );
 
-		cleanedCode << line << std::endl;
+	// expand the includes in place
+	for( size_t i = 0; i < file->includes.size(); ++i ) {
+		output += file->sections[i];
+		parseShader( path.parent_path() / file->includes[i], false, level + 1, output );
 	}
 
-	std::stringstream vs;
-	vs << "#version " << mGlslVersion << std::endl << cleanedCode.str();
-
-	return vs.str();
+	output += file->sections.back();
 }
\ No newline at end of file
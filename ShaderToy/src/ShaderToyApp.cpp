@@ -26,6 +26,7 @@
 #include "cinder/ConcurrentCircularBuffer.h"
 #include "cinder/ImageIo.h"
 #include "cinder/Log.h"
+#include "cinder/Timer.h"
 #include "cinder/Unicode.h"
 #include "cinder/Utilities.h"
 #include "cinder/app/App.h"
@@ -37,6 +38,10 @@
 #include "cinder/gl/Texture.h"
 #include "cinder/gl/gl.h"
 
+#include "TaskScheduler.h"
+
+#include <deque>
+#include <map>
 #include <time.h>
 
 using namespace ci;
@@ -75,6 +80,11 @@ class ShaderToyApp : public App {
 	//! Our loader thread. Pass context by value, so the thread obtains ownership.
 	void loader( gl::ContextRef ctx );
 
+	//! Reads the shader sources on a worker thread. They are passed on to the loader thread by forwardRequests().
+	void requestShader( const fs::path &path );
+	//! Passes the shaders that have been read to the loader thread, in the order in which they were requested.
+	void forwardRequests();
+
   private:
 	//! Time in seconds at which the transition to the next shader starts.
 	double mTransitionTime;
@@ -101,6 +111,12 @@ class ShaderToyApp : public App {
 	fs::path mPathCurrent;
 	//! Keep track of the next path.
 	fs::path mPathNext;
+	//! The vertex shader and the fragment shader header shared by all shaders, read once at startup.
+	std::string mCommonVertex;
+	std::string mCommonInclude;
+	//! Linked programs by vertex and fragment source, so shaders that have been seen before don't have to be compiled again.
+	//! Only accessed by the loading thread.
+	std::map<std::pair<std::string, std::string>, gl::GlslProgRef> mProgramCache;
 
 	//! We will use this structure to pass data from one thread to another.
 	struct LoaderData {
@@ -118,8 +134,15 @@ class ShaderToyApp : public App {
 		}
 
 		fs::path        path;
+		std::string     vertex;
+		std::string     fragment;
 		gl::GlslProgRef shader;
+		//! Time it took to compile the shader, or to find it in the cache.
+		double seconds = 0.0;
+		bool   cached = false;
 	};
+	//! Shaders that are being read by the task scheduler, in the order in which they were requested. Only accessed by the main thread.
+	std::deque<std::pair<ph::TaskRef, std::shared_ptr<LoaderData>>> mReading;
 	//! The main thread will push data to this buffer, to be picked up by the loading thread.
 	ConcurrentCircularBuffer<LoaderData> *mRequests;
 	//! The loading thread will push data to this buffer, to be picked up by the main thread.
@@ -160,6 +183,9 @@ void ShaderToyApp::setup()
 		mChannel3 = gl::Texture::create( loadImage( loadAsset( "presets/tex02.jpg" ) ), fmt );
 
 		mShaderTransition = gl::GlslProg::create( loadAsset( "common/shadertoy.vert" ), loadAsset( "common/shadertoy.frag" ) );
+
+		mCommonVertex = loadString( loadAsset( "common/shadertoy.vert" ) );
+		mCommonInclude = loadString( loadAsset( "common/shadertoy.inc" ) );
 	}
 	catch( const std::exception &e ) {
 		// Quit if anything went wrong.
@@ -168,14 +194,15 @@ void ShaderToyApp::setup()
 		return;
 	}
 
-	// Tell our loading thread to load the first shader. The path is converted to LoaderData implicitly.
-	mRequests->pushFront( getAssetPath( "hell.frag" ) );
+	// Load the first shader.
+	requestShader( getAssetPath( "hell.frag" ) );
 }
 
 void ShaderToyApp::cleanup()
 {
-	// Properly shut down the loading thread.
+	// Properly shut down the loading thread and the task scheduler.
 	shutdownLoader();
+	ph::TaskScheduler::getInstance().shutdown();
 
 	// Properly destroy the buffers.
 	if( mResponses )
@@ -188,6 +215,8 @@ void ShaderToyApp::cleanup()
 
 void ShaderToyApp::update()
 {
+	forwardRequests();
+
 	LoaderData data;
 
 	// If we are ready for the next shader, take it from the buffer.
@@ -197,6 +226,8 @@ void ShaderToyApp::update()
 		mPathNext = data.path;
 		mShaderNext = data.shader;
 
+		CI_LOG_I( ( data.cached ? "Found " : "Compiled " ) << mPathNext.filename().string() << " in " << data.seconds * 1000.0 << " ms." );
+
 		// Start the transition.
 		mTransitionTime = getElapsedSeconds();
 		mTransitionDuration = 2.0;
@@ -320,8 +351,8 @@ void ShaderToyApp::fileDrop( FileDropEvent event )
 {
 	// Send all file requests to the loading thread.
 	size_t count = event.getNumFiles();
-	for( size_t i = 0; i < count && mRequests->isNotFull(); ++i )
-		mRequests->pushFront( event.getFile( i ) );
+	for( size_t i = 0; i < count; ++i )
+		requestShader( event.getFile( i ) );
 }
 
 void ShaderToyApp::random()
@@ -344,8 +375,7 @@ void ShaderToyApp::random()
 	if( shaders.at( idx ) == mPathCurrent )
 		idx = ( idx + 1 ) % shaders.size();
 
-	if( mRequests->isNotFull() )
-		mRequests->pushFront( shaders.at( idx ) );
+	requestShader( shaders.at( idx ) );
 }
 
 void ShaderToyApp::setUniforms()
@@ -404,12 +434,54 @@ bool ShaderToyApp::setupLoader()
 
 void ShaderToyApp::shutdownLoader()
 {
-	// Tell the loading thread to abort, then wait for it to stop.
+	// Tell the loading thread to abort, wake it up if it is waiting for a request, then wait for it to stop.
 	mThreadAbort = true;
+	if( mRequests )
+		mRequests->cancel();
+	if( mResponses )
+		mResponses->cancel();
 	if( mThread )
 		mThread->join();
 }
 
+void ShaderToyApp::requestShader( const fs::path &path )
+{
+	// Reading files does not need the OpenGL context, so leave it to the task scheduler.
+	// The loader thread only compiles, because it owns the shared context.
+	auto data = std::make_shared<LoaderData>( path );
+	data->vertex = mCommonVertex;
+
+	const std::string include = mCommonInclude;
+
+	auto task = ph::TaskScheduler::getInstance().submit( [data, include]() {
+		data->fragment = include + loadString( loadFile( data->path ) );
+	}, ph::Task::HIGH );
+
+	mReading.push_back( std::make_pair( task, data ) );
+}
+
+void ShaderToyApp::forwardRequests()
+{
+	// Files may finish reading in any order, so only forward the oldest request once it is done.
+	// This way, queued shaders are compiled and shown one after the other.
+	while( !mReading.empty() && mReading.front().first->isDone() ) {
+		const auto &task = mReading.front().first;
+		const auto &data = mReading.front().second;
+
+		try {
+			task->rethrow();
+
+			if( !mRequests->tryPushFront( *data ) )
+				CI_LOG_W( "Too many shaders queued, skipped " << data->path.filename().string() << "." );
+		}
+		catch( const std::exception &e ) {
+			CI_LOG_EXCEPTION( "Failed to read the shader " << data->path.filename().string() << ": ", e );
+		}
+
+		mReading.pop_front();
+	}
+}
+
 void ShaderToyApp::loader( gl::ContextRef ctx )
 {
 	// This only works if we can make the render context current.
@@ -417,33 +489,46 @@ void ShaderToyApp::loader( gl::ContextRef ctx )
 
 	// Loading loop.
 	while( !mThreadAbort ) {
-		// Wait for a request.
-		if( mRequests->isNotEmpty() ) {
-			// Take the request from the buffer.
-			LoaderData data;
-			mRequests->popBack( &data );
+		// Wait for a request. This blocks until one is available, or until shutdownLoader() cancels the buffer.
+		LoaderData data;
+		mRequests->popBack( &data );
+
+		if( mThreadAbort )
+			break;
 
-			// Try to load, parse and compile the shader.
-			try {
-				std::string vs = loadString( loadAsset( "common/shadertoy.vert" ) );
-				std::string fs = loadString( loadAsset( "common/shadertoy.inc" ) ) + loadString( loadFile( data.path ) );
+		Timer timer( true );
 
-				data.shader = gl::GlslProg::create( gl::GlslProg::Format().vertex( vs ).fragment( fs ) );
+		// Try to find the shader in the cache, or compile it. The sources have been read by the task scheduler.
+		try {
+			const auto key = std::make_pair( data.vertex, data.fragment );
 
-				// If the shader compiled successfully, pass it to the main thread.
-				mResponses->pushFront( data );
+			auto itr = mProgramCache.find( key );
+			if( itr != mProgramCache.end() ) {
+				data.shader = itr->second;
+				data.cached = true;
 			}
-			catch( const std::exception &e ) {
-				// Uhoh, something went wrong, but it's not fatal.
-				CI_LOG_EXCEPTION( "Failed to compile the shader: ", e );
+			else {
+				data.shader = gl::GlslProg::create( gl::GlslProg::Format().vertex( data.vertex ).fragment( data.fragment ) );
+
+				// Make sure the program is ready before the main thread uses it.
+				glFinish();
+
+				mProgramCache[key] = data.shader;
 			}
+
+			data.seconds = timer.getSeconds();
+
+			// If the shader compiled successfully, pass it to the main thread.
+			mResponses->pushFront( data );
 		}
-		else {
-			// Allow the CPU to do other things for a while.
-			std::chrono::milliseconds duration( 100 );
-			std::this_thread::sleep_for( duration );
+		catch( const std::exception &e ) {
+			// Uhoh, something went wrong, but it's not fatal.
+			CI_LOG_EXCEPTION( "Failed to compile the shader: ", e );
 		}
 	}
+
+	// Release the cached programs while our context is still current.
+	mProgramCache.clear();
 }
 
 #pragma warning( pop ) // _CRT_SECURE_NO_WARNINGS
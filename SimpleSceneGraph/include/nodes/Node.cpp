@@ -21,6 +21,7 @@
  */
 
 #include "nodes/Node.h"
+#include "nodes/UpdatePool.h"
 #include "cinder/app/App.h"
 
 using namespace ci;
@@ -30,35 +31,53 @@ using namespace std;
 namespace ph {
 namespace nodes {
 
-int          Node::nodeCount = 0;
-unsigned int Node::uuidCount = 1;
-NodeMap      Node::uuidLookup;
+std::atomic<int>          Node::nodeCount( 0 );
+std::atomic<unsigned int> Node::uuidCount( 1 );
+NodeMap                   Node::uuidLookup;
+std::mutex                Node::uuidMutex;
+
+std::unique_ptr<UpdatePool>        Node::updatePool;
+std::atomic<bool>                  Node::updateInProgress( false );
+std::vector<std::function<void()>> Node::deferredChanges;
+std::mutex                         Node::deferredMutex;
 
 Node::Node( void )
     : mIsVisible( true )
     , mIsClickable( true )
     , mIsSelected( false )
-    , mUuid( uuidCount )
+    , mIsIndependent( false )
+    , mUuid( uuidCount++ )
     , mIsSetup( false )
     , mIsTransformInvalidated( true )
 {
 	// default constructor for [Node]
 	nodeCount++;
-	uuidCount++;
 }
 
 Node::~Node( void )
 {
-	// remove all children safely
-	removeChildren();
+	// remove all children safely (can't use shared_from_this() here, so don't defer)
+	detachChildren();
 
 	//
 	nodeCount--;
 
 	// remove from lookup table
+	std::lock_guard<std::mutex> lock( uuidMutex );
 	uuidLookup.erase( mUuid );
 }
 
+NodeRef Node::findNode( unsigned int uuid )
+{
+	std::lock_guard<std::mutex> lock( uuidMutex );
+
+	const auto itr = uuidLookup.find( uuid );
+	if( itr != uuidLookup.end() )
+		return itr->second.lock();
+
+	return NodeRef();
+}
+
 void Node::removeFromParent()
 {
 	NodeRef node = mParent.lock();
@@ -68,6 +87,12 @@ void Node::removeFromParent()
 
 void Node::addChild( NodeRef node )
 {
+	if( updateInProgress ) {
+		NodeRef self = shared_from_this();
+		defer( [self, node]() { self->addChild( node ); } );
+		return;
+	}
+
 	if( node && !hasChild( node ) ) {
 		// remove child from current parent
 		NodeRef parent = node->getParent();
@@ -81,6 +106,7 @@ void Node::addChild( NodeRef node )
 		node->setParent( shared_from_this() );
 
 		// store nodes in lookup table if not done yet
+		std::lock_guard<std::mutex> lock( uuidMutex );
 		uuidLookup[mUuid] = NodeWeakRef( shared_from_this() );
 		uuidLookup[node->mUuid] = NodeWeakRef( node );
 	}
@@ -88,6 +114,12 @@ void Node::addChild( NodeRef node )
 
 void Node::removeChild( NodeRef node )
 {
+	if( updateInProgress ) {
+		NodeRef self = shared_from_this();
+		defer( [self, node]() { self->removeChild( node ); } );
+		return;
+	}
+
 	const NodeList::iterator itr = std::find( mChildren.begin(), mChildren.end(), node );
 	if( itr != mChildren.end() ) {
 		// reset parent
@@ -99,6 +131,17 @@ void Node::removeChild( NodeRef node )
 }
 
 void Node::removeChildren()
+{
+	if( updateInProgress ) {
+		NodeRef self = shared_from_this();
+		defer( [self]() { self->removeChildren(); } );
+		return;
+	}
+
+	detachChildren();
+}
+
+void Node::detachChildren()
 {
 	for( NodeList::iterator itr = mChildren.begin(); itr != mChildren.end(); ) {
 		// reset parent
@@ -124,6 +167,12 @@ void Node::putOnTop()
 
 void Node::putOnTop( NodeRef node )
 {
+	if( updateInProgress ) {
+		NodeRef self = shared_from_this();
+		defer( [self, node]() { self->putOnTop( node ); } );
+		return;
+	}
+
 	// remove from list
 	const NodeList::iterator itr = std::find( mChildren.begin(), mChildren.end(), node );
 	if( itr == mChildren.end() )
@@ -180,6 +229,12 @@ void Node::setTransform( const ci::mat4 &transform ) const
 
 void Node::moveToBottom( NodeRef node )
 {
+	if( updateInProgress ) {
+		NodeRef self = shared_from_this();
+		defer( [self, node]() { self->moveToBottom( node ); } );
+		return;
+	}
+
 	// remove from list
 	const NodeList::iterator itr = std::find( mChildren.begin(), mChildren.end(), node );
 	if( itr == mChildren.end() )
@@ -225,14 +280,98 @@ void Node::treeShutdown()
 }
 
 void Node::treeUpdate( double elapsed )
+{
+	// nested calls (e.g. from within update()) simply become part of the current update
+	if( !updatePool || updateInProgress ) {
+		updateSubtree( elapsed );
+		return;
+	}
+
+	updateInProgress = true;
+
+	try {
+		updateSubtree( elapsed );
+	}
+	catch( ... ) {
+		updateInProgress = false;
+		commitDeferred();
+		throw;
+	}
+
+	// single threaded commit phase
+	updateInProgress = false;
+	commitDeferred();
+}
+
+void Node::updateSubtree( double elapsed )
 {
 	// let derived class perform animation
 	update( elapsed );
 
 	// update this node's children
 	NodeList nodes( mChildren );
-	for( NodeList::iterator itr = nodes.begin(); itr != nodes.end(); ++itr )
-		( *itr )->treeUpdate( elapsed );
+
+	if( !updateInProgress ) {
+		for( NodeList::iterator itr = nodes.begin(); itr != nodes.end(); ++itr )
+			( *itr )->updateSubtree( elapsed );
+		return;
+	}
+
+	// make sure our transform is valid, so children don't race to update it
+	if( mIsTransformInvalidated )
+		transform();
+
+	// each independent child becomes a task, the others are updated in order by a single task
+	std::vector<UpdateTask> tasks;
+	NodeList                dependents;
+
+	for( NodeList::iterator itr = nodes.begin(); itr != nodes.end(); ++itr ) {
+		NodeRef node = *itr;
+		if( node->mIsIndependent )
+			tasks.emplace_back( [node, elapsed]() { node->updateSubtree( elapsed ); } );
+		else
+			dependents.push_back( node );
+	}
+
+	if( !dependents.empty() ) {
+		tasks.emplace_back( [&dependents, elapsed]() {
+			for( NodeList::iterator itr = dependents.begin(); itr != dependents.end(); ++itr )
+				( *itr )->updateSubtree( elapsed );
+		} );
+	}
+
+	if( tasks.size() == 1 )
+		tasks.front()();
+	else
+		updatePool->run( tasks );
+}
+
+void Node::enableParallelUpdate( size_t numThreads )
+{
+	updatePool.reset( new UpdatePool( numThreads ) );
+}
+
+void Node::disableParallelUpdate()
+{
+	updatePool.reset();
+}
+
+void Node::defer( const std::function<void()> &change )
+{
+	std::lock_guard<std::mutex> lock( deferredMutex );
+	deferredChanges.push_back( change );
+}
+
+void Node::commitDeferred()
+{
+	std::vector<std::function<void()>> changes;
+	{
+		std::lock_guard<std::mutex> lock( deferredMutex );
+		changes.swap( deferredChanges );
+	}
+
+	for( auto &change : changes )
+		change();
 }
 
 void Node::treeDraw()
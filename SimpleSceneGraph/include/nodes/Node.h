@@ -43,9 +43,15 @@ class FileDropEvent;
 #include "cinder/Vector.h"
 #include "cinder/gl/GlslProg.h"
 
+#include <atomic>
 #include <deque>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 // we don't want these, defined in <minwindef.h>
 #undef near
@@ -60,6 +66,8 @@ typedef std::weak_ptr<class Node>           NodeWeakRef;
 typedef std::vector<NodeRef>                NodeList;
 typedef std::map<unsigned int, NodeWeakRef> NodeMap;
 
+class UpdatePool;
+
 class Node : public std::enable_shared_from_this<Node> {
   public:
 	Node( void );
@@ -96,7 +104,7 @@ class Node : public std::enable_shared_from_this<Node> {
 	static unsigned int colorToUuid( ci::Color color ) { return colorToUuid( static_cast<unsigned char>( color.r * 255 ), static_cast<unsigned char>( color.g * 255 ), static_cast<unsigned char>( color.b * 255 ) ); }
 	static unsigned int colorToUuid( unsigned char r, unsigned char g, unsigned char b ) { return r + ( g << 8 ) + ( b << 16 ); }
 
-	static NodeRef findNode( unsigned int uuid ) { return uuidLookup[uuid].lock(); }
+	static NodeRef findNode( unsigned int uuid );
 
 	// parent functions
 	//! returns wether this node has a specific child
@@ -151,6 +159,11 @@ class Node : public std::enable_shared_from_this<Node> {
 		return mIsVisible;
 	}
 
+	//! marks this node and its decendants as independent: they do not touch nodes outside of this subtree in their update() function
+	void setIndependent( bool independent = true ) { mIsIndependent = independent; }
+	//! returns wether this node and its decendants can be updated in parallel with the rest of the tree
+	bool isIndependent() const { return mIsIndependent; }
+
 	//!
 	virtual void setClickable( bool clickable = true ) { mIsClickable = clickable; }
 	//! returns wether this node is clickable
@@ -209,6 +222,13 @@ class Node : public std::enable_shared_from_this<Node> {
 	//! calls the draw() function of this node and all its decendants
 	void treeDraw();
 
+	//! updates independent subtrees on \a numThreads threads (including the main thread). Structural changes to the tree are deferred until all nodes have been updated.
+	static void enableParallelUpdate( size_t numThreads = std::thread::hardware_concurrency() );
+	//! updates all nodes on the main thread
+	static void disableParallelUpdate();
+	//! returns wether independent subtrees are updated in parallel
+	static bool isParallelUpdateEnabled() { return bool( updatePool ); }
+
 	virtual void setup() {}
 	virtual void shutdown() {}
 	virtual void update( double elapsed = 0.0 ) {}
@@ -253,6 +273,7 @@ class Node : public std::enable_shared_from_this<Node> {
 	bool mIsVisible;
 	bool mIsClickable;
 	bool mIsSelected;
+	bool mIsIndependent;
 
 	const unsigned int mUuid;
 
@@ -270,15 +291,35 @@ class Node : public std::enable_shared_from_this<Node> {
 	//! required transform() function to populate the transform matrix
 	virtual void transform() const = 0;
 
+  private:
+	//! recursively updates this node, dispatching independent children to the update pool
+	void updateSubtree( double elapsed );
+	//! removes all children without deferring, safe to call from the destructor
+	void detachChildren();
+
+	//! queues a structural change requested during a parallel update
+	static void defer( const std::function<void()> &change );
+	//! performs all structural changes that were deferred during the parallel update
+	static void commitDeferred();
+
   private:
 	bool mIsSetup;
 
 	//! nodeCount is used to count the number of Node instances for debugging purposes
-	static int nodeCount;
+	static std::atomic<int> nodeCount;
 	//! uuidCount is used to generate new unique id's
-	static unsigned int uuidCount;
+	static std::atomic<unsigned int> uuidCount;
 	//! uuidLookup allows us to quickly find a Node by id
-	static NodeMap uuidLookup;
+	static NodeMap    uuidLookup;
+	static std::mutex uuidMutex;
+
+	//! updatePool updates independent subtrees in parallel, if enabled
+	static std::unique_ptr<UpdatePool> updatePool;
+	//! updateInProgress is set while the pool is updating the tree
+	static std::atomic<bool> updateInProgress;
+	//! deferredChanges contains the structural changes requested during a parallel update, in order
+	static std::vector<std::function<void()>> deferredChanges;
+	static std::mutex                         deferredMutex;
 
 	mutable bool     mIsTransformInvalidated;
 	mutable ci::mat4 mTransform;
@@ -0,0 +1,168 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "nodes/UpdatePool.h"
+
+namespace ph {
+namespace nodes {
+
+//! index of the queue owned by the current thread, or -1 if this thread is not part of a pool
+static thread_local int sQueueIndex = -1;
+
+UpdatePool::UpdatePool( size_t numThreads )
+    : mNumQueued( 0 )
+    , mIsRunning( true )
+{
+	if( numThreads < 1 )
+		numThreads = 1;
+
+	for( size_t i = 0; i < numThreads; ++i )
+		mQueues.emplace_back( new Queue() );
+
+	// queue 0 is serviced by the thread calling run(), so we only need to spawn the others
+	for( size_t i = 1; i < numThreads; ++i )
+		mThreads.emplace_back( &UpdatePool::work, this, i );
+}
+
+UpdatePool::~UpdatePool()
+{
+	{
+		std::lock_guard<std::mutex> lock( mSleepMutex );
+		mIsRunning = false;
+	}
+	mSleepCondition.notify_all();
+
+	for( auto &thread : mThreads )
+		thread.join();
+}
+
+void UpdatePool::run( std::vector<UpdateTask> &tasks )
+{
+	if( tasks.empty() )
+		return;
+
+	// single threaded pools don't need any bookkeeping
+	if( mQueues.size() == 1 ) {
+		for( auto &task : tasks )
+			task();
+		return;
+	}
+
+	// tasks submitted by a worker go to its own queue, all others go to queue 0
+	const size_t index = sQueueIndex < 0 ? 0 : size_t( sQueueIndex );
+
+	Batch batch;
+	batch.mPending = tasks.size();
+
+	{
+		std::lock_guard<std::mutex> lock( mQueues[index]->mMutex );
+		for( auto &task : tasks )
+			mQueues[index]->mJobs.push_back( Job{ &task, &batch } );
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mSleepMutex );
+		mNumQueued += tasks.size();
+	}
+	mSleepCondition.notify_all();
+
+	// help out until all tasks of this batch have completed
+	const int previous = sQueueIndex;
+	sQueueIndex = int( index );
+
+	Job job;
+	while( batch.mPending > 0 ) {
+		if( fetch( index, job ) )
+			execute( job );
+		else
+			std::this_thread::yield();
+	}
+
+	sQueueIndex = previous;
+
+	if( batch.mException )
+		std::rethrow_exception( batch.mException );
+}
+
+void UpdatePool::work( size_t index )
+{
+	sQueueIndex = int( index );
+
+	Job job;
+	while( mIsRunning ) {
+		if( fetch( index, job ) ) {
+			execute( job );
+			continue;
+		}
+
+		// nothing to do, sleep until new tasks are submitted
+		std::unique_lock<std::mutex> lock( mSleepMutex );
+		mSleepCondition.wait( lock, [&]() { return mNumQueued > 0 || !mIsRunning; } );
+	}
+}
+
+bool UpdatePool::fetch( size_t index, Job &job )
+{
+	// LIFO from our own queue keeps the working set small
+	{
+		Queue &                     queue = *mQueues[index];
+		std::lock_guard<std::mutex> lock( queue.mMutex );
+		if( !queue.mJobs.empty() ) {
+			job = queue.mJobs.back();
+			queue.mJobs.pop_back();
+			--mNumQueued;
+			return true;
+		}
+	}
+
+	// FIFO from the other queues steals the oldest, and usually largest, tasks first
+	for( size_t i = 1; i < mQueues.size(); ++i ) {
+		Queue &                     queue = *mQueues[( index + i ) % mQueues.size()];
+		std::lock_guard<std::mutex> lock( queue.mMutex );
+		if( !queue.mJobs.empty() ) {
+			job = queue.mJobs.front();
+			queue.mJobs.pop_front();
+			--mNumQueued;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UpdatePool::execute( Job &job )
+{
+	try {
+		( *job.mTask )();
+	}
+	catch( ... ) {
+		std::lock_guard<std::mutex> lock( job.mBatch->mExceptionMutex );
+		if( !job.mBatch->mException )
+			job.mBatch->mException = std::current_exception();
+	}
+
+	// must be the last access to the batch, as it lives on the stack of the thread calling run()
+	--job.mBatch->mPending;
+}
+
+} // namespace nodes
+} // namespace ph
@@ -0,0 +1,91 @@
+/*
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ph {
+namespace nodes {
+
+typedef std::function<void()> UpdateTask;
+
+//! A small work-stealing thread pool, used by Node::treeUpdate() to update independent subtrees in parallel.
+//! Each worker owns a deque of tasks: it pops from the back of its own deque and steals from the front of the others.
+//! The thread calling run() takes part in the work, so tasks can safely call run() themselves.
+class UpdatePool {
+  public:
+	//! Creates a pool with \a numThreads threads in total, including the calling thread.
+	explicit UpdatePool( size_t numThreads );
+	~UpdatePool();
+
+	//! returns the number of threads that take part in an update, including the calling thread
+	size_t getNumThreads() const { return mQueues.size(); }
+
+	//! executes all \a tasks and returns when they have completed. Rethrows the first exception thrown by a task.
+	void run( std::vector<UpdateTask> &tasks );
+
+  private:
+	struct Batch {
+		std::atomic<size_t> mPending;
+		std::exception_ptr  mException;
+		std::mutex          mExceptionMutex;
+	};
+
+	struct Job {
+		UpdateTask *mTask;
+		Batch *     mBatch;
+	};
+
+	struct Queue {
+		std::mutex      mMutex;
+		std::deque<Job> mJobs;
+	};
+
+	//! the main loop of a worker thread
+	void work( size_t index );
+	//! pops a job from queue \a index, or steals one from another queue
+	bool fetch( size_t index, Job &job );
+	//! executes a job and signals its batch
+	void execute( Job &job );
+
+  private:
+	//! one queue per thread, queue 0 belongs to the thread calling run()
+	std::vector<std::unique_ptr<Queue>> mQueues;
+	std::vector<std::thread>            mThreads;
+
+	std::atomic<size_t>     mNumQueued;
+	std::atomic<bool>       mIsRunning;
+	std::mutex              mSleepMutex;
+	std::condition_variable mSleepCondition;
+};
+
+} // namespace nodes
+} // namespace ph
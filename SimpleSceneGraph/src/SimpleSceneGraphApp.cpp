@@ -20,6 +20,7 @@
  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "cinder/Timer.h"
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/Texture.h"
@@ -52,6 +53,10 @@ class SimpleSceneGraphApp : public App {
 
 	void resize() override;
 
+  protected:
+	//! Measures the time it takes to update a large tree of independent subtrees, using 1 to N threads
+	void benchmark();
+
   protected:
 	//! The root node
 	Node2DRef mRoot;
@@ -59,6 +64,26 @@ class SimpleSceneGraphApp : public App {
 	NodeRectangleRef mParent;
 };
 
+//! Node that performs a fixed amount of work in its update() function, used by the benchmark
+class NodeBenchmark : public Node2D {
+  public:
+	NodeBenchmark( void )
+	    : mAngle( 0 )
+	{
+	}
+
+	void update( double elapsed ) override
+	{
+		for( int i = 0; i < 1000; ++i )
+			mAngle = math<float>::sin( mAngle + float( elapsed ) );
+
+		setRotation( mAngle );
+	}
+
+  private:
+	float mAngle;
+};
+
 void SimpleSceneGraphApp::prepare( Settings *settings )
 {
 	settings->setWindowSize( 800, 600 );
@@ -93,6 +118,10 @@ void SimpleSceneGraphApp::setup()
 	child2->setSize( 240, 200 );
 	mParent->addChild( child2 );
 
+	// the two children don't interact with each other, so they can be updated in parallel (press P)
+	child1->setIndependent();
+	child2->setIndependent();
+
 	// add even smaller rectangles to the child rectangles
 	auto child = std::make_shared<NodeRectangle>();
 	child->setPosition( 60, 100 ); // relative to parent node
@@ -188,6 +217,16 @@ void SimpleSceneGraphApp::keyDown( KeyEvent event )
 				setFullScreen( !isFullScreen() );
 			}
 			break;
+		case KeyEvent::KEY_p:
+			if( Node::isParallelUpdateEnabled() )
+				Node::disableParallelUpdate();
+			else
+				Node::enableParallelUpdate();
+			console() << "Parallel update: " << ( Node::isParallelUpdateEnabled() ? "on" : "off" ) << std::endl;
+			break;
+		case KeyEvent::KEY_b:
+			benchmark();
+			break;
 		default:
 			break;
 		}
@@ -204,4 +243,49 @@ void SimpleSceneGraphApp::resize()
 	mRoot->treeResize();
 }
 
+void SimpleSceneGraphApp::benchmark()
+{
+	const int kSubtrees = 64;
+	const int kNodesPerSubtree = 64;
+	const int kIterations = 10;
+
+	// build a tree of independent subtrees, each containing a chain of nodes
+	auto root = std::make_shared<Node2D>();
+	for( int i = 0; i < kSubtrees; ++i ) {
+		Node2DRef parent = std::make_shared<NodeBenchmark>();
+		parent->setIndependent();
+		root->addChild( parent );
+
+		for( int j = 1; j < kNodesPerSubtree; ++j ) {
+			Node2DRef child = std::make_shared<NodeBenchmark>();
+			parent->addChild( child );
+			parent = child;
+		}
+	}
+
+	const bool     wasEnabled = Node::isParallelUpdateEnabled();
+	const unsigned numCores = std::max( 1u, std::thread::hardware_concurrency() );
+
+	double baseline = 0.0;
+	for( unsigned numThreads = 1; numThreads <= numCores; ++numThreads ) {
+		Node::enableParallelUpdate( numThreads );
+
+		Timer timer( true );
+		for( int i = 0; i < kIterations; ++i )
+			root->treeUpdate( 0.01 );
+		timer.stop();
+
+		const double ms = timer.getSeconds() * 1000.0 / kIterations;
+		if( numThreads == 1 )
+			baseline = ms;
+
+		console() << "Update of " << ( kSubtrees * kNodesPerSubtree ) << " nodes on " << numThreads << " thread(s): " << ms << " ms (x" << ( baseline / ms ) << ")" << std::endl;
+	}
+
+	if( wasEnabled )
+		Node::enableParallelUpdate();
+	else
+		Node::disableParallelUpdate();
+}
+
 CINDER_APP( SimpleSceneGraphApp, RendererGl, &SimpleSceneGraphApp::prepare )
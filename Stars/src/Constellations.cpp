@@ -22,6 +22,7 @@
 
 #include "Constellations.h"
 #include "Conversions.h"
+#include "TaskScheduler.h"
 
 #include "cinder/app/App.h"
 #include "cinder/gl/Context.h"
@@ -165,6 +166,26 @@ void Constellations::load( DataSourceRef source )
 }
 
 void Constellations::read( DataSourceRef source )
+{
+	readData( source );
+
+	// create mesh
+	createMesh();
+}
+
+void Constellations::readAsync( DataSourceRef source )
+{
+	// parse into a temporary object on a worker thread, then take its data on the main thread
+	auto constellations = std::make_shared<Constellations>();
+
+	ph::TaskScheduler::getInstance().submit( [=]() { constellations->readData( source ); } )->thenOnMainThread( [=]() {
+		mVertices.swap( constellations->mVertices );
+
+		createMesh();
+	} );
+}
+
+void Constellations::readData( DataSourceRef source )
 {
 	IStreamRef in = source->createStream();
 
@@ -183,9 +204,6 @@ void Constellations::read( DataSourceRef source )
 		in->readLittle( &v.z );
 		mVertices.push_back( v );
 	}
-
-	// create mesh
-	createMesh();
 }
 
 void Constellations::write( DataTargetRef target )
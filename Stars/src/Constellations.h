@@ -47,10 +47,14 @@ class Constellations {
 
 	//! reads a binary label data file
 	void read( ci::DataSourceRef source );
+	//! reads a binary label data file on a worker thread, then creates the mesh on the main thread
+	void readAsync( ci::DataSourceRef source );
 	//! writes a binary label data file
 	void write( ci::DataTargetRef target );
 
   private:
+	//! parses a binary data file without creating the mesh, so it can run on any thread
+	void readData( ci::DataSourceRef source );
 	void createMesh();
 
 	ci::dvec3              getStarCoordinate( double ra, double dec, double distance );
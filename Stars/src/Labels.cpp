@@ -22,6 +22,7 @@
 
 #include "Labels.h"
 #include "Conversions.h"
+#include "TaskScheduler.h"
 
 #include "text/FontStore.h"
 
@@ -145,16 +146,38 @@ void Labels::load( DataSourceRef source )
 
 void Labels::read( DataSourceRef source )
 {
-	IStreamRef in = source->createStream();
-
 	mLabels.clear();
 
+	for( auto &label : readData( source ) )
+		mLabels.addLabel( label.position, label.name, label.data );
+}
+
+void Labels::readAsync( DataSourceRef source )
+{
+	// parse on a worker thread, then add the labels on the main thread
+	auto labels = std::make_shared<std::vector<Label>>();
+
+	ph::TaskScheduler::getInstance().submit( [=]() { *labels = readData( source ); } )->thenOnMainThread( [=]() {
+		mLabels.clear();
+
+		for( auto &label : *labels )
+			mLabels.addLabel( label.position, label.name, label.data );
+	} );
+}
+
+std::vector<Labels::Label> Labels::readData( DataSourceRef source )
+{
+	IStreamRef in = source->createStream();
+
 	uint8_t versionNumber;
 	in->read( &versionNumber );
 
 	uint32_t numLabels;
 	in->readLittle( &numLabels );
 
+	std::vector<Label> result;
+	result.reserve( numLabels );
+
 	float data = 0.0f;
 	for( size_t idx = 0; idx < numLabels; ++idx ) {
 		vec3 position;
@@ -163,11 +186,13 @@ void Labels::read( DataSourceRef source )
 		in->readLittle( &position.z );
 		if( versionNumber > 1 )
 			in->readLittle( &data );
-		std::string name;
-		in->read( &name );
+		Label label = { position, std::string(), data };
+		in->read( &label.name );
 
-		mLabels.addLabel( position, name, data );
+		result.push_back( label );
 	}
+
+	return result;
 }
 
 void Labels::write( DataTargetRef target )
@@ -51,9 +51,21 @@ class Labels {
 
 	//! reads a binary label data file
 	void read( ci::DataSourceRef source );
+	//! reads a binary label data file on a worker thread, then adds the labels on the main thread
+	void readAsync( ci::DataSourceRef source );
 	//! writes a binary label data file
 	void write( ci::DataTargetRef target );
 
+  protected:
+	struct Label {
+		ci::vec3    position;
+		std::string name;
+		float       data;
+	};
+
+	//! parses a binary label data file, can be called from any thread
+	static std::vector<Label> readData( ci::DataSourceRef source );
+
   protected:
 	ph::text::TextLabels mLabels;
 
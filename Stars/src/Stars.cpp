@@ -22,6 +22,7 @@
 
 #include "Stars.h"
 #include "Conversions.h"
+#include "TaskScheduler.h"
 
 #include "cinder/ImageIo.h"
 #include "cinder/app/App.h"
@@ -258,6 +259,28 @@ void Stars::load( DataSourceRef source )
 }
 
 void Stars::read( DataSourceRef source )
+{
+	readData( source );
+
+	// create VboMesh
+	createMesh();
+}
+
+void Stars::readAsync( DataSourceRef source )
+{
+	// parse into a temporary object on a worker thread, then take its data on the main thread
+	auto stars = std::make_shared<Stars>();
+
+	ph::TaskScheduler::getInstance().submit( [=]() { stars->readData( source ); } )->thenOnMainThread( [=]() {
+		mVertices.swap( stars->mVertices );
+		mTexcoords.swap( stars->mTexcoords );
+		mColors.swap( stars->mColors );
+
+		createMesh();
+	} );
+}
+
+void Stars::readData( DataSourceRef source )
 {
 	IStreamRef in = source->createStream();
 
@@ -293,9 +316,6 @@ void Stars::read( DataSourceRef source )
 		in->readLittle( &v.b );
 		mColors.push_back( v );
 	}
-
-	// create VboMesh
-	createMesh();
 }
 
 void Stars::write( DataTargetRef target )
@@ -102,10 +102,14 @@ class Stars {
 
 	//! reads a binary star data file
 	void read( ci::DataSourceRef source );
+	//! reads a binary star data file on a worker thread, then creates the mesh on the main thread
+	void readAsync( ci::DataSourceRef source );
 	//! writes a binary star data file
 	void write( ci::DataTargetRef target );
 
   private:
+	//! parses a binary star data file without creating the mesh, so it can run on any thread
+	void readData( ci::DataSourceRef source );
 	void createMesh();
 
 	void enablePointSprites();
@@ -38,6 +38,7 @@
 #include "Grid.h"
 #include "Labels.h"
 #include "Stars.h"
+#include "TaskScheduler.h"
 #include "UserInterface.h"
 
 #include <irrKlang.h>
@@ -185,22 +186,23 @@ void StarsApp::setup()
 	mStars.setup();
 	mStars.setAspectRatio( mIsStereoscopic ? 0.5f : 1.0f );
 
-	// load the star database and create the VBO mesh
+	// load the star database and create the VBO mesh. The files are parsed in parallel by the task scheduler,
+	// the meshes are created on the main thread in update().
 	if( fs::exists( getAssetPath( "" ) / "stars.cdb" ) )
-		mStars.read( loadFile( getAssetPath( "" ) / "stars.cdb" ) );
+		mStars.readAsync( loadFile( getAssetPath( "" ) / "stars.cdb" ) );
 
 	if( fs::exists( getAssetPath( "" ) / "labels.cdb" ) )
-		mLabels.read( loadFile( getAssetPath( "" ) / "labels.cdb" ) );
+		mLabels.readAsync( loadFile( getAssetPath( "" ) / "labels.cdb" ) );
 	else {
 		mLabels.load( loadAsset( "hygxyz.csv" ) );
 		mLabels.write( writeFile( getAssetPath( "" ) / "labels.cdb" ) );
 	}
 
 	if( fs::exists( getAssetPath( "" ) / "constellations.cdb" ) )
-		mConstellations.read( loadFile( getAssetPath( "" ) / "constellations.cdb" ) );
+		mConstellations.readAsync( loadFile( getAssetPath( "" ) / "constellations.cdb" ) );
 
 	if( fs::exists( getAssetPath( "" ) / "constellationlabels.cdb" ) )
-		mConstellationLabels.read( loadFile( getAssetPath( "" ) / "constellationlabels.cdb" ) );
+		mConstellationLabels.readAsync( loadFile( getAssetPath( "" ) / "constellationlabels.cdb" ) );
 
 	// create user interface
 	mUserInterface.setup();
@@ -266,10 +268,15 @@ void StarsApp::cleanup()
 {
 	if( mSoundEngine )
 		mSoundEngine->stopAllSounds();
+
+	ph::TaskScheduler::getInstance().shutdown();
 }
 
 void StarsApp::update()
 {
+	// create meshes for data that has been loaded in the background
+	ph::TaskScheduler::getInstance().processMainThread();
+
 	const double elapsed = getElapsedSeconds() - mTime;
 	mTime += elapsed;
 